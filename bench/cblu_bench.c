@@ -0,0 +1,815 @@
+//
+//  cblu_bench.c
+//
+//  Microbenchmarks for the public CBLiteC.h API. Prints one JSON document with
+//  ns/op, allocations/op and bytes/op per benchmark, for regression tracking.
+//
+//  Build from the repo root, with CBL pointing at the Couchbase Lite C install:
+//      make bench CBL=/path/to/libcblite     # → build/cblu_bench
+//
+//  Usage: cblu_bench [-d dir] [-f name-filter] [-t min-ms-per-bench]
+//
+//  Allocations are counted by interposing malloc/calloc/realloc (glibc only);
+//  elsewhere allocs_per_op and bytes_per_op are null. They include allocations
+//  made inside Couchbase Lite, which is what a caller actually pays.
+//
+
+#include "CBLiteC.h"
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <getopt.h>
+#include <time.h>
+#include <unistd.h>
+
+// ---- allocation counting ----
+static _Atomic uint64_t g_allocs, g_alloc_bytes;
+
+#if defined(__GLIBC__)
+#define BENCH_COUNTS_ALLOCS 1
+extern void* __libc_malloc(size_t);
+extern void* __libc_calloc(size_t, size_t);
+extern void* __libc_realloc(void*, size_t);
+extern void* __libc_memalign(size_t, size_t);
+extern void  __libc_free(void*);
+
+static inline void count_alloc(size_t n) {
+	atomic_fetch_add_explicit(&g_allocs, 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&g_alloc_bytes, n, memory_order_relaxed);
+}
+
+void* malloc(size_t n)             { count_alloc(n); return __libc_malloc(n); }
+void* calloc(size_t c, size_t n)   { count_alloc(c * n); return __libc_calloc(c, n); }
+void* realloc(void* p, size_t n)   { count_alloc(n); return __libc_realloc(p, n); }
+void  free(void* p)                { __libc_free(p); }
+void* aligned_alloc(size_t a, size_t n) { count_alloc(n); return __libc_memalign(a, n); }
+int   posix_memalign(void** out, size_t a, size_t n) {
+	count_alloc(n);
+	void* p = __libc_memalign(a, n);
+	if (!p) return ENOMEM;
+	*out = p;
+	return 0;
+}
+#else
+#define BENCH_COUNTS_ALLOCS 0
+#endif
+
+static uint64_t now_ns(void) {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint64_t)t.tv_sec * 1000000000ull + (uint64_t)t.tv_nsec;
+}
+
+static int rm_entry(const char* path, const struct stat* st, int flag, struct FTW* ftw) {
+	(void)st; (void)flag; (void)ftw;
+	return remove(path);
+}
+
+static void remove_db(const char* dir, const char* name) {
+	char p[4096];
+	snprintf(p, sizeof p, "%s/%s.cblite2", dir, name);
+	nftw(p, rm_entry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+// ---- fixture ----
+// Compiled paths into the "fixture" document
+enum { P_F64, P_I64, P_U64, P_BOOL, P_STR, P_FA, P_IA, P_COUNT };
+static const char* const kPaths[P_COUNT] = { "fa[0]", "i", "u", "b", "s", "fa", "ia" };
+
+#define SHARDS 4
+
+typedef struct {
+	const char*   dir;
+	char          name[64];
+	CBLU_Db*      db;
+	CBLU_Session* s;
+	CBLU_DocW*    w;
+	CBLU_DocR*    r;
+	CBLU_Path*    paths[P_COUNT];
+	void*         buf;     // payload / destination buffer, arg-sized
+	size_t        arg;
+	uint64_t      seq;     // unique doc ids across iterations
+	CBLU_Counters* counters;
+	CBLU_Queue*    queue;
+	CBLU_EventLog* evlog;
+	CBLU_Db*       bulk;   // separate database for whole-database benches
+	CBLU_ShardedDb* shards;
+	char           file[4200];  // scratch file in dir
+} Env;
+
+typedef struct {
+	const char* name;
+	void (*setup)(Env* e);
+	void (*run)(Env* e, uint64_t iters);
+	void (*teardown)(Env* e);
+	size_t arg;
+} BenchDef;
+
+static void make_id(char* dst, size_t n, const char* prefix, uint64_t i) {
+	snprintf(dst, n, "%s%012llu", prefix, (unsigned long long)i);
+}
+
+static void fill_arrays(Env* e) {
+	double*  f = (double*)malloc(e->arg * sizeof *f);
+	int64_t* l = (int64_t*)malloc(e->arg * sizeof *l);
+	for (size_t i = 0; i < e->arg; i++) { f[i] = (double)i * 0.5; l[i] = (int64_t)i; }
+	e->buf = malloc(e->arg * sizeof(double));
+	CBLU_DocW* w = cblu_docw_begin(e->s, "fixture");
+	cblu_docw_set_i64(w, "i", -42);
+	cblu_docw_set_u64(w, "u", 42);
+	cblu_docw_set_f64(w, "f", 3.25);
+	cblu_docw_set_str(w, "s", "the quick brown fox jumps over the lazy dog");
+	cblu_docw_set_bool(w, "b", true);
+	cblu_docw_set_f64_array(w, "fa", f, e->arg);
+	cblu_docw_set_i64_array(w, "ia", l, e->arg);
+	cblu_docw_save(w);
+	free(f); free(l);
+}
+
+static void setup_docw(Env* e) {
+	e->w = cblu_docw_begin(e->s, "setter");
+	e->buf = calloc(e->arg ? e->arg : 1, sizeof(double));
+	for (size_t i = 0; i < e->arg; i++) ((double*)e->buf)[i] = (double)i;
+}
+static void teardown_docw(Env* e) { cblu_docw_free(e->w); e->w = NULL; }
+
+static void setup_docr(Env* e) {
+	if (!e->arg) e->arg = 1;
+	fill_arrays(e);
+	e->r = cblu_docr_get(e->s, "fixture");
+	for (int i = 0; i < P_COUNT; i++) e->paths[i] = cblu_path_compile(kPaths[i]);
+}
+static void teardown_docr(Env* e) {
+	cblu_docr_free(e->r); e->r = NULL;
+	for (int i = 0; i < P_COUNT; i++) { cblu_path_free(e->paths[i]); e->paths[i] = NULL; }
+}
+
+static void bulk_name(const Env* e, char* dst, size_t n) { snprintf(dst, n, "%s_bulk", e->name); }
+
+// Fresh database with ndocs small docs, so whole-database benches don't scale
+// with whatever earlier benches saved into the main one
+static void bulk_open(Env* e, size_t ndocs) {
+	char name[96];
+	bulk_name(e, name, sizeof name);
+	remove_db(e->dir, name);
+	if (!cblu_open(name, e->dir, &e->bulk)) return;
+	CBLU_Session* s = cblu_session_begin_txn(e->bulk, true);
+	for (size_t i = 0; i < ndocs; i++) {
+		char id[32];
+		make_id(id, sizeof id, "k", i);
+		CBLU_DocW* w = cblu_docw_begin(s, id);
+		cblu_docw_set_i64(w, "n", (int64_t)i);
+		cblu_docw_set_f64(w, "v", (double)i * 0.25);
+		cblu_docw_set_str(w, "tag", "sensor");
+		cblu_docw_save(w);
+	}
+	cblu_session_end_txn(s, true);
+	snprintf(e->file, sizeof e->file, "%s/%s.scratch", e->dir, e->name);
+}
+static void setup_bulk(Env* e) { bulk_open(e, e->arg); }
+static void teardown_bulk(Env* e) {
+	char name[96];
+	bulk_name(e, name, sizeof name);
+	cblu_close(e->bulk); e->bulk = NULL;
+	remove_db(e->dir, name);
+	remove(e->file);
+}
+
+// ---- database / session ----
+static void run_open_close(Env* e, uint64_t n) {
+	char name[80];
+	snprintf(name, sizeof name, "%s_oc", e->name);
+	for (uint64_t i = 0; i < n; i++) {
+		CBLU_Db* db = NULL;
+		if (cblu_open(name, e->dir, &db)) cblu_close(db);
+	}
+}
+
+static void run_session(Env* e, uint64_t n) {
+	for (uint64_t i = 0; i < n; i++) cblu_session_end(cblu_session_begin(e->db));
+}
+
+static void run_session_txn(Env* e, uint64_t n) {
+	for (uint64_t i = 0; i < n; i++) cblu_session_end_txn(cblu_session_begin_txn(e->db, true), true);
+}
+
+static void run_open_readers(Env* e, uint64_t n) {
+	char name[80];
+	snprintf(name, sizeof name, "%s_oc", e->name);
+	for (uint64_t i = 0; i < n; i++) {
+		CBLU_Db* db = NULL;
+		if (!cblu_open(name, e->dir, &db)) continue;
+		cblu_open_readers(db, (unsigned)e->arg);
+		cblu_close(db);
+	}
+}
+
+// ---- setters ----
+static void run_set_i64(Env* e, uint64_t n) { for (uint64_t i = 0; i < n; i++) cblu_docw_set_i64(e->w, "k", (int64_t)i); }
+static void run_set_u64(Env* e, uint64_t n) { for (uint64_t i = 0; i < n; i++) cblu_docw_set_u64(e->w, "k", i); }
+static void run_set_f64(Env* e, uint64_t n) { for (uint64_t i = 0; i < n; i++) cblu_docw_set_f64(e->w, "k", (double)i); }
+static void run_set_str(Env* e, uint64_t n) { for (uint64_t i = 0; i < n; i++) cblu_docw_set_str(e->w, "k", "the quick brown fox"); }
+static void run_set_bool(Env* e, uint64_t n) { for (uint64_t i = 0; i < n; i++) cblu_docw_set_bool(e->w, "k", i & 1); }
+static void run_set_f64_array(Env* e, uint64_t n) {
+	for (uint64_t i = 0; i < n; i++) cblu_docw_set_f64_array(e->w, "k", (const double*)e->buf, e->arg);
+}
+static void run_set_i64_array(Env* e, uint64_t n) {
+	for (uint64_t i = 0; i < n; i++) cblu_docw_set_i64_array(e->w, "k", (const int64_t*)e->buf, e->arg);
+}
+
+// ---- saves ----
+static void save_small(Env* e, CBLU_Session* s) {
+	char id[32];
+	make_id(id, sizeof id, "s", e->seq++);
+	CBLU_DocW* w = cblu_docw_begin(s, id);
+	cblu_docw_set_i64(w, "t", (int64_t)e->seq);
+	cblu_docw_set_f64(w, "v", 1.5);
+	cblu_docw_set_str(w, "tag", "sensor");
+	cblu_docw_save(w);
+}
+
+static void run_save(Env* e, uint64_t n) {
+	for (uint64_t i = 0; i < n; i++) save_small(e, e->s);
+}
+
+static void run_save_txn(Env* e, uint64_t n) {
+	CBLU_Session* s = cblu_session_begin_txn(e->db, true);
+	for (uint64_t i = 0; i < n; i++) save_small(e, s);
+	cblu_session_end_txn(s, true);
+}
+
+// ---- blobs ----
+static void setup_blob(Env* e) {
+	e->buf = malloc(e->arg);
+	memset(e->buf, 0xA5, e->arg);
+}
+
+static void run_blob_save(Env* e, uint64_t n) {
+	for (uint64_t i = 0; i < n; i++) {
+		// Vary the content so the blob store can't dedupe it
+		memcpy(e->buf, &e->seq, sizeof e->seq < e->arg ? sizeof e->seq : e->arg);
+		char id[32];
+		make_id(id, sizeof id, "b", e->seq++);
+		CBLU_DocW* w = cblu_docw_begin(e->s, id);
+		cblu_docw_set_blob(w, "data", e->buf, e->arg, "application/octet-stream");
+		cblu_docw_save(w);
+	}
+}
+
+static void setup_blob_read(Env* e) {
+	setup_blob(e);
+	CBLU_DocW* w = cblu_docw_begin(e->s, "blob_fixture");
+	cblu_docw_set_blob(w, "data", e->buf, e->arg, "application/octet-stream");
+	cblu_docw_save(w);
+	e->r = cblu_docr_get(e->s, "blob_fixture");
+}
+
+static void run_blob_get(Env* e, uint64_t n) {
+	for (uint64_t i = 0; i < n; i++) cblu_docr_get_blob(e->r, "data", e->buf, e->arg, NULL, 0);
+}
+
+static void run_blob_stream_read(Env* e, uint64_t n) {
+	for (uint64_t i = 0; i < n; i++) {
+		CBLU_BlobR* br = cblu_docr_blob_open(e->r, "data");
+		size_t got = 0;
+		cblu_blobr_read(br, e->buf, e->arg, &got);
+		cblu_blobr_close(br);
+	}
+}
+
+// Last 4 KiB of the blob, with the size and content type looked up first
+static void run_blob_read_at(Env* e, uint64_t n) {
+	char ct[64];
+	for (uint64_t i = 0; i < n; i++) {
+		CBLU_BlobR* br = cblu_docr_blob_open(e->r, "data");
+		uint64_t size = cblu_blobr_size(br);
+		cblu_blobr_content_type(br, ct, sizeof ct);
+		size_t got = 0;
+		cblu_blobr_read_at(br, size > 4096 ? size - 4096 : 0, e->buf, 4096, &got);
+		cblu_blobr_close(br);
+	}
+}
+
+static void run_blob_map(Env* e, uint64_t n) {
+	for (uint64_t i = 0; i < n; i++) {
+		const void* p; size_t len;
+		CBLU_BlobMap* m = cblu_docr_blob_map(e->r, "data", &p, &len);
+		(void)cblu_blobmap_fd(m);
+		cblu_blob_unmap(m);
+	}
+}
+
+#define BLOB_CHUNK 65536
+
+static void blobw_stream(Env* e, uint64_t n, bool crc) {
+	for (uint64_t i = 0; i < n; i++) {
+		memcpy(e->buf, &e->seq, sizeof e->seq < e->arg ? sizeof e->seq : e->arg);
+		char id[32];
+		make_id(id, sizeof id, "w", e->seq++);
+		CBLU_DocW* w = cblu_docw_begin(e->s, id);
+		CBLU_BlobW* bw = cblu_docw_blob_begin(w, "data", "application/octet-stream", crc);
+		for (size_t off = 0; off < e->arg; off += BLOB_CHUNK)
+			cblu_blobw_write(bw, (const char*)e->buf + off, e->arg - off < BLOB_CHUNK ? e->arg - off : BLOB_CHUNK);
+		(void)cblu_blobw_size(bw);
+		uint32_t sum;
+		if (cblu_blobw_finish(bw, crc ? &sum : NULL)) cblu_docw_save(w);
+		else cblu_docw_free(w);
+	}
+}
+static void run_blobw_write(Env* e, uint64_t n) { blobw_stream(e, n, false); }
+static void run_blobw_write_crc(Env* e, uint64_t n) { blobw_stream(e, n, true); }
+
+static void run_blobw_abort(Env* e, uint64_t n) {
+	for (uint64_t i = 0; i < n; i++) {
+		CBLU_DocW* w = cblu_docw_begin(e->s, "aborted");
+		CBLU_BlobW* bw = cblu_docw_blob_begin(w, "data", "application/octet-stream", false);
+		cblu_blobw_write(bw, e->buf, e->arg);
+		cblu_blobw_abort(bw);
+		cblu_docw_free(w);
+	}
+}
+
+// arg bytes in e->file, for the fd-fed writers
+static void setup_blob_file(Env* e) {
+	setup_blob(e);
+	snprintf(e->file, sizeof e->file, "%s/%s.blob", e->dir, e->name);
+	FILE* f = fopen(e->file, "wb");
+	if (f) { fwrite(e->buf, 1, e->arg, f); fclose(f); }
+}
+static void teardown_blob_file(Env* e) { remove(e->file); }
+
+static void run_blobw_write_fd(Env* e, uint64_t n) {
+	int fd = open(e->file, O_RDWR);
+	if (fd < 0) return;
+	for (uint64_t i = 0; i < n; i++) {
+		if (pwrite(fd, &e->seq, sizeof e->seq, 0) < 0) break;  // new content each time
+		lseek(fd, 0, SEEK_SET);
+		char id[32];
+		make_id(id, sizeof id, "f", e->seq++);
+		CBLU_DocW* w = cblu_docw_begin(e->s, id);
+		CBLU_BlobW* bw = cblu_docw_blob_begin(w, "data", "application/octet-stream", false);
+		cblu_blobw_write_fd(bw, fd, 0);
+		if (cblu_blobw_finish(bw, NULL)) cblu_docw_save(w);
+		else cblu_docw_free(w);
+	}
+	close(fd);
+}
+
+// ---- getters ----
+static void run_docr_get(Env* e, uint64_t n) {
+	for (uint64_t i = 0; i < n; i++) cblu_docr_free(cblu_docr_get(e->s, "fixture"));
+}
+static void run_has(Env* e, uint64_t n) { for (uint64_t i = 0; i < n; i++) cblu_docr_has(e->r, "f"); }
+static void run_get_i64(Env* e, uint64_t n) { int64_t v; for (uint64_t i = 0; i < n; i++) cblu_docr_get_i64(e->r, "i", &v); }
+static void run_get_u64(Env* e, uint64_t n) { uint64_t v; for (uint64_t i = 0; i < n; i++) cblu_docr_get_u64(e->r, "u", &v); }
+static void run_get_f64(Env* e, uint64_t n) { double v; for (uint64_t i = 0; i < n; i++) cblu_docr_get_f64(e->r, "f", &v); }
+static void run_get_str(Env* e, uint64_t n) { char b[64]; for (uint64_t i = 0; i < n; i++) cblu_docr_get_str(e->r, "s", b, sizeof b); }
+static void run_view_str(Env* e, uint64_t n) {
+	const char* p; size_t len;
+	for (uint64_t i = 0; i < n; i++) cblu_docr_view_str(e->r, "s", &p, &len);
+}
+static void run_view_data(Env* e, uint64_t n) {
+	const void* p; size_t len;
+	for (uint64_t i = 0; i < n; i++) cblu_docr_view_data(e->r, "s", &p, &len);
+}
+static void run_path_has(Env* e, uint64_t n) { for (uint64_t i = 0; i < n; i++) cblu_docr_path_has(e->r, e->paths[P_F64]); }
+static void run_path_i64(Env* e, uint64_t n) { int64_t v; for (uint64_t i = 0; i < n; i++) cblu_docr_path_i64(e->r, e->paths[P_I64], &v); }
+static void run_path_u64(Env* e, uint64_t n) { uint64_t v; for (uint64_t i = 0; i < n; i++) cblu_docr_path_u64(e->r, e->paths[P_U64], &v); }
+static void run_path_f64(Env* e, uint64_t n) { double v; for (uint64_t i = 0; i < n; i++) cblu_docr_path_f64(e->r, e->paths[P_F64], &v); }
+static void run_path_bool(Env* e, uint64_t n) { bool v; for (uint64_t i = 0; i < n; i++) cblu_docr_path_bool(e->r, e->paths[P_BOOL], &v); }
+static void run_path_str(Env* e, uint64_t n) { char b[64]; for (uint64_t i = 0; i < n; i++) cblu_docr_path_str(e->r, e->paths[P_STR], b, sizeof b); }
+static void run_path_view_str(Env* e, uint64_t n) {
+	const char* p; size_t len;
+	for (uint64_t i = 0; i < n; i++) cblu_docr_path_view_str(e->r, e->paths[P_STR], &p, &len);
+}
+static void run_path_view_data(Env* e, uint64_t n) {
+	const void* p; size_t len;
+	for (uint64_t i = 0; i < n; i++) cblu_docr_path_view_data(e->r, e->paths[P_STR], &p, &len);
+}
+static void run_path_count(Env* e, uint64_t n) { for (uint64_t i = 0; i < n; i++) cblu_docr_path_count(e->r, e->paths[P_FA]); }
+static void run_path_f64_array(Env* e, uint64_t n) {
+	for (uint64_t i = 0; i < n; i++) cblu_docr_path_f64_array(e->r, e->paths[P_FA], (double*)e->buf, e->arg);
+}
+static void run_path_i64_array(Env* e, uint64_t n) {
+	for (uint64_t i = 0; i < n; i++) cblu_docr_path_i64_array(e->r, e->paths[P_IA], (int64_t*)e->buf, e->arg);
+}
+static void run_get_f64_array(Env* e, uint64_t n) {
+	for (uint64_t i = 0; i < n; i++) cblu_docr_get_f64_array(e->r, "fa", (double*)e->buf, e->arg);
+}
+static void run_get_i64_array(Env* e, uint64_t n) {
+	for (uint64_t i = 0; i < n; i++) cblu_docr_get_i64_array(e->r, "ia", (int64_t*)e->buf, e->arg);
+}
+static void run_f64_array_to_arrow(Env* e, uint64_t n) {
+	for (uint64_t i = 0; i < n; i++) {
+		struct ArrowSchema sc; struct ArrowArray ar;
+		if (!cblu_docr_f64_array_to_arrow(e->r, "fa", &sc, &ar)) continue;
+		ar.release(&ar); sc.release(&sc);
+	}
+}
+static void run_i64_array_to_arrow(Env* e, uint64_t n) {
+	for (uint64_t i = 0; i < n; i++) {
+		struct ArrowSchema sc; struct ArrowArray ar;
+		if (!cblu_docr_i64_array_to_arrow(e->r, "ia", &sc, &ar)) continue;
+		ar.release(&ar); sc.release(&sc);
+	}
+}
+
+// ---- query ----
+static void setup_query(Env* e) {
+	CBLU_Session* s = cblu_session_begin_txn(e->db, true);
+	for (unsigned i = 0; i < 1000; i++) {
+		char id[32];
+		make_id(id, sizeof id, "q", i);
+		CBLU_DocW* w = cblu_docw_begin(s, id);
+		cblu_docw_set_i64(w, "qv", i);
+		cblu_docw_save(w);
+	}
+	cblu_session_end_txn(s, true);
+}
+
+static void run_query(Env* e, uint64_t n) {
+	for (uint64_t i = 0; i < n; i++) {
+		CBLU_Query* q = cblu_query_begin(e->s, "SELECT qv FROM _ WHERE qv < 100");
+		int64_t v;
+		while (q && cblu_query_next(q)) cblu_query_get_i64(q, 0, &v);
+		cblu_query_free(q);
+	}
+}
+
+// Column metadata plus the f64/str getters, over the bulk database
+static void run_query_cols(Env* e, uint64_t n) {
+	CBLU_Session* s = cblu_session_begin(e->bulk);
+	for (uint64_t i = 0; i < n; i++) {
+		CBLU_Query* q = cblu_query_begin(s, "SELECT v, tag FROM _");
+		char name[32], tag[32];
+		double v;
+		for (unsigned c = 0; c < cblu_query_columns(q); c++) cblu_query_column_name(q, c, name, sizeof name);
+		while (q && cblu_query_next(q)) { cblu_query_get_f64(q, 0, &v); cblu_query_get_str(q, 1, tag, sizeof tag); }
+		cblu_query_free(q);
+	}
+	cblu_session_end(s);
+}
+
+static void run_query_to_arrow(Env* e, uint64_t n) {
+	CBLU_Session* s = cblu_session_begin(e->bulk);
+	for (uint64_t i = 0; i < n; i++) {
+		CBLU_Query* q = cblu_query_begin(s, "SELECT n, v, tag FROM _");
+		struct ArrowSchema sc; struct ArrowArray ar;
+		if (q && cblu_query_to_arrow(q, 0, &sc, &ar)) { ar.release(&ar); sc.release(&sc); }
+		cblu_query_free(q);
+	}
+	cblu_session_end(s);
+}
+
+// ---- import / export / changes / ingest (arg docs or bytes per op) ----
+static void run_export(Env* e, uint64_t n) {
+	for (uint64_t i = 0; i < n; i++) cblu_export(e->bulk, e->file, NULL, NULL);
+}
+static void run_export_fleece(Env* e, uint64_t n) {
+	CBLU_ExportOptions o = { .format = CBLU_EXPORT_FLEECE };
+	for (uint64_t i = 0; i < n; i++) cblu_export(e->bulk, e->file, &o, NULL);
+}
+
+// The input is the bulk database's own export, re-imported over itself
+static void setup_import(Env* e) {
+	setup_bulk(e);
+	cblu_export(e->bulk, e->file, NULL, NULL);
+}
+static void run_import_file(Env* e, uint64_t n) {
+	for (uint64_t i = 0; i < n; i++) cblu_import_ndjson_file(e->bulk, e->file, NULL, NULL);
+}
+static void run_import_fd(Env* e, uint64_t n) {
+	for (uint64_t i = 0; i < n; i++) {
+		int fd = open(e->file, O_RDONLY);
+		if (fd < 0) return;
+		cblu_import_ndjson_fd(e->bulk, fd, NULL, NULL);
+		close(fd);
+	}
+}
+
+// Full scan from a new checkpoint, then commit it
+static void run_changes(Env* e, uint64_t n) {
+	CBLU_Change out[256];
+	for (uint64_t i = 0; i < n; i++) {
+		char name[32];
+		make_id(name, sizeof name, "c", e->seq++);
+		CBLU_Changes* c = cblu_changes_begin(e->bulk, name);
+		(void)cblu_changes_since(c);
+		while (cblu_changes_next(c, out, 256) > 0) {}
+		cblu_changes_commit(c);
+		cblu_changes_end(c);
+	}
+}
+
+// One file of arg bytes, ingested n times per run (same content: the blob store keeps one copy)
+static void setup_ingest(Env* e) {
+	bulk_open(e, 0);
+	setup_blob(e);
+	FILE* f = fopen(e->file, "wb");
+	if (f) { fwrite(e->buf, 1, e->arg, f); fclose(f); }
+}
+static void run_ingest(Env* e, uint64_t n) {
+	CBLU_Ingest* g = cblu_ingest_begin(e->bulk, NULL);
+	for (uint64_t i = 0; i < n; i++) {
+		char id[32];
+		make_id(id, sizeof id, "g", e->seq++);
+		cblu_ingest_add(g, e->file, id, "data", "application/octet-stream");
+	}
+	CBLU_IngestStats st;
+	cblu_ingest_stats(g, &st);
+	cblu_ingest_finish(g, &st);
+}
+
+// ---- shards ----
+static void shards_name(const Env* e, char* dst, size_t n) { snprintf(dst, n, "%s_sh", e->name); }
+
+static void setup_shards(Env* e) {
+	char name[96], db[112];
+	shards_name(e, name, sizeof name);
+	for (unsigned i = 0; i < SHARDS; i++) { snprintf(db, sizeof db, "%s.%u", name, i); remove_db(e->dir, db); }
+	if (!cblu_shards_open(name, e->dir, SHARDS, &e->shards)) return;
+	for (unsigned i = 0; i < 1000; i++) {
+		char id[32];
+		make_id(id, sizeof id, "h", i);
+		CBLU_DocW* d = cblu_shards_docw_begin(e->shards, id, NULL);
+		cblu_docw_set_i64(d, "n", i);
+		cblu_shards_submit(e->shards, d);
+	}
+	cblu_shards_flush(e->shards);
+}
+static void teardown_shards(Env* e) {
+	char name[96], db[112];
+	shards_name(e, name, sizeof name);
+	cblu_shards_close(e->shards); e->shards = NULL;
+	for (unsigned i = 0; i < SHARDS; i++) { snprintf(db, sizeof db, "%s.%u", name, i); remove_db(e->dir, db); }
+}
+
+// Submit is asynchronous: the run ends with a flush, so ns/op includes the writes
+static void run_shards_submit(Env* e, uint64_t n) {
+	for (uint64_t i = 0; i < n; i++) {
+		char id[32];
+		make_id(id, sizeof id, "h", e->seq++);
+		(void)cblu_shards_route(e->shards, id);
+		CBLU_DocW* d = cblu_shards_docw_begin(e->shards, id, NULL);
+		cblu_docw_set_i64(d, "n", (int64_t)i);
+		cblu_shards_submit(e->shards, d);
+	}
+	cblu_shards_flush(e->shards);
+}
+
+static void run_shards_get_many(Env* e, uint64_t n) {
+	char ids[16][32];
+	const char* p[16];
+	CBLU_DocR* out[16];
+	for (unsigned k = 0; k < 16; k++) { make_id(ids[k], sizeof ids[k], "h", k * 61); p[k] = ids[k]; }
+	for (uint64_t i = 0; i < n; i++) {
+		size_t got = cblu_shards_get_many(e->shards, p, 16, out);
+		for (unsigned k = 0; k < 16 && got; k++) cblu_docr_free(out[k]);
+	}
+}
+
+static bool shard_count_row(void* ctx, unsigned shard, CBLU_Query* row) {
+	(void)shard;
+	int64_t c = 0;
+	if (cblu_query_get_i64(row, 0, &c)) *(int64_t*)ctx += c;
+	return true;
+}
+static void run_shards_query(Env* e, uint64_t n) {
+	for (uint64_t i = 0; i < n; i++) {
+		int64_t total = 0;
+		cblu_shards_query(e->shards, "SELECT COUNT(*) FROM _", shard_count_row, &total);
+	}
+	(void)cblu_shards_count(e->shards);
+	(void)cblu_shards_db(e->shards, 0);
+}
+
+// ---- counters / queue / event log ----
+static void setup_counters(Env* e) { e->counters = cblu_counters_open(e->db, 0); }
+static void teardown_counters(Env* e) { cblu_counters_close(e->counters); e->counters = NULL; }
+static void run_counter_add(Env* e, uint64_t n) {
+	for (uint64_t i = 0; i < n; i++) cblu_counter_add(e->counters, "ctr", "hits", 1);
+}
+static void run_counter_get(Env* e, uint64_t n) {
+	int64_t v;
+	for (uint64_t i = 0; i < n; i++) cblu_counter_get(e->counters, "ctr", "hits", &v);
+}
+// One add per op, folded into its document each time
+static void run_counter_flush(Env* e, uint64_t n) {
+	for (uint64_t i = 0; i < n; i++) {
+		cblu_counter_add(e->counters, "ctr", "hits", 1);
+		cblu_counters_flush(e->counters);
+	}
+}
+
+static void setup_queue(Env* e) { e->queue = cblu_queue_open(e->db, "bench"); }
+static void teardown_queue(Env* e) { cblu_queue_close(e->queue); e->queue = NULL; }
+static void run_queue_cycle(Env* e, uint64_t n) {
+	static const char msg[64];
+	const void* data = msg;
+	size_t size = sizeof msg;
+	for (uint64_t i = 0; i < n; i++) {
+		CBLU_QueueMsg m;
+		cblu_queue_enqueue(e->queue, &data, &size, 1);
+		if (cblu_queue_claim(e->queue, 1, 30000, &m) == 1) cblu_queue_ack(e->queue, &m, 1);
+	}
+}
+// Claim, nack, re-claim, ack: the redelivery path
+static void run_queue_nack(Env* e, uint64_t n) {
+	static const char msg[64];
+	const void* data = msg;
+	size_t size = sizeof msg;
+	for (uint64_t i = 0; i < n; i++) {
+		CBLU_QueueMsg m;
+		cblu_queue_enqueue(e->queue, &data, &size, 1);
+		if (cblu_queue_claim(e->queue, 1, 30000, &m) == 1) cblu_queue_nack(e->queue, &m, 1);
+		if (cblu_queue_claim(e->queue, 1, 30000, &m) == 1) cblu_queue_ack(e->queue, &m, 1);
+		(void)cblu_queue_size(e->queue);
+	}
+}
+
+// Fold that just counts events, so snapshots cost what a small state would
+static uint64_t g_ev_count;
+static void ev_reset(void* ctx) { (void)ctx; g_ev_count = 0; }
+static void ev_apply(void* ctx, uint64_t seq, const void* ev, size_t size) { (void)ctx; (void)seq; (void)ev; (void)size; g_ev_count++; }
+static void ev_save(void* ctx, CBLU_DocW* snap) { (void)ctx; cblu_docw_set_u64(snap, "n", g_ev_count); }
+static bool ev_load(void* ctx, CBLU_DocR* snap) { (void)ctx; return cblu_docr_get_u64(snap, "n", &g_ev_count); }
+
+static void setup_evlog(Env* e) {
+	static const CBLU_EventFold fold = { NULL, ev_reset, ev_apply, ev_save, ev_load };
+	e->evlog = cblu_evlog_open(e->db, "bench", 4096, &fold);
+}
+static void teardown_evlog(Env* e) { cblu_evlog_close(e->evlog); e->evlog = NULL; }
+static void run_evlog_append(Env* e, uint64_t n) {
+	static const char ev[32];
+	for (uint64_t i = 0; i < n; i++) cblu_evlog_append(e->evlog, ev, sizeof ev, NULL);
+}
+// 64 appends then an explicit compaction per op
+static void run_evlog_snapshot(Env* e, uint64_t n) {
+	static const char ev[32];
+	for (uint64_t i = 0; i < n; i++) {
+		for (int k = 0; k < 64; k++) cblu_evlog_append(e->evlog, ev, sizeof ev, NULL);
+		cblu_evlog_snapshot(e->evlog);
+		(void)cblu_evlog_seq(e->evlog);
+	}
+}
+
+#define ARRAY_SIZES(X, name, setup, run, teardown) \
+	X(name "/1", setup, run, teardown, 1), X(name "/16", setup, run, teardown, 16), \
+	X(name "/256", setup, run, teardown, 256), X(name "/4096", setup, run, teardown, 4096), \
+	X(name "/65536", setup, run, teardown, 65536), X(name "/1048576", setup, run, teardown, 1048576)
+#define BENCH(name, setup, run, teardown, arg) { name, setup, run, teardown, arg }
+
+static const BenchDef kBenches[] = {
+	BENCH("open_close",        NULL, run_open_close, NULL, 0),
+	BENCH("session_begin_end", NULL, run_session, NULL, 0),
+	BENCH("session_txn_begin_end", NULL, run_session_txn, NULL, 0),
+	BENCH("open_readers_close/2", NULL, run_open_readers, NULL, 2),
+	BENCH("docw_set_i64",      setup_docw, run_set_i64, teardown_docw, 0),
+	BENCH("docw_set_u64",      setup_docw, run_set_u64, teardown_docw, 0),
+	BENCH("docw_set_f64",      setup_docw, run_set_f64, teardown_docw, 0),
+	BENCH("docw_set_str",      setup_docw, run_set_str, teardown_docw, 0),
+	BENCH("docw_set_bool",     setup_docw, run_set_bool, teardown_docw, 0),
+	ARRAY_SIZES(BENCH, "docw_set_f64_array", setup_docw, run_set_f64_array, teardown_docw),
+	ARRAY_SIZES(BENCH, "docw_set_i64_array", setup_docw, run_set_i64_array, teardown_docw),
+	BENCH("docw_save",         NULL, run_save, NULL, 0),
+	BENCH("docw_save_txn",     NULL, run_save_txn, NULL, 0),
+	BENCH("docr_get",          setup_docr, run_docr_get, teardown_docr, 1),
+	BENCH("docr_has",          setup_docr, run_has, teardown_docr, 1),
+	BENCH("docr_get_i64",      setup_docr, run_get_i64, teardown_docr, 1),
+	BENCH("docr_get_u64",      setup_docr, run_get_u64, teardown_docr, 1),
+	BENCH("docr_get_f64",      setup_docr, run_get_f64, teardown_docr, 1),
+	BENCH("docr_get_str",      setup_docr, run_get_str, teardown_docr, 1),
+	BENCH("docr_view_str",     setup_docr, run_view_str, teardown_docr, 1),
+	BENCH("docr_view_data",    setup_docr, run_view_data, teardown_docr, 1),
+	BENCH("docr_path_has",     setup_docr, run_path_has, teardown_docr, 1),
+	BENCH("docr_path_i64",     setup_docr, run_path_i64, teardown_docr, 1),
+	BENCH("docr_path_u64",     setup_docr, run_path_u64, teardown_docr, 1),
+	BENCH("docr_path_f64",     setup_docr, run_path_f64, teardown_docr, 1),
+	BENCH("docr_path_bool",    setup_docr, run_path_bool, teardown_docr, 1),
+	BENCH("docr_path_str",     setup_docr, run_path_str, teardown_docr, 1),
+	BENCH("docr_path_view_str",  setup_docr, run_path_view_str, teardown_docr, 1),
+	BENCH("docr_path_view_data", setup_docr, run_path_view_data, teardown_docr, 1),
+	BENCH("docr_path_count",   setup_docr, run_path_count, teardown_docr, 4096),
+	ARRAY_SIZES(BENCH, "docr_get_f64_array", setup_docr, run_get_f64_array, teardown_docr),
+	ARRAY_SIZES(BENCH, "docr_get_i64_array", setup_docr, run_get_i64_array, teardown_docr),
+	ARRAY_SIZES(BENCH, "docr_path_f64_array", setup_docr, run_path_f64_array, teardown_docr),
+	ARRAY_SIZES(BENCH, "docr_path_i64_array", setup_docr, run_path_i64_array, teardown_docr),
+	BENCH("docr_f64_array_to_arrow/4096", setup_docr, run_f64_array_to_arrow, teardown_docr, 4096),
+	BENCH("docr_i64_array_to_arrow/4096", setup_docr, run_i64_array_to_arrow, teardown_docr, 4096),
+	BENCH("blob_save/1024",      setup_blob, run_blob_save, NULL, 1024),
+	BENCH("blob_save/65536",     setup_blob, run_blob_save, NULL, 65536),
+	BENCH("blob_save/1048576",   setup_blob, run_blob_save, NULL, 1048576),
+	BENCH("blob_save/16777216",  setup_blob, run_blob_save, NULL, 16777216),
+	BENCH("docr_get_blob/1024",     setup_blob_read, run_blob_get, teardown_docr, 1024),
+	BENCH("docr_get_blob/1048576",  setup_blob_read, run_blob_get, teardown_docr, 1048576),
+	BENCH("blobr_read/1048576",     setup_blob_read, run_blob_stream_read, teardown_docr, 1048576),
+	BENCH("blobr_read_at_tail/1048576", setup_blob_read, run_blob_read_at, teardown_docr, 1048576),
+	BENCH("docr_blob_map/1048576",  setup_blob_read, run_blob_map, teardown_docr, 1048576),
+	BENCH("blobw_write/1048576",    setup_blob, run_blobw_write, NULL, 1048576),
+	BENCH("blobw_write_crc32c/1048576", setup_blob, run_blobw_write_crc, NULL, 1048576),
+	BENCH("blobw_write_fd/1048576", setup_blob_file, run_blobw_write_fd, teardown_blob_file, 1048576),
+	BENCH("blobw_abort/65536",      setup_blob, run_blobw_abort, NULL, 65536),
+	BENCH("query_100_rows",    setup_query, run_query, NULL, 0),
+	BENCH("query_cols_1000_rows",    setup_bulk, run_query_cols, teardown_bulk, 1000),
+	BENCH("query_to_arrow_1000_rows", setup_bulk, run_query_to_arrow, teardown_bulk, 1000),
+	BENCH("export_ndjson/1000",   setup_bulk, run_export, teardown_bulk, 1000),
+	BENCH("export_fleece/1000",   setup_bulk, run_export_fleece, teardown_bulk, 1000),
+	BENCH("import_ndjson_file/1000", setup_import, run_import_file, teardown_bulk, 1000),
+	BENCH("import_ndjson_fd/1000",   setup_import, run_import_fd, teardown_bulk, 1000),
+	BENCH("changes_scan_commit/1000", setup_bulk, run_changes, teardown_bulk, 1000),
+	BENCH("ingest_file/65536",    setup_ingest, run_ingest, teardown_bulk, 65536),
+	BENCH("shards_submit",        setup_shards, run_shards_submit, teardown_shards, 0),
+	BENCH("shards_get_many/16",   setup_shards, run_shards_get_many, teardown_shards, 16),
+	BENCH("shards_query_count",   setup_shards, run_shards_query, teardown_shards, 0),
+	BENCH("counter_add",       setup_counters, run_counter_add, teardown_counters, 0),
+	BENCH("counter_get",       setup_counters, run_counter_get, teardown_counters, 0),
+	BENCH("counter_add_flush", setup_counters, run_counter_flush, teardown_counters, 0),
+	BENCH("queue_enqueue_claim_ack", setup_queue, run_queue_cycle, teardown_queue, 0),
+	BENCH("queue_nack_reclaim_ack",  setup_queue, run_queue_nack, teardown_queue, 0),
+	BENCH("evlog_append",      setup_evlog, run_evlog_append, teardown_evlog, 0),
+	BENCH("evlog_append64_snapshot", setup_evlog, run_evlog_snapshot, teardown_evlog, 0),
+};
+
+typedef struct { uint64_t iters, ns, allocs, bytes; } Sample;
+
+static Sample measure(const BenchDef* b, Env* e, uint64_t iters) {
+	Sample r = { .iters = iters };
+	uint64_t a0 = atomic_load(&g_allocs), b0 = atomic_load(&g_alloc_bytes);
+	uint64_t t0 = now_ns();
+	b->run(e, iters);
+	r.ns = now_ns() - t0;
+	r.allocs = atomic_load(&g_allocs) - a0;
+	r.bytes  = atomic_load(&g_alloc_bytes) - b0;
+	return r;
+}
+
+// Grows the iteration count until one timed run lasts at least min_ns
+static Sample run_bench(const BenchDef* b, Env* e, uint64_t min_ns) {
+	uint64_t iters = 1;
+	for (;;) {
+		Sample s = measure(b, e, iters);
+		if (s.ns >= min_ns || iters >= 1000000000ull) return s;
+		uint64_t next = s.ns ? (uint64_t)((double)iters * 1.2 * (double)min_ns / (double)s.ns) : iters * 100;
+		if (next > iters * 100) next = iters * 100;
+		iters = next > iters ? next : iters + 1;
+	}
+}
+
+int main(int argc, char** argv) {
+	const char* dir = "/tmp";
+	const char* filter = NULL;
+	uint64_t min_ms = 200;
+	int c;
+	while ((c = getopt(argc, argv, "d:f:t:")) != -1) {
+		switch (c) {
+			case 'd': dir = optarg; break;
+			case 'f': filter = optarg; break;
+			case 't': min_ms = strtoull(optarg, NULL, 10); break;
+			default:
+				fprintf(stderr, "usage: %s [-d dir] [-f name-filter] [-t min-ms-per-bench]\n", argv[0]);
+				return 2;
+		}
+	}
+
+	Env base = { .dir = dir };
+	snprintf(base.name, sizeof base.name, "cblu_bench_%d", (int)getpid());
+	if (!cblu_open(base.name, dir, &base.db)) return 1;
+
+	printf("{\n  \"allocs_counted\": %s,\n  \"benchmarks\": [", BENCH_COUNTS_ALLOCS ? "true" : "false");
+	bool first = true;
+	uint64_t seq = 0;
+	for (size_t i = 0; i < sizeof kBenches / sizeof kBenches[0]; i++) {
+		const BenchDef* b = &kBenches[i];
+		if (filter && !strstr(b->name, filter)) continue;
+		Env e = base;
+		e.arg = b->arg;
+		e.seq = seq;
+		e.s = cblu_session_begin(e.db);
+		if (b->setup) b->setup(&e);
+		Sample s = run_bench(b, &e, min_ms * 1000000ull);
+		if (b->teardown) b->teardown(&e);
+		cblu_session_end(e.s);
+		free(e.buf);
+		seq = e.seq;
+
+		double n = (double)s.iters;
+		printf("%s\n    {\"name\": \"%s\", \"iters\": %llu, \"ns_per_op\": %.1f, ",
+			   first ? "" : ",", b->name, (unsigned long long)s.iters, (double)s.ns / n);
+		if (BENCH_COUNTS_ALLOCS) printf("\"allocs_per_op\": %.2f, \"bytes_per_op\": %.1f}", (double)s.allocs / n, (double)s.bytes / n);
+		else                     printf("\"allocs_per_op\": null, \"bytes_per_op\": null}");
+		fflush(stdout);
+		first = false;
+	}
+	printf("\n  ]\n}\n");
+
+	cblu_close(base.db);
+	remove_db(dir, base.name);
+	char oc[80];
+	snprintf(oc, sizeof oc, "%s_oc", base.name);
+	remove_db(dir, oc);
+	return 0;
+}
@@ -0,0 +1,389 @@
+//
+//  cblu_replay.c
+//
+//  Re-executes a trace written by cblu_record_start() against a fresh database
+//  and prints wall time, schedule lag and per-operation latency (from the
+//  library's own statistics) as JSON. Values are synthesized from the recorded
+//  kinds and sizes: strings of 'x', zero-filled arrays and blobs.
+//
+//  Calls are replayed on one thread in recorded order. Traffic recorded from
+//  several threads is therefore serialized; overlapping transactional sessions
+//  nest into one Couchbase Lite transaction instead of running side by side.
+//
+//  Build from the repo root, with CBL pointing at the Couchbase Lite C install:
+//      make bench CBL=/path/to/libcblite     # → build/cblu_replay
+//
+//  Usage: cblu_replay [-S speed] [-R readers] [-F] [-d dir] [-N name] [-k] trace.bin
+//
+//  -S 1 (default) keeps the recorded timing, 2 runs twice as fast, 0 runs at
+//  maximum speed. The database is deleted first unless -k is given; use -k with
+//  a copy of the device's database when the trace reads documents it didn't write
+//  (otherwise those reads are counted as missing_docs and do no work).
+//  -F opens with full_sync.
+//
+
+#include "CBLiteC.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAP_BUCKETS 4096u   // power of two
+#define MAX_STR     4096    // matches the recorder's truncation
+
+typedef struct {
+	double      speed;
+	unsigned    readers;
+	bool        full_sync, keep;
+	const char* dir;
+	const char* name;
+	const char* trace;
+} Config;
+
+static inline uint64_t now_ns(void) {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint64_t)t.tv_sec * 1000000000ull + (uint64_t)t.tv_nsec;
+}
+
+static void sleep_until(uint64_t t_ns) {
+	struct timespec ts = { (time_t)(t_ns / 1000000000ull), (long)(t_ns % 1000000000ull) };
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0) {}
+}
+
+// ---- recorded handle -> live handle ----
+typedef enum { H_SESSION, H_DOCW, H_DOCR, H_QUERY } HKind;
+typedef struct Entry { uint64_t key; void* val; HKind kind; struct Entry* next; } Entry;
+static Entry* g_map[MAP_BUCKETS];
+
+static inline unsigned map_slot(uint64_t key) {
+	return (unsigned)((key * 0x9E3779B97F4A7C15ull) >> 52) & (MAP_BUCKETS - 1);
+}
+
+static void map_put(uint64_t key, void* val, HKind kind) {
+	Entry* e = (Entry*)malloc(sizeof *e);
+	if (!e) return;
+	unsigned s = map_slot(key);
+	*e = (Entry){ key, val, kind, g_map[s] };
+	g_map[s] = e;  // newest first: a reused address shadows nothing still live
+}
+
+static void* map_get(uint64_t key) {
+	for (Entry* e = g_map[map_slot(key)]; e; e = e->next) if (e->key == key) return e->val;
+	return NULL;
+}
+
+static void* map_take(uint64_t key) {
+	for (Entry** pe = &g_map[map_slot(key)]; *pe; pe = &(*pe)->next) {
+		if ((*pe)->key != key) continue;
+		Entry* e = *pe;
+		void* v = e->val;
+		*pe = e->next;
+		free(e);
+		return v;
+	}
+	return NULL;
+}
+
+// ---- trace decoding ----
+typedef struct {
+	const uint8_t* p;
+	const uint8_t* end;
+} Reader;
+
+typedef struct {
+	uint8_t  op;
+	uint64_t dt, h, a, b;
+	char     s[MAX_STR + 1];
+} Rec;
+
+static bool get_varint(Reader* r, uint64_t* out) {
+	uint64_t v = 0;
+	for (unsigned shift = 0; shift < 64 && r->p < r->end; shift += 7) {
+		uint8_t byte = *r->p++;
+		v |= (uint64_t)(byte & 0x7F) << shift;
+		if (!(byte & 0x80)) { *out = v; return true; }
+	}
+	return false;
+}
+
+static bool next_rec(Reader* r, Rec* rec) {
+	if (r->p >= r->end) return false;
+	rec->op = *r->p++;
+	uint64_t len;
+	if (!get_varint(r, &rec->dt) || !get_varint(r, &rec->h) || !get_varint(r, &rec->a) ||
+		!get_varint(r, &len) || len > MAX_STR || (uint64_t)(r->end - r->p) < len) return false;
+	memcpy(rec->s, r->p, len);
+	rec->s[len] = 0;
+	r->p += len;
+	return get_varint(r, &rec->b);
+}
+
+// ---- synthesized values ----
+static char*  g_fill;
+static size_t g_fill_cap;
+
+// At least n+1 bytes of 'x'
+static char* fill(size_t n) {
+	if (n + 1 > g_fill_cap) {
+		char* f = (char*)realloc(g_fill, n + 1);
+		if (!f) return NULL;
+		memset(f + g_fill_cap, 'x', n + 1 - g_fill_cap);
+		g_fill = f;
+		g_fill_cap = n + 1;
+	}
+	return g_fill;
+}
+
+typedef struct {
+	uint64_t records, calls, skipped, errors, missing;
+	uint64_t max_lag_ns, sum_lag_ns;
+} Totals;
+
+static void apply_set(CBLU_DocW* d, const Rec* r, Totals* t) {
+	char* buf;
+	switch ((CBLU_RecKind)r->a) {
+		case CBLU_REC_I64:  cblu_docw_set_i64(d, r->s, 0); break;
+		case CBLU_REC_U64:  cblu_docw_set_u64(d, r->s, 0); break;
+		case CBLU_REC_F64:  cblu_docw_set_f64(d, r->s, 0.0); break;
+		case CBLU_REC_BOOL: cblu_docw_set_bool(d, r->s, false); break;
+		case CBLU_REC_STR:
+			if (!(buf = fill((size_t)r->b))) { t->errors++; return; }
+			buf[r->b] = 0;
+			cblu_docw_set_str(d, r->s, buf);
+			buf[r->b] = 'x';
+			break;
+		case CBLU_REC_F64_ARRAY: {
+			double* a = (double*)calloc(r->b ? (size_t)r->b : 1, sizeof *a);
+			if (a) cblu_docw_set_f64_array(d, r->s, a, (size_t)r->b);
+			free(a);
+			break;
+		}
+		case CBLU_REC_I64_ARRAY: {
+			int64_t* a = (int64_t*)calloc(r->b ? (size_t)r->b : 1, sizeof *a);
+			if (a) cblu_docw_set_i64_array(d, r->s, a, (size_t)r->b);
+			free(a);
+			break;
+		}
+		case CBLU_REC_BLOB:
+			if (!(buf = fill((size_t)r->b)) || !cblu_docw_set_blob(d, r->s, buf, (size_t)r->b, NULL)) t->errors++;
+			break;
+		default: t->skipped++; return;
+	}
+	t->calls++;
+}
+
+static void apply(CBLU_Db* db, const Rec* r, Totals* t) {
+	void* h;
+	switch ((CBLU_RecOp)r->op) {
+		case CBLU_REC_SESSION_BEGIN: {
+			CBLU_Session* s = cblu_session_begin_txn(db, r->a != 0);
+			if (s) map_put(r->h, s, H_SESSION); else t->errors++;
+			break;
+		}
+		case CBLU_REC_SESSION_END:
+			if (!(h = map_take(r->h))) { t->skipped++; return; }
+			cblu_session_end_txn((CBLU_Session*)h, r->a != 0);
+			break;
+		case CBLU_REC_DOCW_BEGIN: {
+			CBLU_Session* s = (CBLU_Session*)map_get(r->a);
+			if (!s) { t->skipped++; return; }
+			CBLU_DocW* d = cblu_docw_begin(s, r->s);
+			if (d) map_put(r->h, d, H_DOCW); else t->errors++;
+			break;
+		}
+		case CBLU_REC_DOCW_SET:
+			if (!(h = map_get(r->h))) { t->skipped++; return; }
+			apply_set((CBLU_DocW*)h, r, t);
+			return;
+		case CBLU_REC_DOCW_SAVE:
+			if (!(h = map_take(r->h))) { t->skipped++; return; }
+			if (!cblu_docw_save((CBLU_DocW*)h) && r->b) t->errors++;  // count only saves that succeeded originally
+			break;
+		case CBLU_REC_DOCW_FREE:
+			if (!(h = map_take(r->h))) { t->skipped++; return; }
+			cblu_docw_free((CBLU_DocW*)h);
+			break;
+		case CBLU_REC_DOCR_GET: {
+			CBLU_Session* s = (CBLU_Session*)map_get(r->a);
+			if (!s) { t->skipped++; return; }
+			CBLU_DocR* d = cblu_docr_get(s, r->s);
+			if (r->h && d) map_put(r->h, d, H_DOCR);
+			else if (d) cblu_docr_free(d);         // missing when recorded
+			else if (r->h) t->missing++;           // present when recorded: written before the trace started
+			break;
+		}
+		case CBLU_REC_DOCR_READ:
+			if (!(h = map_get(r->h))) { t->skipped++; return; }
+			cblu_docr_has((CBLU_DocR*)h, r->s);  // the key lookup; the typed copy-out is negligible
+			break;
+		case CBLU_REC_DOCR_FREE:
+			if (!(h = map_take(r->h))) { t->skipped++; return; }
+			cblu_docr_free((CBLU_DocR*)h);
+			break;
+		case CBLU_REC_QUERY_BEGIN: {
+			CBLU_Session* s = (CBLU_Session*)map_get(r->a);
+			if (!s) { t->skipped++; return; }
+			CBLU_Query* q = cblu_query_begin(s, r->s);
+			if (q) map_put(r->h, q, H_QUERY); else t->errors++;
+			break;
+		}
+		case CBLU_REC_QUERY_FREE: {
+			CBLU_Query* q = (CBLU_Query*)map_take(r->h);
+			if (!q) { t->skipped++; return; }
+			for (uint64_t i = 0; i < r->b && cblu_query_next(q); i++) {}
+			cblu_query_free(q);
+			break;
+		}
+		default: t->skipped++; return;
+	}
+	t->calls++;
+}
+
+// Handles the trace never closed (recording stopped mid-session): documents and
+// queries first, then their sessions, whose transactions are rolled back
+static void close_leftovers(void) {
+	for (int pass = 0; pass < 2; pass++) {
+		for (unsigned i = 0; i < MAP_BUCKETS; i++) {
+			for (Entry** pe = &g_map[i]; *pe; ) {
+				Entry* e = *pe;
+				if ((e->kind == H_SESSION) != (pass == 1)) { pe = &e->next; continue; }
+				switch (e->kind) {
+					case H_SESSION: cblu_session_end_txn((CBLU_Session*)e->val, false); break;
+					case H_DOCW:    cblu_docw_free((CBLU_DocW*)e->val); break;
+					case H_DOCR:    cblu_docr_free((CBLU_DocR*)e->val); break;
+					case H_QUERY:   cblu_query_free((CBLU_Query*)e->val); break;
+				}
+				*pe = e->next;
+				free(e);
+			}
+		}
+	}
+}
+
+// ---- fresh database ----
+static int rm_entry(const char* path, const struct stat* st, int flag, struct FTW* ftw) {
+	(void)st; (void)flag; (void)ftw;
+	return remove(path);
+}
+
+static void db_delete(const Config* c) {
+	char p[4096];
+	snprintf(p, sizeof p, "%s/%s.cblite2", c->dir, c->name);
+	nftw(p, rm_entry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+static void usage(const char* argv0) {
+	fprintf(stderr, "usage: %s [-S speed (0 = max)] [-R readers] [-F] [-d dir] [-N name] [-k] trace.bin\n", argv0);
+}
+
+static void op_print(const CBLU_Stats* st, CBLU_Op op, bool last) {
+	const CBLU_OpStats* s = &st->op[op];
+	printf("    \"%s\": {\"count\": %llu, \"errors\": %llu, \"mean\": %.2f, \"p50\": %.2f, \"p99\": %.2f, \"p999\": %.2f, \"max\": %.2f}%s\n",
+		   cblu_stats_op_name(op), (unsigned long long)s->calls, (unsigned long long)s->errors,
+		   s->calls ? (double)s->sum_ns / (double)s->calls / 1e3 : 0.0,
+		   cblu_stats_percentile_ns(s, 50) / 1e3, cblu_stats_percentile_ns(s, 99) / 1e3,
+		   cblu_stats_percentile_ns(s, 99.9) / 1e3, s->max_ns / 1e3, last ? "" : ",");
+}
+
+int main(int argc, char** argv) {
+	Config c = { .speed = 1.0, .dir = "/tmp", .name = "cblu_replay" };
+	int opt;
+	while ((opt = getopt(argc, argv, "S:R:Fd:N:k")) != -1) {
+		switch (opt) {
+			case 'S': c.speed = strtod(optarg, NULL); break;
+			case 'R': c.readers = (unsigned)strtoul(optarg, NULL, 10); break;
+			case 'F': c.full_sync = true; break;
+			case 'd': c.dir = optarg; break;
+			case 'N': c.name = optarg; break;
+			case 'k': c.keep = true; break;
+			default: usage(argv[0]); return 2;
+		}
+	}
+	if (optind != argc - 1 || c.speed < 0) { usage(argv[0]); return 2; }
+	c.trace = argv[optind];
+
+	int fd = open(c.trace, O_RDONLY);
+	struct stat st;
+	if (fd < 0 || fstat(fd, &st) != 0 || st.st_size < 8) {
+		fprintf(stderr, "cannot read %s: errno=%d\n", c.trace, errno);
+		return 1;
+	}
+	const uint8_t* base = (const uint8_t*)mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED || memcmp(base, "CBLUREC1", 8) != 0) {
+		fprintf(stderr, "%s is not a cblu trace\n", c.trace);
+		return 1;
+	}
+	madvise((void*)base, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+	if (!c.keep) db_delete(&c);
+	CBLU_OpenOptions oo = { .full_sync = c.full_sync };
+	CBLU_Db* db = NULL;
+	if (!cblu_open_ex(c.name, c.dir, &oo, &db)) return 1;
+	if (c.readers && !cblu_open_readers(db, c.readers)) { cblu_close(db); return 1; }
+
+	Rec* rec = (Rec*)malloc(sizeof *rec);
+	Reader r = { base + 8, base + st.st_size };
+	Totals t = {0};
+	CBLU_Stats* before = (CBLU_Stats*)malloc(sizeof *before);
+	CBLU_Stats* after  = (CBLU_Stats*)malloc(sizeof *after);
+	if (!rec || !before || !after) return 1;
+	cblu_stats_snapshot(before);
+
+	uint64_t trace_ns = 0, start = now_ns();
+	while (next_rec(&r, rec)) {
+		trace_ns += rec->dt;
+		if (c.speed > 0) {
+			uint64_t due = start + (uint64_t)((double)trace_ns / c.speed);
+			uint64_t now = now_ns();
+			if (now < due) sleep_until(due);
+			else {
+				uint64_t lag = now - due;
+				t.sum_lag_ns += lag;
+				if (lag > t.max_lag_ns) t.max_lag_ns = lag;
+			}
+		}
+		apply(db, rec, &t);
+		t.records++;
+	}
+	bool truncated = r.p < r.end;
+	double run_s = (double)(now_ns() - start) / 1e9;
+
+	close_leftovers();
+	cblu_stats_snapshot(after);
+	for (int op = 0; op < CBLU_OP_COUNT; op++) {  // only what the replay did
+		CBLU_OpStats* a = &after->op[op];
+		const CBLU_OpStats* b = &before->op[op];
+		a->calls -= b->calls; a->errors -= b->errors; a->sum_ns -= b->sum_ns;
+		for (unsigned k = 0; k < CBLU_STATS_BUCKETS; k++) a->buckets[k] -= b->buckets[k];
+	}
+
+	printf("{\n  \"trace\": \"%s\", \"trace_seconds\": %.3f, \"speed\": %.2f, \"truncated\": %s,\n",
+		   c.trace, (double)trace_ns / 1e9, c.speed, truncated ? "true" : "false");
+	printf("  \"records\": %llu, \"calls\": %llu, \"skipped\": %llu, \"errors\": %llu, \"missing_docs\": %llu,\n",
+		   (unsigned long long)t.records, (unsigned long long)t.calls, (unsigned long long)t.skipped,
+		   (unsigned long long)t.errors, (unsigned long long)t.missing);
+	printf("  \"seconds\": %.3f, \"calls_per_sec\": %.1f, \"lag_ms\": {\"mean\": %.3f, \"max\": %.3f},\n",
+		   run_s, run_s > 0 ? (double)t.calls / run_s : 0.0,
+		   t.records ? (double)t.sum_lag_ns / (double)t.records / 1e6 : 0.0, t.max_lag_ns / 1e6);
+	printf("  \"latency_us\": {\n");
+	op_print(after, CBLU_OP_SAVE, false);
+	op_print(after, CBLU_OP_GET, false);
+	op_print(after, CBLU_OP_QUERY, false);
+	op_print(after, CBLU_OP_COMMIT, false);
+	op_print(after, CBLU_OP_ROLLBACK, true);
+	printf("  }\n}\n");
+
+	cblu_close(db);
+	munmap((void*)base, (size_t)st.st_size);
+	free(rec); free(before); free(after); free(g_fill);
+	return t.errors ? 1 : 0;
+}
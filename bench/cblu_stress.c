@@ -0,0 +1,345 @@
+//
+//  cblu_stress.c
+//
+//  Concurrency stress test for the threading model in CBLiteC.h. N threads
+//  run a random mix against one CBLU_Db and check invariants as they go:
+//
+//      read      own document through cblu_session_thread; must match the
+//                version this thread last saved (read-your-writes)
+//      write     own document, plain save through cblu_session_thread
+//      transfer  move an amount between two shared accounts in a transaction
+//                session, committing 90% and rolling back 10%; the sum of all
+//                balances must be unchanged at the end
+//      handoff   fetch an own document in a short-lived session, end the
+//                session, and pass the CBLU_DocR to whichever thread picks it
+//                up next; that thread must see the snapshot as fetched
+//
+//  Meant to be run under ThreadSanitizer. Couchbase Lite itself is usually an
+//  uninstrumented prebuilt library, so races inside it are not reported; the
+//  wrapper and this driver are. Build from the repo root, with CBL pointing at
+//  the Couchbase Lite C install (library and driver get -fsanitize=thread):
+//      make stress CBL=/path/to/libcblite && build/cblu_stress
+//
+//  Usage: cblu_stress [-t threads] [-o ops-per-thread] [-k keys-per-thread]
+//                     [-a accounts] [-R readers] [-d dir] [-n name]
+//
+//  Prints a JSON summary; exits 1 if any invariant was violated or an operation failed.
+//
+
+#include "CBLiteC.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include <unistd.h>
+
+#define INITIAL_BALANCE  1000
+#define HANDOFF_SLOTS    64
+
+typedef struct {
+	unsigned threads, keys, accounts, readers;
+	uint64_t ops;
+	const char* dir;
+	const char* name;
+} Config;
+
+// ---- handoff ring: DocR snapshots passed between threads ----
+typedef struct { CBLU_DocR* d; int64_t owner, key, v; } Handoff;
+
+typedef struct {
+	pthread_mutex_t mu;
+	Handoff  slot[HANDOFF_SLOTS];
+	unsigned head, n;
+} HandoffRing;
+
+static bool ring_push(HandoffRing* r, Handoff h) {
+	pthread_mutex_lock(&r->mu);
+	bool ok = r->n < HANDOFF_SLOTS;
+	if (ok) { r->slot[(r->head + r->n) % HANDOFF_SLOTS] = h; r->n++; }
+	pthread_mutex_unlock(&r->mu);
+	return ok;
+}
+
+static bool ring_pop(HandoffRing* r, Handoff* out) {
+	pthread_mutex_lock(&r->mu);
+	bool ok = r->n > 0;
+	if (ok) { *out = r->slot[r->head]; r->head = (r->head + 1) % HANDOFF_SLOTS; r->n--; }
+	pthread_mutex_unlock(&r->mu);
+	return ok;
+}
+
+// ---- shared state ----
+typedef struct {
+	const Config* cfg;
+	CBLU_Db*      db;
+	uint64_t      run;
+	HandoffRing   ring;
+} Shared;
+
+typedef struct {
+	Shared*   sh;
+	pthread_t th;
+	unsigned  id;
+	uint64_t  rng;
+	int64_t*  last;   // version this thread last saved, per key (0: never)
+	uint64_t  reads, writes, txns, rollbacks, handoffs_sent, handoffs_checked;
+	uint64_t  stale_reads, bad_handoffs, errors;
+} Worker;
+
+static inline uint64_t rng_next(uint64_t* s) {  // splitmix64
+	uint64_t z = (*s += 0x9E3779B97F4A7C15ull);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+	return z ^ (z >> 31);
+}
+
+static inline uint64_t now_ns(void) {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint64_t)t.tv_sec * 1000000000ull + (uint64_t)t.tv_nsec;
+}
+
+static void own_id(const Worker* w, char* dst, size_t n, uint64_t key) {
+	snprintf(dst, n, "%llx:t%u:%llu", (unsigned long long)w->sh->run, w->id, (unsigned long long)key);
+}
+
+static void acct_id(char* dst, size_t n, unsigned a) {
+	snprintf(dst, n, "acct:%u", a);
+}
+
+// ---- operations ----
+static void op_write(Worker* w, CBLU_Session* s, uint64_t key) {
+	char id[64];
+	own_id(w, id, sizeof id, key);
+	CBLU_DocW* d = cblu_docw_begin(s, id);
+	if (!d) { w->errors++; return; }
+	int64_t v = w->last[key] + 1;
+	cblu_docw_set_i64(d, "owner", w->id);
+	cblu_docw_set_i64(d, "key", (int64_t)key);
+	cblu_docw_set_i64(d, "v", v);
+	if (cblu_docw_save(d)) w->last[key] = v;
+	else w->errors++;
+	w->writes++;
+}
+
+static void op_read(Worker* w, CBLU_Session* s, uint64_t key) {
+	char id[64];
+	own_id(w, id, sizeof id, key);
+	CBLU_DocR* d = cblu_docr_get(s, id);
+	int64_t v = 0;
+	if (d) cblu_docr_get_i64(d, "v", &v);
+	if (v != w->last[key]) w->stale_reads++;
+	cblu_docr_free(d);
+	w->reads++;
+}
+
+static void op_transfer(Worker* w) {
+	const Config* c = w->sh->cfg;
+	unsigned a = (unsigned)(rng_next(&w->rng) % c->accounts), b = (unsigned)(rng_next(&w->rng) % c->accounts);
+	if (a == b) return;
+	int64_t amount = (int64_t)(rng_next(&w->rng) % 50) + 1;
+	bool commit = rng_next(&w->rng) % 10 != 0;
+
+	CBLU_Session* s = cblu_session_begin_txn(w->sh->db, true);
+	if (!s) { w->errors++; return; }
+	char ida[32], idb[32];
+	acct_id(ida, sizeof ida, a);
+	acct_id(idb, sizeof idb, b);
+	int64_t ba = 0, bb = 0;
+	CBLU_DocR* ra = cblu_docr_get(s, ida);
+	CBLU_DocR* rb = cblu_docr_get(s, idb);
+	bool ok = ra && rb && cblu_docr_get_i64(ra, "bal", &ba) && cblu_docr_get_i64(rb, "bal", &bb);
+	cblu_docr_free(ra);
+	cblu_docr_free(rb);
+
+	CBLU_DocW* wa = ok ? cblu_docw_begin(s, ida) : NULL;
+	if (wa) { cblu_docw_set_i64(wa, "bal", ba - amount); ok = cblu_docw_save(wa); }
+	else ok = false;
+	CBLU_DocW* wb = ok ? cblu_docw_begin(s, idb) : NULL;
+	if (wb) { cblu_docw_set_i64(wb, "bal", bb + amount); ok = cblu_docw_save(wb); }
+	else ok = false;
+
+	cblu_session_end_txn(s, ok && commit);
+	if (!ok) w->errors++;
+	else if (commit) w->txns++;
+	else w->rollbacks++;
+}
+
+// The DocR outlives the session it came from and is freed by another thread
+static void op_handoff_send(Worker* w, uint64_t key) {
+	if (w->last[key] == 0) return;
+	char id[64];
+	own_id(w, id, sizeof id, key);
+	CBLU_Session* s = cblu_session_begin(w->sh->db);
+	if (!s) { w->errors++; return; }
+	CBLU_DocR* d = cblu_docr_get(s, id);
+	cblu_session_end(s);
+	if (!d) { w->errors++; return; }
+	Handoff h = { .d = d, .owner = w->id, .key = (int64_t)key };
+	cblu_docr_get_i64(d, "v", &h.v);
+	if (ring_push(&w->sh->ring, h)) w->handoffs_sent++;
+	else cblu_docr_free(d);
+}
+
+static bool handoff_check(Handoff* h) {
+	int64_t owner = -1, key = -1, v = -1;
+	bool ok = cblu_docr_get_i64(h->d, "owner", &owner) && cblu_docr_get_i64(h->d, "key", &key) &&
+			  cblu_docr_get_i64(h->d, "v", &v);
+	cblu_docr_free(h->d);
+	return ok && owner == h->owner && key == h->key && v == h->v && v > 0;
+}
+
+static void op_handoff_recv(Worker* w) {
+	Handoff h;
+	if (!ring_pop(&w->sh->ring, &h)) return;
+	if (!handoff_check(&h)) w->bad_handoffs++;
+	w->handoffs_checked++;
+}
+
+static void* worker_run(void* arg) {
+	Worker* w = (Worker*)arg;
+	const Config* c = w->sh->cfg;
+	for (uint64_t i = 0; i < c->ops; i++) {
+		CBLU_Session* s = cblu_session_thread(w->sh->db);  // same session every time on this thread
+		if (!s) { w->errors++; break; }
+		uint64_t key = rng_next(&w->rng) % c->keys;
+		unsigned r = (unsigned)(rng_next(&w->rng) % 100);
+		if      (r < 45) op_read(w, s, key);
+		else if (r < 75) op_write(w, s, key);
+		else if (r < 85) op_transfer(w);
+		else             op_handoff_send(w, key);
+		op_handoff_recv(w);
+	}
+	return NULL;  // the thread's session is freed at exit
+}
+
+// ---- setup and final audit ----
+static bool seed_accounts(Shared* sh) {
+	CBLU_Session* s = cblu_session_begin_txn(sh->db, true);
+	if (!s) return false;
+	bool ok = true;
+	char id[32];
+	for (unsigned a = 0; a < sh->cfg->accounts && ok; a++) {
+		acct_id(id, sizeof id, a);
+		CBLU_DocW* d = cblu_docw_begin(s, id);
+		if (!d) { ok = false; break; }
+		cblu_docw_set_i64(d, "bal", INITIAL_BALANCE);
+		ok = cblu_docw_save(d);
+	}
+	cblu_session_end_txn(s, ok);
+	return ok;
+}
+
+static bool sum_balances(Shared* sh, int64_t* out) {
+	CBLU_Session* s = cblu_session_begin_txn(sh->db, true);  // primary handle: sees every commit
+	if (!s) return false;
+	int64_t sum = 0;
+	bool ok = true;
+	char id[32];
+	for (unsigned a = 0; a < sh->cfg->accounts && ok; a++) {
+		acct_id(id, sizeof id, a);
+		CBLU_DocR* d = cblu_docr_get(s, id);
+		int64_t bal = 0;
+		ok = d && cblu_docr_get_i64(d, "bal", &bal);
+		sum += bal;
+		cblu_docr_free(d);
+	}
+	cblu_session_end_txn(s, false);
+	*out = sum;
+	return ok;
+}
+
+static void usage(const char* argv0) {
+	fprintf(stderr,
+		"usage: %s [-t threads] [-o ops-per-thread] [-k keys-per-thread] [-a accounts]\n"
+		"          [-R readers] [-d dir] [-n name]\n", argv0);
+}
+
+int main(int argc, char** argv) {
+	Config c = { .threads = 16, .ops = 20000, .keys = 256, .accounts = 32, .dir = "/tmp", .name = "cblu_stress" };
+	int opt;
+	while ((opt = getopt(argc, argv, "t:o:k:a:R:d:n:")) != -1) {
+		switch (opt) {
+			case 't': c.threads = (unsigned)strtoul(optarg, NULL, 10); break;
+			case 'o': c.ops = strtoull(optarg, NULL, 10); break;
+			case 'k': c.keys = (unsigned)strtoul(optarg, NULL, 10); break;
+			case 'a': c.accounts = (unsigned)strtoul(optarg, NULL, 10); break;
+			case 'R': c.readers = (unsigned)strtoul(optarg, NULL, 10); break;
+			case 'd': c.dir = optarg; break;
+			case 'n': c.name = optarg; break;
+			default: usage(argv[0]); return 2;
+		}
+	}
+	if (!c.threads || !c.keys || c.accounts < 2) {
+		usage(argv[0]);
+		return 2;
+	}
+
+	// Per-run document ids, so the read-your-writes check ignores earlier runs' documents
+	Shared sh = { .cfg = &c, .run = now_ns() };
+	pthread_mutex_init(&sh.ring.mu, NULL);
+	if (!cblu_open(c.name, c.dir, &sh.db)) return 1;
+	if (c.readers && !cblu_open_readers(sh.db, c.readers)) { cblu_close(sh.db); return 1; }
+	if (!seed_accounts(&sh)) { fprintf(stderr, "stress: seeding accounts failed\n"); cblu_close(sh.db); return 1; }
+
+	Worker* ws = (Worker*)calloc(c.threads, sizeof *ws);
+	if (!ws) return 1;
+	for (unsigned i = 0; i < c.threads; i++) {
+		ws[i].sh = &sh;
+		ws[i].id = i;
+		ws[i].rng = 0x5EED0000ull + i;
+		ws[i].last = (int64_t*)calloc(c.keys, sizeof *ws[i].last);
+		if (!ws[i].last) return 1;
+	}
+
+	uint64_t t0 = now_ns();
+	for (unsigned i = 0; i < c.threads; i++) pthread_create(&ws[i].th, NULL, worker_run, &ws[i]);
+	for (unsigned i = 0; i < c.threads; i++) pthread_join(ws[i].th, NULL);
+	double run_s = (double)(now_ns() - t0) / 1e9;
+
+	// Snapshots still queued were fetched by threads that have since exited
+	Worker tail = { .sh = &sh };
+	Handoff h;
+	while (ring_pop(&sh.ring, &h)) {
+		if (!handoff_check(&h)) tail.bad_handoffs++;
+		tail.handoffs_checked++;
+	}
+
+	Worker t = tail;
+	for (unsigned i = 0; i < c.threads; i++) {
+		t.reads += ws[i].reads;  t.writes += ws[i].writes;
+		t.txns += ws[i].txns;    t.rollbacks += ws[i].rollbacks;
+		t.handoffs_sent += ws[i].handoffs_sent;
+		t.handoffs_checked += ws[i].handoffs_checked;
+		t.stale_reads += ws[i].stale_reads;
+		t.bad_handoffs += ws[i].bad_handoffs;
+		t.errors += ws[i].errors;
+	}
+	int64_t expected = (int64_t)c.accounts * INITIAL_BALANCE, actual = 0;
+	if (!sum_balances(&sh, &actual)) t.errors++;
+	uint64_t ops = (uint64_t)c.threads * c.ops;
+
+	printf("{\n  \"threads\": %u, \"ops_per_thread\": %llu, \"keys_per_thread\": %u, \"accounts\": %u, \"readers\": %u,\n",
+		   c.threads, (unsigned long long)c.ops, c.keys, c.accounts, c.readers);
+	printf("  \"run_seconds\": %.3f, \"ops_per_sec\": %.1f,\n", run_s, run_s > 0 ? (double)ops / run_s : 0.0);
+	printf("  \"reads\": %llu, \"writes\": %llu, \"txn_commits\": %llu, \"txn_rollbacks\": %llu,\n",
+		   (unsigned long long)t.reads, (unsigned long long)t.writes,
+		   (unsigned long long)t.txns, (unsigned long long)t.rollbacks);
+	printf("  \"handoffs_sent\": %llu, \"handoffs_checked\": %llu,\n",
+		   (unsigned long long)t.handoffs_sent, (unsigned long long)t.handoffs_checked);
+	printf("  \"stale_reads\": %llu, \"bad_handoffs\": %llu, \"balance_expected\": %lld, \"balance_actual\": %lld,\n",
+		   (unsigned long long)t.stale_reads, (unsigned long long)t.bad_handoffs, (long long)expected, (long long)actual);
+	printf("  \"errors\": %llu, \"wrapper_errors\": %llu\n}\n",
+		   (unsigned long long)t.errors, (unsigned long long)cblu_errors_total());
+
+	bool pass = !t.errors && !t.stale_reads && !t.bad_handoffs && t.handoffs_checked == t.handoffs_sent &&
+				actual == expected;
+	for (unsigned i = 0; i < c.threads; i++) free(ws[i].last);
+	free(ws);
+	cblu_close(sh.db);
+	pthread_mutex_destroy(&sh.ring.mu);
+	return pass ? 0 : 1;
+}
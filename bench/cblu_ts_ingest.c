@@ -0,0 +1,284 @@
+//
+//  cblu_ts_ingest.c
+//
+//  Time-series ingest benchmark shaped like our sensor nodes: many small numeric
+//  reading documents at a fixed rate, plus a periodic f64 waveform document per
+//  sensor. One writer thread (as on the devices) paces the stream and reports
+//  sustained throughput, latency percentiles, database growth and write
+//  amplification as JSON.
+//
+//  Latency is measured from each document's scheduled time, so falling behind
+//  the target rate shows up in the tail instead of being hidden.
+//  Write amplification is bytes sent to the block device (write_bytes in
+//  /proc/self/io, Linux only) per logical payload byte; the logical size counts
+//  8 bytes per number plus string and array contents.
+//
+//  Build from the repo root, with CBL pointing at the Couchbase Lite C install:
+//      make bench CBL=/path/to/libcblite     # → build/cblu_ts_ingest
+//
+//  Usage: cblu_ts_ingest [-s sensors] [-r readings/s per sensor | 0 = unpaced]
+//                        [-w waveform period s] [-n waveform samples] [-b docs per txn]
+//                        [-T seconds] [-F] [-d dir] [-N name]
+//
+//  -F opens with full_sync and commits every document (-b 1), modelling SD cards
+//  where every commit has to reach the medium.
+//
+
+#include "CBLiteC.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ftw.h>
+#include <getopt.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define HIST_SUB_BITS 6
+#define HIST_SUB      (1u << HIST_SUB_BITS)
+#define HIST_BUCKETS  ((64 - HIST_SUB_BITS + 1) * HIST_SUB)
+
+typedef struct {
+	unsigned sensors, samples, batch;
+	double   rate, wave_period, seconds;
+	bool     full_sync;
+	const char* dir;
+	const char* name;
+} Config;
+
+// ---- latency histogram (log-linear, ns) ----
+typedef struct { uint64_t count, sum, max, b[HIST_BUCKETS]; } Hist;
+
+static inline unsigned hist_index(uint64_t v) {
+	if (v < HIST_SUB) return (unsigned)v;
+	unsigned exp = 63u - (unsigned)__builtin_clzll(v);
+	return (exp - HIST_SUB_BITS + 1) * HIST_SUB + (unsigned)((v >> (exp - HIST_SUB_BITS)) & (HIST_SUB - 1));
+}
+
+static inline uint64_t hist_value(unsigned idx) {
+	if (idx < HIST_SUB) return idx;
+	unsigned exp = idx / HIST_SUB + HIST_SUB_BITS - 1, sub = idx % HIST_SUB;
+	return ((uint64_t)(HIST_SUB + sub + 1) << (exp - HIST_SUB_BITS)) - 1;
+}
+
+static inline void hist_add(Hist* h, uint64_t v) {
+	h->count++; h->sum += v;
+	if (v > h->max) h->max = v;
+	h->b[hist_index(v)]++;
+}
+
+static uint64_t hist_pct(const Hist* h, double p) {
+	if (!h->count) return 0;
+	uint64_t want = (uint64_t)ceil(p / 100.0 * (double)h->count), seen = 0;
+	for (unsigned i = 0; i < HIST_BUCKETS; i++) {
+		seen += h->b[i];
+		if (seen >= want) { uint64_t v = hist_value(i); return v < h->max ? v : h->max; }
+	}
+	return h->max;
+}
+
+static void hist_print(const char* name, const Hist* h, bool last) {
+	printf("    \"%s\": {\"count\": %llu, \"mean\": %.2f, \"p50\": %.2f, \"p99\": %.2f, \"p999\": %.2f, \"max\": %.2f}%s\n",
+		   name, (unsigned long long)h->count, h->count ? (double)h->sum / (double)h->count / 1e3 : 0.0,
+		   hist_pct(h, 50) / 1e3, hist_pct(h, 99) / 1e3, hist_pct(h, 99.9) / 1e3, h->max / 1e3, last ? "" : ",");
+}
+
+// ---- measurements ----
+static inline uint64_t now_ns(void) {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint64_t)t.tv_sec * 1000000000ull + (uint64_t)t.tv_nsec;
+}
+
+static void sleep_until(uint64_t t_ns) {
+	struct timespec ts = { (time_t)(t_ns / 1000000000ull), (long)(t_ns % 1000000000ull) };
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0) {}
+}
+
+// write_bytes from /proc/self/io; -1 where unavailable
+static long long proc_write_bytes(void) {
+	FILE* f = fopen("/proc/self/io", "r");
+	if (!f) return -1;
+	char line[128];
+	long long v = -1;
+	while (fgets(line, sizeof line, f)) {
+		if (sscanf(line, "write_bytes: %lld", &v) == 1) break;
+	}
+	fclose(f);
+	return v;
+}
+
+static uint64_t g_du;
+static int du_entry(const char* path, const struct stat* st, int flag, struct FTW* ftw) {
+	(void)path; (void)ftw;
+	if (flag == FTW_F) g_du += (uint64_t)st->st_size;
+	return 0;
+}
+
+static uint64_t db_size(const Config* c) {
+	char p[4096];
+	snprintf(p, sizeof p, "%s/%s.cblite2", c->dir, c->name);
+	g_du = 0;
+	nftw(p, du_entry, 16, FTW_PHYS);
+	return g_du;
+}
+
+// ---- writer ----
+typedef struct {
+	const Config* c;
+	CBLU_Db*      db;
+	CBLU_Session* s;
+	unsigned      in_txn;
+	uint64_t      docs, waves, logical, errors;
+	double*       wave;
+	Hist          lat_reading, lat_wave, lat_commit;
+	uint64_t      ids;
+} Writer;
+
+static void writer_commit(Writer* w) {
+	if (!w->s) return;
+	uint64_t t0 = now_ns();
+	cblu_session_end_txn(w->s, true);
+	hist_add(&w->lat_commit, now_ns() - t0);
+	w->s = NULL;
+	w->in_txn = 0;
+}
+
+static CBLU_Session* writer_session(Writer* w) {
+	if (!w->s) w->s = cblu_session_begin_txn(w->db, w->c->batch > 1);
+	return w->s;
+}
+
+// Counts towards the batch and commits when it is full
+static void writer_done(Writer* w, bool ok) {
+	if (!ok) w->errors++;
+	if (++w->in_txn >= w->c->batch) writer_commit(w);
+}
+
+static void write_reading(Writer* w, unsigned sensor, int64_t ts_us) {
+	char id[48], tag[16];
+	snprintf(id, sizeof id, "r:%u:%llu", sensor, (unsigned long long)w->ids++);
+	snprintf(tag, sizeof tag, "s%03u", sensor);
+	CBLU_DocW* d = cblu_docw_begin(writer_session(w), id);
+	cblu_docw_set_str(d, "sensor", tag);
+	cblu_docw_set_i64(d, "ts", ts_us);
+	cblu_docw_set_f64(d, "v", 20.0 + sin((double)ts_us * 1e-6) * (double)(sensor % 7));
+	cblu_docw_set_f64(d, "q", 0.95);
+	writer_done(w, cblu_docw_save(d));
+	w->logical += strlen(tag) + 3 * 8;
+	w->docs++;
+}
+
+static void write_waveform(Writer* w, unsigned sensor, int64_t ts_us) {
+	char id[48], tag[16];
+	snprintf(id, sizeof id, "w:%u:%llu", sensor, (unsigned long long)w->ids++);
+	snprintf(tag, sizeof tag, "s%03u", sensor);
+	for (unsigned i = 0; i < w->c->samples; i++) w->wave[i] = sin((double)(i + sensor) * 0.01) + (double)(ts_us & 0xFF) * 1e-3;
+	CBLU_DocW* d = cblu_docw_begin(writer_session(w), id);
+	cblu_docw_set_str(d, "sensor", tag);
+	cblu_docw_set_i64(d, "ts", ts_us);
+	cblu_docw_set_f64(d, "rate_hz", 1000.0);
+	cblu_docw_set_f64_array(d, "samples", w->wave, w->c->samples);
+	writer_done(w, cblu_docw_save(d));
+	w->logical += strlen(tag) + 2 * 8 + (uint64_t)w->c->samples * 8;
+	w->docs++;
+	w->waves++;
+}
+
+static void usage(const char* argv0) {
+	fprintf(stderr,
+		"usage: %s [-s sensors] [-r readings/s per sensor | 0] [-w waveform period s]\n"
+		"          [-n waveform samples] [-b docs per txn] [-T seconds] [-F] [-d dir] [-N name]\n", argv0);
+}
+
+int main(int argc, char** argv) {
+	Config c = { .sensors = 32, .samples = 4096, .batch = 100, .rate = 10.0, .wave_period = 5.0,
+				 .seconds = 30.0, .dir = "/tmp", .name = "cblu_ts_ingest" };
+	int opt;
+	while ((opt = getopt(argc, argv, "s:r:w:n:b:T:Fd:N:")) != -1) {
+		switch (opt) {
+			case 's': c.sensors = (unsigned)strtoul(optarg, NULL, 10); break;
+			case 'r': c.rate = strtod(optarg, NULL); break;
+			case 'w': c.wave_period = strtod(optarg, NULL); break;
+			case 'n': c.samples = (unsigned)strtoul(optarg, NULL, 10); break;
+			case 'b': c.batch = (unsigned)strtoul(optarg, NULL, 10); break;
+			case 'T': c.seconds = strtod(optarg, NULL); break;
+			case 'F': c.full_sync = true; break;
+			case 'd': c.dir = optarg; break;
+			case 'N': c.name = optarg; break;
+			default: usage(argv[0]); return 2;
+		}
+	}
+	if (!c.sensors || c.seconds <= 0 || c.rate < 0) { usage(argv[0]); return 2; }
+	if (c.full_sync) c.batch = 1;
+	if (!c.batch) c.batch = 1;
+
+	uint64_t size0 = db_size(&c);
+	long long io0 = proc_write_bytes();
+
+	CBLU_OpenOptions oo = { .full_sync = c.full_sync };
+	Writer w = { .c = &c };
+	if (!cblu_open_ex(c.name, c.dir, &oo, &w.db)) return 1;
+	w.wave = (double*)calloc(c.samples ? c.samples : 1, sizeof *w.wave);
+
+	// Readings are spread evenly: one every 1/(sensors*rate) s, sensors round-robin
+	uint64_t interval = c.rate > 0 ? (uint64_t)(1e9 / (c.rate * (double)c.sensors)) : 0;
+	uint64_t wave_ns  = c.wave_period > 0 ? (uint64_t)(c.wave_period * 1e9) : 0;
+	uint64_t start = now_ns(), end = start + (uint64_t)(c.seconds * 1e9);
+	uint64_t next_wave = wave_ns ? start + wave_ns : UINT64_MAX;
+	uint64_t sec_mark = start + 1000000000ull, sec_docs = 0;
+	double   min_sec_rate = INFINITY;
+
+	for (uint64_t i = 0;; i++) {
+		uint64_t due = interval ? start + i * interval : now_ns();
+		if (due >= end) break;
+		if (interval) sleep_until(due);
+		write_reading(&w, (unsigned)(i % c.sensors), (int64_t)((due - start) / 1000));
+		uint64_t t = now_ns();
+		hist_add(&w.lat_reading, t - due);
+
+		if (t >= next_wave) {
+			uint64_t wdue = next_wave;
+			for (unsigned sn = 0; sn < c.sensors; sn++) {
+				write_waveform(&w, sn, (int64_t)((wdue - start) / 1000));
+				hist_add(&w.lat_wave, now_ns() - wdue);
+			}
+			next_wave += wave_ns;
+		}
+		while (t >= sec_mark) {  // slowest whole second = sustained rate
+			double r = (double)(w.docs - sec_docs);
+			if (r < min_sec_rate) min_sec_rate = r;
+			sec_docs = w.docs;
+			sec_mark += 1000000000ull;
+		}
+		if (!interval && t >= end) break;
+	}
+	writer_commit(&w);
+	double run_s = (double)(now_ns() - start) / 1e9;
+	cblu_close(w.db);  // include checkpoint writes from close
+
+	uint64_t size1 = db_size(&c);
+	long long io1 = proc_write_bytes();
+	double wa = (io0 >= 0 && io1 >= 0 && w.logical) ? (double)(io1 - io0) / (double)w.logical : -1;
+
+	printf("{\n  \"sensors\": %u, \"rate_per_sensor\": %.2f, \"waveform_period_s\": %.2f, \"waveform_samples\": %u,\n",
+		   c.sensors, c.rate, c.wave_period, c.samples);
+	printf("  \"docs_per_txn\": %u, \"full_sync\": %s, \"seconds\": %.3f,\n",
+		   c.batch, c.full_sync ? "true" : "false", run_s);
+	printf("  \"docs\": %llu, \"waveforms\": %llu, \"errors\": %llu, \"docs_per_sec\": %.1f, \"min_docs_in_a_second\": %.0f,\n",
+		   (unsigned long long)w.docs, (unsigned long long)w.waves, (unsigned long long)w.errors,
+		   run_s > 0 ? (double)w.docs / run_s : 0.0, isinf(min_sec_rate) ? 0.0 : min_sec_rate);
+	printf("  \"logical_bytes\": %llu, \"db_bytes_before\": %llu, \"db_bytes_after\": %llu,\n",
+		   (unsigned long long)w.logical, (unsigned long long)size0, (unsigned long long)size1);
+	if (wa >= 0) printf("  \"device_write_bytes\": %lld, \"write_amplification\": %.2f,\n", io1 - io0, wa);
+	else         printf("  \"device_write_bytes\": null, \"write_amplification\": null,\n");
+	printf("  \"latency_us\": {\n");
+	hist_print("reading", &w.lat_reading, false);
+	hist_print("waveform", &w.lat_wave, false);
+	hist_print("commit", &w.lat_commit, true);
+	printf("  }\n}\n");
+
+	free(w.wave);
+	return w.errors ? 1 : 0;
+}
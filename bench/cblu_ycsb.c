@@ -0,0 +1,419 @@
+//
+//  cblu_ycsb.c
+//
+//  YCSB-style workload driver over cblu_docw_* / cblu_docr_*. Loads records,
+//  then runs one of the core workloads from N threads and prints throughput
+//  and per-operation latency percentiles as JSON.
+//
+//      A  50% read, 50% update           zipfian
+//      B  95% read,  5% update           zipfian
+//      C 100% read                       zipfian
+//      D  95% read,  5% insert           latest
+//      E  95% scan,  5% insert           zipfian (scan length uniform 1..max)
+//      F  50% read, 50% read-modify-write zipfian
+//
+//  Build from the repo root, with CBL pointing at the Couchbase Lite C install:
+//      make bench CBL=/path/to/libcblite     # → build/cblu_ycsb
+//
+//  Usage: cblu_ycsb [-w A-F] [-t threads] [-r records] [-o ops | -T seconds]
+//                   [-k zipfian|uniform|latest] [-s str|f64|mixed] [-f fields]
+//                   [-l field-bytes] [-R readers] [-S max-scan] [-d dir] [-n name] [-x]
+//
+//  -x skips the load phase and reuses an existing database of the same name.
+//  Updates rewrite the whole record, since a cblu_docw_* save replaces the document.
+//
+
+#include "CBLiteC.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include <unistd.h>
+
+#define ZIPF_THETA    0.99
+#define LOAD_BATCH    1000
+#define HIST_SUB_BITS 6                 // 64 sub-buckets per power of two: <1.6% error
+#define HIST_SUB      (1u << HIST_SUB_BITS)
+#define HIST_BUCKETS  ((64 - HIST_SUB_BITS + 1) * HIST_SUB)
+
+enum { OP_READ, OP_UPDATE, OP_INSERT, OP_SCAN, OP_RMW, OP_COUNT };
+static const char* const kOpNames[OP_COUNT] = { "read", "update", "insert", "scan", "read_modify_write" };
+
+enum { DIST_ZIPF, DIST_UNIFORM, DIST_LATEST };
+enum { SHAPE_STR, SHAPE_F64, SHAPE_MIXED };
+
+typedef struct {
+	char     workload;
+	unsigned threads, fields, field_len, readers, max_scan;
+	uint64_t records, ops;
+	double   seconds;
+	int      dist, shape;
+	bool     skip_load;
+	const char* dir;
+	const char* name;
+} Config;
+
+typedef struct { double read, update, insert, scan, rmw; } Mix;
+
+// ---- random numbers ----
+static inline uint64_t rng_next(uint64_t* s) {  // splitmix64
+	uint64_t z = (*s += 0x9E3779B97F4A7C15ull);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+	return z ^ (z >> 31);
+}
+static inline double rng_unit(uint64_t* s) { return (double)(rng_next(s) >> 11) * (1.0 / 9007199254740992.0); }
+
+static inline uint64_t fnv64(uint64_t v) {
+	uint64_t h = 0xCBF29CE484222325ull;
+	for (int i = 0; i < 8; i++) { h ^= (v >> (8 * i)) & 0xFF; h *= 0x100000001B3ull; }
+	return h;
+}
+
+// Zipfian over [0, n) after Gray et al., as in YCSB; n may grow (for "latest")
+typedef struct { uint64_t n; double zetan, zeta2, alpha, eta; } Zipf;
+
+static double zeta_range(uint64_t from, uint64_t to, double theta) {
+	double sum = 0;
+	for (uint64_t i = from; i < to; i++) sum += 1.0 / pow((double)(i + 1), theta);
+	return sum;
+}
+
+static void zipf_init(Zipf* z, uint64_t n) {
+	z->n = n;
+	z->zeta2 = zeta_range(0, 2, ZIPF_THETA);
+	z->zetan = zeta_range(0, n, ZIPF_THETA);
+	z->alpha = 1.0 / (1.0 - ZIPF_THETA);
+	z->eta   = (1.0 - pow(2.0 / (double)n, 1.0 - ZIPF_THETA)) / (1.0 - z->zeta2 / z->zetan);
+}
+
+static uint64_t zipf_next(Zipf* z, uint64_t n, uint64_t* rng) {
+	if (n > z->n) {  // incremental zeta for newly inserted items
+		z->zetan += zeta_range(z->n, n, ZIPF_THETA);
+		z->n = n;
+		z->eta = (1.0 - pow(2.0 / (double)n, 1.0 - ZIPF_THETA)) / (1.0 - z->zeta2 / z->zetan);
+	}
+	double u = rng_unit(rng), uz = u * z->zetan;
+	if (uz < 1.0) return 0;
+	if (uz < 1.0 + pow(0.5, ZIPF_THETA)) return 1;
+	uint64_t r = (uint64_t)((double)z->n * pow(z->eta * u - z->eta + 1.0, z->alpha));
+	return r < z->n ? r : z->n - 1;
+}
+
+// ---- latency histogram (log-linear, ns) ----
+typedef struct { uint64_t count, sum, max, b[HIST_BUCKETS]; } Hist;
+
+static inline unsigned hist_index(uint64_t v) {
+	if (v < HIST_SUB) return (unsigned)v;
+	unsigned exp = 63u - (unsigned)__builtin_clzll(v);
+	return (exp - HIST_SUB_BITS + 1) * HIST_SUB + (unsigned)((v >> (exp - HIST_SUB_BITS)) & (HIST_SUB - 1));
+}
+
+static inline uint64_t hist_value(unsigned idx) {  // upper edge of the bucket
+	if (idx < HIST_SUB) return idx;
+	unsigned exp = idx / HIST_SUB + HIST_SUB_BITS - 1, sub = idx % HIST_SUB;
+	return ((uint64_t)(HIST_SUB + sub + 1) << (exp - HIST_SUB_BITS)) - 1;
+}
+
+static inline void hist_add(Hist* h, uint64_t v) {
+	h->count++; h->sum += v;
+	if (v > h->max) h->max = v;
+	h->b[hist_index(v)]++;
+}
+
+static void hist_merge(Hist* dst, const Hist* src) {
+	dst->count += src->count; dst->sum += src->sum;
+	if (src->max > dst->max) dst->max = src->max;
+	for (unsigned i = 0; i < HIST_BUCKETS; i++) dst->b[i] += src->b[i];
+}
+
+static uint64_t hist_pct(const Hist* h, double p) {
+	if (!h->count) return 0;
+	uint64_t want = (uint64_t)ceil(p / 100.0 * (double)h->count), seen = 0;
+	for (unsigned i = 0; i < HIST_BUCKETS; i++) {
+		seen += h->b[i];
+		if (seen >= want) { uint64_t v = hist_value(i); return v < h->max ? v : h->max; }
+	}
+	return h->max;
+}
+
+// ---- shared state ----
+typedef struct {
+	const Config* cfg;
+	Mix           mix;
+	CBLU_Db*      db;
+	_Atomic uint64_t next_insert;   // next key number to insert
+	_Atomic uint64_t acked;         // keys below this are readable
+	_Atomic uint64_t ops_issued;
+	_Atomic bool     stop;
+} Shared;
+
+typedef struct {
+	Shared*   sh;
+	pthread_t th;
+	uint64_t  rng;
+	Zipf      zipf;
+	Hist      hist[OP_COUNT];
+	uint64_t  misses, errors;
+	char*     value;   // field_len + 1 random bytes
+} Worker;
+
+static void key_of(char* dst, size_t n, uint64_t keynum) {
+	// Hashed keys spread inserts over the id space, as YCSB does by default
+	snprintf(dst, n, "user%020llu", (unsigned long long)fnv64(keynum));
+}
+
+static void fill_value(Worker* w) {
+	static const char cs[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+	unsigned len = w->sh->cfg->field_len;
+	for (unsigned i = 0; i < len; i++) w->value[i] = cs[rng_next(&w->rng) % (sizeof cs - 1)];
+	w->value[len] = 0;
+}
+
+static bool write_record(Worker* w, CBLU_Session* s, uint64_t keynum) {
+	const Config* c = w->sh->cfg;
+	char key[32], field[16];
+	key_of(key, sizeof key, keynum);
+	CBLU_DocW* d = cblu_docw_begin(s, key);
+	if (!d) return false;
+	for (unsigned f = 0; f < c->fields; f++) {
+		snprintf(field, sizeof field, "field%u", f);
+		bool num = c->shape == SHAPE_F64 || (c->shape == SHAPE_MIXED && (f & 1));
+		if (num) cblu_docw_set_f64(d, field, rng_unit(&w->rng) * 1000.0);
+		else { fill_value(w); cblu_docw_set_str(d, field, w->value); }
+	}
+	return cblu_docw_save(d);
+}
+
+static bool read_record(Worker* w, CBLU_Session* s, uint64_t keynum, bool* found) {
+	const Config* c = w->sh->cfg;
+	char key[32], field[16];
+	key_of(key, sizeof key, keynum);
+	CBLU_DocR* d = cblu_docr_get(s, key);
+	*found = d != NULL;
+	if (!d) return true;
+	// Touch every field, like a YCSB read of all fields
+	for (unsigned f = 0; f < c->fields; f++) {
+		snprintf(field, sizeof field, "field%u", f);
+		const char* p; size_t len; double v;
+		if (!cblu_docr_view_str(d, field, &p, &len)) cblu_docr_get_f64(d, field, &v);
+	}
+	cblu_docr_free(d);
+	return true;
+}
+
+static bool scan_records(Worker* w, CBLU_Session* s, uint64_t keynum, unsigned len) {
+	char key[32], q[160];
+	key_of(key, sizeof key, keynum);
+	snprintf(q, sizeof q, "SELECT META().id, * FROM _ WHERE META().id >= '%s' ORDER BY META().id LIMIT %u", key, len);
+	CBLU_Query* qr = cblu_query_begin(s, q);
+	if (!qr) return false;
+	char id[32];
+	while (cblu_query_next(qr)) cblu_query_get_str(qr, 0, id, sizeof id);
+	cblu_query_free(qr);
+	(void)w;
+	return true;
+}
+
+static uint64_t choose_key(Worker* w) {
+	uint64_t n = atomic_load_explicit(&w->sh->acked, memory_order_acquire);
+	if (n == 0) return 0;
+	switch (w->sh->cfg->dist) {
+		case DIST_UNIFORM: return rng_next(&w->rng) % n;
+		case DIST_LATEST:  return n - 1 - zipf_next(&w->zipf, n, &w->rng);
+		default:           return fnv64(zipf_next(&w->zipf, n, &w->rng)) % n;  // scrambled zipfian
+	}
+}
+
+static void ack_insert(Shared* sh, uint64_t keynum) {
+	// Advance the readable horizon; out-of-order inserts catch up on a later ack
+	uint64_t cur = atomic_load(&sh->acked);
+	while (keynum + 1 > cur && !atomic_compare_exchange_weak(&sh->acked, &cur, keynum + 1)) {}
+}
+
+static inline uint64_t now_ns(void) {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint64_t)t.tv_sec * 1000000000ull + (uint64_t)t.tv_nsec;
+}
+
+static void* worker_run(void* arg) {
+	Worker* w = (Worker*)arg;
+	Shared* sh = w->sh;
+	const Config* c = sh->cfg;
+	CBLU_Session* s = cblu_session_begin(sh->db);
+	if (!s) { w->errors++; return NULL; }
+	zipf_init(&w->zipf, c->records ? c->records : 1);
+
+	for (;;) {
+		if (atomic_load_explicit(&sh->stop, memory_order_relaxed)) break;
+		if (c->ops && atomic_fetch_add(&sh->ops_issued, 1) >= c->ops) break;
+
+		double r = rng_unit(&w->rng);
+		int op = r < sh->mix.read ? OP_READ
+			   : (r -= sh->mix.read) < sh->mix.update ? OP_UPDATE
+			   : (r -= sh->mix.update) < sh->mix.insert ? OP_INSERT
+			   : (r -= sh->mix.insert) < sh->mix.scan ? OP_SCAN : OP_RMW;
+		bool ok = true, found = true;
+		uint64_t t0 = now_ns();
+		switch (op) {
+			case OP_READ:   ok = read_record(w, s, choose_key(w), &found); break;
+			case OP_UPDATE: ok = write_record(w, s, choose_key(w)); break;
+			case OP_INSERT: {
+				uint64_t k = atomic_fetch_add(&sh->next_insert, 1);
+				ok = write_record(w, s, k);
+				if (ok) ack_insert(sh, k);
+				break;
+			}
+			case OP_SCAN:
+				ok = scan_records(w, s, choose_key(w), 1 + (unsigned)(rng_next(&w->rng) % c->max_scan));
+				break;
+			case OP_RMW: {
+				uint64_t k = choose_key(w);
+				ok = read_record(w, s, k, &found) && write_record(w, s, k);
+				break;
+			}
+		}
+		hist_add(&w->hist[op], now_ns() - t0);
+		if (!ok) w->errors++;
+		if (!found) w->misses++;
+	}
+	cblu_session_end(s);
+	return NULL;
+}
+
+static bool load(Shared* sh, Worker* w) {
+	const Config* c = sh->cfg;
+	for (uint64_t i = 0; i < c->records; ) {
+		CBLU_Session* s = cblu_session_begin_txn(sh->db, true);
+		if (!s) return false;
+		bool ok = true;
+		for (unsigned b = 0; b < LOAD_BATCH && i < c->records; b++, i++) ok = write_record(w, s, i) && ok;
+		cblu_session_end_txn(s, ok);
+		if (!ok) return false;
+	}
+	return true;
+}
+
+static Mix mix_for(char wl) {
+	switch (wl) {
+		case 'A': return (Mix){ .read = 0.50, .update = 0.50 };
+		case 'B': return (Mix){ .read = 0.95, .update = 0.05 };
+		case 'C': return (Mix){ .read = 1.00 };
+		case 'D': return (Mix){ .read = 0.95, .insert = 0.05 };
+		case 'E': return (Mix){ .scan = 0.95, .insert = 0.05 };
+		case 'F': return (Mix){ .read = 0.50, .rmw = 0.50 };
+		default:  return (Mix){ 0 };
+	}
+}
+
+static void usage(const char* argv0) {
+	fprintf(stderr,
+		"usage: %s [-w A-F] [-t threads] [-r records] [-o ops | -T seconds]\n"
+		"          [-k zipfian|uniform|latest] [-s str|f64|mixed] [-f fields] [-l field-bytes]\n"
+		"          [-R readers] [-S max-scan] [-d dir] [-n name] [-x]\n", argv0);
+}
+
+int main(int argc, char** argv) {
+	Config c = { .workload = 'A', .threads = 4, .fields = 10, .field_len = 100, .max_scan = 100,
+				 .records = 100000, .ops = 100000, .dist = -1, .shape = SHAPE_STR,
+				 .dir = "/tmp", .name = "cblu_ycsb" };
+	int opt;
+	while ((opt = getopt(argc, argv, "w:t:r:o:T:k:s:f:l:R:S:d:n:x")) != -1) {
+		switch (opt) {
+			case 'w': c.workload = (char)(optarg[0] & ~0x20); break;
+			case 't': c.threads = (unsigned)strtoul(optarg, NULL, 10); break;
+			case 'r': c.records = strtoull(optarg, NULL, 10); break;
+			case 'o': c.ops = strtoull(optarg, NULL, 10); break;
+			case 'T': c.seconds = strtod(optarg, NULL); c.ops = 0; break;
+			case 'k': c.dist = !strcmp(optarg, "uniform") ? DIST_UNIFORM : !strcmp(optarg, "latest") ? DIST_LATEST : DIST_ZIPF; break;
+			case 's': c.shape = !strcmp(optarg, "f64") ? SHAPE_F64 : !strcmp(optarg, "mixed") ? SHAPE_MIXED : SHAPE_STR; break;
+			case 'f': c.fields = (unsigned)strtoul(optarg, NULL, 10); break;
+			case 'l': c.field_len = (unsigned)strtoul(optarg, NULL, 10); break;
+			case 'R': c.readers = (unsigned)strtoul(optarg, NULL, 10); break;
+			case 'S': c.max_scan = (unsigned)strtoul(optarg, NULL, 10); break;
+			case 'd': c.dir = optarg; break;
+			case 'n': c.name = optarg; break;
+			case 'x': c.skip_load = true; break;
+			default: usage(argv[0]); return 2;
+		}
+	}
+	if (c.workload < 'A' || c.workload > 'F' || !c.threads || !c.max_scan || (!c.ops && c.seconds <= 0)) {
+		usage(argv[0]);
+		return 2;
+	}
+	if (c.dist < 0) c.dist = c.workload == 'D' ? DIST_LATEST : DIST_ZIPF;
+
+	Shared sh = { .cfg = &c, .mix = mix_for(c.workload) };
+	if (!cblu_open(c.name, c.dir, &sh.db)) return 1;
+	if (c.readers && !cblu_open_readers(sh.db, c.readers)) { cblu_close(sh.db); return 1; }
+
+	Worker* ws = (Worker*)calloc(c.threads, sizeof *ws);
+	if (!ws) return 1;
+	for (unsigned i = 0; i < c.threads; i++) {
+		ws[i].sh = &sh;
+		ws[i].rng = 0x5EED0000ull + i;
+		ws[i].value = (char*)malloc(c.field_len + 1);
+	}
+
+	double load_s = 0;
+	if (!c.skip_load) {
+		uint64_t t0 = now_ns();
+		if (!load(&sh, &ws[0])) { fprintf(stderr, "ycsb: load failed\n"); return 1; }
+		load_s = (double)(now_ns() - t0) / 1e9;
+	}
+	atomic_store(&sh.next_insert, c.records);
+	atomic_store(&sh.acked, c.records);
+
+	uint64_t t0 = now_ns();
+	for (unsigned i = 0; i < c.threads; i++) pthread_create(&ws[i].th, NULL, worker_run, &ws[i]);
+	if (c.seconds > 0) {
+		struct timespec ts = { (time_t)c.seconds, (long)((c.seconds - (double)(time_t)c.seconds) * 1e9) };
+		nanosleep(&ts, NULL);
+		atomic_store(&sh.stop, true);
+	}
+	for (unsigned i = 0; i < c.threads; i++) pthread_join(ws[i].th, NULL);
+	double run_s = (double)(now_ns() - t0) / 1e9;
+
+	Hist* total = (Hist*)calloc(OP_COUNT, sizeof *total);
+	uint64_t ops = 0, misses = 0, errors = 0;
+	for (unsigned i = 0; i < c.threads; i++) {
+		for (int op = 0; op < OP_COUNT; op++) hist_merge(&total[op], &ws[i].hist[op]);
+		misses += ws[i].misses;
+		errors += ws[i].errors;
+	}
+	for (int op = 0; op < OP_COUNT; op++) ops += total[op].count;
+
+	static const char* const kDist[] = { "zipfian", "uniform", "latest" };
+	static const char* const kShape[] = { "str", "f64", "mixed" };
+	printf("{\n  \"workload\": \"%c\", \"threads\": %u, \"records\": %llu, \"distribution\": \"%s\",\n",
+		   c.workload, c.threads, (unsigned long long)c.records, kDist[c.dist]);
+	printf("  \"shape\": \"%s\", \"fields\": %u, \"field_bytes\": %u, \"readers\": %u,\n",
+		   kShape[c.shape], c.fields, c.field_len, c.readers);
+	printf("  \"load_seconds\": %.3f, \"run_seconds\": %.3f, \"ops\": %llu, \"ops_per_sec\": %.1f,\n",
+		   load_s, run_s, (unsigned long long)ops, run_s > 0 ? (double)ops / run_s : 0.0);
+	printf("  \"misses\": %llu, \"errors\": %llu,\n  \"latency_us\": {",
+		   (unsigned long long)misses, (unsigned long long)errors);
+	bool first = true;
+	for (int op = 0; op < OP_COUNT; op++) {
+		const Hist* h = &total[op];
+		if (!h->count) continue;
+		printf("%s\n    \"%s\": {\"count\": %llu, \"mean\": %.2f, \"p50\": %.2f, \"p95\": %.2f, "
+			   "\"p99\": %.2f, \"p999\": %.2f, \"max\": %.2f}",
+			   first ? "" : ",", kOpNames[op], (unsigned long long)h->count, (double)h->sum / (double)h->count / 1e3,
+			   hist_pct(h, 50) / 1e3, hist_pct(h, 95) / 1e3, hist_pct(h, 99) / 1e3, hist_pct(h, 99.9) / 1e3,
+			   h->max / 1e3);
+		first = false;
+	}
+	printf("\n  }\n}\n");
+
+	for (unsigned i = 0; i < c.threads; i++) free(ws[i].value);
+	free(ws);
+	free(total);
+	cblu_close(sh.db);
+	return errors ? 1 : 0;
+}
@@ -4,89 +4,145 @@
 //  Utility wrapper over Couchbase Lite C (Fleece) for simple DB/session/doc IO
 //
 
-#include "cblutil.h"
-#include <stdio.h>
+#include "CBLiteC_internal.h"
 #include <string.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
 
-// If your installation uses framework-style includes, swap these for <cbl/...>
-#include "CBLDatabase.h"
-#include "CBLCollection.h"
-#include "CBLDocument.h"
-#include "Fleece.h"
-#include "CBLBlob.h"
+static _Atomic uint64_t g_db_epoch;
 
-// --- Fleece portability shims (older/newer headers may use 'Unsigned' vs 'UInt') ---
-#if !defined(FLMutableDict_SetUInt) && defined(FLMutableDict_SetUnsigned)
-#define FLMutableDict_SetUInt FLMutableDict_SetUnsigned
-#endif
-
-#if !defined(FLMutableArray_AppendUInt) && defined(FLMutableArray_AppendUnsigned)
-#define FLMutableArray_AppendUInt FLMutableArray_AppendUnsigned
-#endif
-
-// --- Small helpers ---
-static inline bool fl_is_number(FLValue v) {
-	return v && FLValue_GetType(v) == kFLNumber;
-}
-
-static inline bool fl_is_string(FLValue v) {
-	return v && FLValue_GetType(v) == kFLString;
-}
-
-// --- Opaque/inner structs ---
-typedef struct {
-	CBLDatabase*   db;
-	CBLCollection* coll;
-} CBLU_Core;
-
-struct CBLU_Db      { CBLU_Core core; };
-struct CBLU_Session { CBLU_Core core; bool txn_active; };
-struct CBLU_DocW    { const CBLU_Core* core; CBLDocument* doc; FLMutableDict props; };
-struct CBLU_DocR    { const CBLU_Core* core; const CBLDocument* doc; FLDict props; };
-
-static inline FLString fl_from_c(const char* s) {
-	return (FLString){ .buf = s, .size = s ? strlen(s) : 0 };
+static void core_release(CBLU_Core* c) {
+	if (c->coll) { CBLCollection_Release(c->coll); c->coll = NULL; }
+	if (c->db)   { CBLDatabase_Close(c->db, NULL); CBLDatabase_Release(c->db); c->db = NULL; }
 }
 
-CBLU_Session* cblu_session_begin_txn(CBLU_Db* db, bool use_txn);
-
 // ---- Database ----
 bool cblu_open(const char* db_name, const char* dir, CBLU_Db** out_db) {
+	return cblu_open_ex(db_name, dir, NULL, out_db);
+}
+
+bool cblu_open_ex(const char* db_name, const char* dir, const CBLU_OpenOptions* opt, CBLU_Db** out_db) {
 	if (!out_db || !db_name) return false;
 	*out_db = NULL;
 
 	CBLError err = {0};
 	CBLDatabaseConfiguration cfg = {0};
 	cfg.directory = fl_from_c(dir);
+	cfg.fullSync  = opt && opt->full_sync;  // CBL 3.1+
 
+	uint64_t t0 = cblu__now_ns();
 	CBLDatabase* db = CBLDatabase_Open(fl_from_c(db_name), &cfg, &err);
+	cblu__stats_record(CBLU_OP_OPEN, t0, db != NULL);
 	if (!db) {
-		fprintf(stderr, "CBL open failed: domain=%d code=%d\n", (int)err.domain, (int)err.code);
+		cblu__cbl_error("open", err);
 		return false;
 	}
 
 	CBLCollection* coll = CBLDatabase_DefaultCollection(db, &err);
 	if (!coll) {
-		fprintf(stderr, "CBL default collection failed: domain=%d code=%d\n", (int)err.domain, (int)err.code);
+		cblu__cbl_error("default collection", err);
 		CBLDatabase_Close(db, NULL);
 		CBLDatabase_Release(db);
 		return false;
 	}
 
-	CBLU_Db* h = (CBLU_Db*)calloc(1, sizeof *h);
+	CBLU_Db* h = (CBLU_Db*)cblu__calloc(CBLU_MEM_DB, 1, sizeof *h);
+	pthread_mutexattr_t ma;
+	bool mu_ok = false;
+	if (h && pthread_mutexattr_init(&ma) == 0) {
+		mu_ok = pthread_mutexattr_settype(&ma, PTHREAD_MUTEX_RECURSIVE) == 0 &&
+				pthread_mutex_init(&h->write_mu, &ma) == 0;
+		pthread_mutexattr_destroy(&ma);
+	}
+	if (!mu_ok) {
+		if (h) cblu__wrapper_error("open", CBLU_ERR_THREAD);
+		cblu__free(h);
+		CBLCollection_Release(coll);
+		CBLDatabase_Close(db, NULL);
+		CBLDatabase_Release(db);
+		return false;
+	}
 	h->core.db   = db;
 	h->core.coll = coll;
+	h->core.wmu  = &h->write_mu;
+	h->epoch     = atomic_fetch_add_explicit(&g_db_epoch, 1, memory_order_relaxed) + 1;
 	*out_db = h;
 	return true;
 }
 
 void cblu_close(CBLU_Db* db) {
 	if (!db) return;
-	if (db->core.coll) { CBLCollection_Release(db->core.coll); db->core.coll = NULL; }
-	if (db->core.db)   { CBLDatabase_Close(db->core.db, NULL); CBLDatabase_Release(db->core.db); db->core.db = NULL; }
-	free(db);
+	for (unsigned i = 0; i < db->nreaders; i++) core_release(&db->readers[i]);
+	cblu__free(db->readers);
+	if (db->core.wmu == &db->write_mu) {
+		core_release(&db->core);
+		pthread_mutex_destroy(&db->write_mu);
+	} else if (db->core.coll) {
+		// Collection handle: the CBLDatabase and writer lock belong to its base
+		CBLCollection_Release(db->core.coll);
+	}
+	cblu__free(db);
+}
+
+// ---- Reader pool ----
+// Opens another handle on the same file and looks up the same collection in it
+static bool open_reader(const CBLU_Core* primary, CBLU_Core* out) {
+	CBLError err = {0};
+	FLString name = CBLDatabase_Name(primary->db);
+	FLStringResult path = CBLDatabase_Path(primary->db);  // "<dir>/<name>.cblite2/"
+	size_t n = path.size;
+	const char* p = (const char*)path.buf;
+	while (n > 0 && p[n-1] == '/') n--;                   // trailing slash
+	while (n > 0 && p[n-1] != '/') n--;                   // "<name>.cblite2"
+	CBLDatabaseConfiguration cfg = {0};
+	cfg.directory = (FLString){ .buf = p, .size = n };
+
+	CBLDatabase* db = CBLDatabase_Open(name, &cfg, &err);
+	FLSliceResult_Release(path);
+	if (!db) {
+		cblu__cbl_error("reader open", err);
+		return false;
+	}
+	CBLScope* scope = CBLCollection_Scope(primary->coll);
+	CBLCollection* coll = CBLDatabase_Collection(db, CBLCollection_Name(primary->coll), CBLScope_Name(scope), &err);
+	CBLScope_Release(scope);
+	if (!coll) {
+		cblu__cbl_error("reader collection", err);
+		CBLDatabase_Close(db, NULL);
+		CBLDatabase_Release(db);
+		return false;
+	}
+	out->db   = db;
+	out->coll = coll;
+	return true;
+}
+
+bool cblu_open_readers(CBLU_Db* db, unsigned n) {
+	if (!db || db->readers || n == 0) return false;
+	CBLU_Core* r = (CBLU_Core*)cblu__calloc(CBLU_MEM_DB, n, sizeof *r);
+	if (!r) return false;
+	for (unsigned i = 0; i < n; i++) {
+		if (!open_reader(&db->core, &r[i])) {
+			while (i > 0) core_release(&r[--i]);
+			cblu__free(r);
+			return false;
+		}
+	}
+	db->readers  = r;
+	db->nreaders = n;
+	return true;
+}
+
+// Each thread keeps the same reader for all its sessions (cache/lock affinity)
+static _Atomic unsigned g_reader_next = 0;
+static _Thread_local unsigned tl_reader = UINT32_MAX;
+
+static CBLU_Core pick_reader(const CBLU_Db* db) {
+	if (db->nreaders == 0) return db->core;
+	if (tl_reader == UINT32_MAX) tl_reader = atomic_fetch_add_explicit(&g_reader_next, 1, memory_order_relaxed);
+	return db->readers[tl_reader % db->nreaders];
 }
 
 // ---- Session ----
@@ -96,43 +152,130 @@ CBLU_Session* cblu_session_begin(CBLU_Db* db) {
 
 CBLU_Session* cblu_session_begin_txn(CBLU_Db* db, bool use_txn) {
 	if (!db) return NULL;
-	CBLU_Session* s = (CBLU_Session*)calloc(1, sizeof *s);
+	CBLU_Session* s = (CBLU_Session*)cblu__calloc(CBLU_MEM_SESSION, 1, sizeof *s);
+	if (!s) return NULL;
 	s->core = db->core;
+	s->rcore = use_txn ? db->core : pick_reader(db);  // a transaction must read its own writes
 	s->txn_active = false;
 	if (use_txn) {
 		CBLError err = {0};
-		if (!CBLDatabase_BeginTransaction(s->core.db, &err)) {
-			fprintf(stderr, "CBL begin txn failed: domain=%d code=%d\n", (int)err.domain, (int)err.code);
-			free(s); return NULL;
+		if (!cblu__begin_txn(&s->core, &err)) {
+			cblu__cbl_error("begin txn", err);
+			cblu__free(s); return NULL;
 		}
 		s->txn_active = true;
 	}
+	CBLU_REC(CBLU_REC_SESSION_BEGIN, s, use_txn, NULL, 0);
 	return s;
 }
 
 void cblu_session_end_txn(CBLU_Session* s, bool commit) {
-	if (!s) return;
+	if (!s || s->thread_owned) return;  // freed at thread exit
+	CBLU_REC(CBLU_REC_SESSION_END, s, commit, NULL, 0);
 	if (s->txn_active) {
 		CBLError err = {0};
-		if (!CBLDatabase_EndTransaction(s->core.db, commit, &err)) {
-			fprintf(stderr, "CBL end txn failed: domain=%d code=%d\n", (int)err.domain, (int)err.code);
+		if (!cblu__end_txn(&s->core, commit, &err)) {
+			cblu__cbl_error("end txn", err);
 		}
 		s->txn_active = false;
 	}
-	free(s);
+	cblu__free(s);
 }
 
 void cblu_session_end(CBLU_Session* s) {
 	cblu_session_end_txn(s, true);
 }
 
+// ---- Per-thread sessions ----
+// Each thread keeps a small table of (db, epoch) → session. An entry whose db
+// was closed stays until the same address is reopened (epoch differs: replaced)
+// or the thread exits (destructor frees the table).
+typedef struct { const CBLU_Db* db; uint64_t epoch; CBLU_Session* s; } ThreadSess;
+typedef struct { ThreadSess* e; unsigned n, cap; } ThreadSessTable;
+
+static pthread_key_t  g_tsess_key;
+static pthread_once_t g_tsess_once = PTHREAD_ONCE_INIT;
+static bool           g_tsess_key_ok;
+static _Thread_local ThreadSessTable* tl_tsess;
+
+static void tsess_destroy(void* p) {
+	ThreadSessTable* t = (ThreadSessTable*)p;
+	for (unsigned i = 0; i < t->n; i++) cblu__free(t->e[i].s);
+	cblu__free(t->e);
+	cblu__free(t);
+	tl_tsess = NULL;
+}
+
+static void tsess_key_init(void) {
+	g_tsess_key_ok = pthread_key_create(&g_tsess_key, tsess_destroy) == 0;
+}
+
+static ThreadSessTable* tsess_table(void) {
+	if (tl_tsess) return tl_tsess;
+	pthread_once(&g_tsess_once, tsess_key_init);
+	if (!g_tsess_key_ok) { cblu__wrapper_error("session thread", CBLU_ERR_THREAD); return NULL; }
+	ThreadSessTable* t = (ThreadSessTable*)cblu__calloc(CBLU_MEM_SESSION, 1, sizeof *t);
+	if (!t) return NULL;
+	if (pthread_setspecific(g_tsess_key, t) != 0) {
+		cblu__wrapper_error("session thread", CBLU_ERR_THREAD);
+		cblu__free(t);
+		return NULL;
+	}
+	tl_tsess = t;
+	return t;
+}
+
+CBLU_Session* cblu_session_thread(CBLU_Db* db) {
+	if (!db) return NULL;
+	ThreadSessTable* t = tsess_table();
+	if (!t) return NULL;
+	ThreadSess* slot = NULL;
+	for (unsigned i = 0; i < t->n; i++) {
+		if (t->e[i].db != db) continue;
+		if (t->e[i].epoch == db->epoch) return t->e[i].s;
+		slot = &t->e[i];  // closed db, address reused
+		break;
+	}
+	CBLU_Session* s = cblu_session_begin_txn(db, false);
+	if (!s) return NULL;
+	s->thread_owned = true;
+	if (!slot) {
+		if (t->n == t->cap) {
+			unsigned cap = t->cap ? t->cap * 2 : 4;
+			ThreadSess* e = (ThreadSess*)cblu__realloc(CBLU_MEM_SESSION, t->e, cap * sizeof *e);
+			if (!e) { cblu__free(s); return NULL; }
+			t->e = e;
+			t->cap = cap;
+		}
+		slot = &t->e[t->n++];
+	} else {
+		cblu__free(slot->s);
+	}
+	*slot = (ThreadSess){ .db = db, .epoch = db->epoch, .s = s };
+	return s;
+}
+
+void cblu_session_thread_release(CBLU_Db* db) {
+	ThreadSessTable* t = tl_tsess;
+	if (!db || !t) return;
+	for (unsigned i = 0; i < t->n; i++) {
+		if (t->e[i].db != db) continue;
+		cblu__free(t->e[i].s);
+		t->e[i] = t->e[--t->n];
+		return;
+	}
+}
+
 // ---- Write doc ----
 CBLU_DocW* cblu_docw_begin(CBLU_Session* s, const char* doc_id) {
 	if (!s || !doc_id) return NULL;
-	CBLU_DocW* d = (CBLU_DocW*)calloc(1, sizeof *d);
-	d->core  = &s->core;
+	CBLU_DocW* d = (CBLU_DocW*)cblu__calloc(CBLU_MEM_DOC, 1, sizeof *d);
+	if (!d) return NULL;
+	d->core  = s->core;
+	d->sess  = s;
 	d->doc   = CBLDocument_CreateWithID(fl_from_c(doc_id));
 	d->props = CBLDocument_MutableProperties(d->doc);
+	if (CBLU_REC_ON(d)) cblu__rec(CBLU_REC_DOCW_BEGIN, d, (uintptr_t)s, doc_id, 0);
 	return d;
 }
 
@@ -141,13 +284,16 @@ static inline void set_key_u64(FLMutableDict props, const char* k, uint64_t v)
 static inline void set_key_f64(FLMutableDict props, const char* k, double v)    { FLMutableDict_SetDouble(props, fl_from_c(k), v); }
 static inline void set_key_str(FLMutableDict props, const char* k, const char* s){ FLMutableDict_SetString(props, fl_from_c(k), fl_from_c(s ? s : "")); }
 
-void cblu_docw_set_i64 (CBLU_DocW* d, const char* key, int64_t v)   { if (d && key) set_key_i64 (d->props, key, v); }
-void cblu_docw_set_u64 (CBLU_DocW* d, const char* key, uint64_t v)  { if (d && key) set_key_u64 (d->props, key, v); }
-void cblu_docw_set_f64 (CBLU_DocW* d, const char* key, double v)    { if (d && key) set_key_f64 (d->props, key, v); }
-void cblu_docw_set_str (CBLU_DocW* d, const char* key, const char* s){ if (d && key) set_key_str (d->props, key, s); }
+#define REC_SET(d, kind, key, size)  CBLU_REC_H(CBLU_REC_DOCW_SET, (d), (kind), (key), (size))
+
+void cblu_docw_set_i64 (CBLU_DocW* d, const char* key, int64_t v)   { if (d && key) { REC_SET(d, CBLU_REC_I64, key, 0); set_key_i64 (d->props, key, v); } }
+void cblu_docw_set_u64 (CBLU_DocW* d, const char* key, uint64_t v)  { if (d && key) { REC_SET(d, CBLU_REC_U64, key, 0); set_key_u64 (d->props, key, v); } }
+void cblu_docw_set_f64 (CBLU_DocW* d, const char* key, double v)    { if (d && key) { REC_SET(d, CBLU_REC_F64, key, 0); set_key_f64 (d->props, key, v); } }
+void cblu_docw_set_str (CBLU_DocW* d, const char* key, const char* s){ if (d && key) { REC_SET(d, CBLU_REC_STR, key, s ? strlen(s) : 0); set_key_str (d->props, key, s); } }
 
 void cblu_docw_set_f64_array(CBLU_DocW* d, const char* key, const double* a, size_t n) {
 	if (!d || !key) return;
+	REC_SET(d, CBLU_REC_F64_ARRAY, key, n);
 	FLMutableArray arr = FLMutableArray_New();
 	for (size_t i=0; i<n; i++) FLMutableArray_AppendDouble(arr, a ? a[i] : 0.0);
 	FLMutableDict_SetArray(d->props, fl_from_c(key), arr);
@@ -156,6 +302,7 @@ void cblu_docw_set_f64_array(CBLU_DocW* d, const char* key, const double* a, siz
 
 void cblu_docw_set_i64_array(CBLU_DocW* d, const char* key, const int64_t* a, size_t n) {
 	if (!d || !key) return;
+	REC_SET(d, CBLU_REC_I64_ARRAY, key, n);
 	FLMutableArray arr = FLMutableArray_New();
 	for (size_t i=0; i<n; i++) FLMutableArray_AppendInt(arr, a ? a[i] : 0);
 	FLMutableDict_SetArray(d->props, fl_from_c(key), arr);
@@ -164,6 +311,7 @@ void cblu_docw_set_i64_array(CBLU_DocW* d, const char* key, const int64_t* a, si
 
 void cblu_docw_set_bool(CBLU_DocW* d, const char* key, bool v) {
 	if (!d || !key) return;
+	REC_SET(d, CBLU_REC_BOOL, key, 0);
 	FLMutableDict_SetBool(d->props, fl_from_c(key), v);
 }
 
@@ -175,6 +323,7 @@ bool cblu_docw_set_blob(CBLU_DocW* d, const char* key, const void* data, size_t
 		fl_from_c(contentType ? contentType : "application/octet-stream"),
 		slice);
 	if (!blob) return false;
+	REC_SET(d, CBLU_REC_BLOB, key, size);
 	FLMutableDict_SetBlob(d->props, fl_from_c(key), blob);
 	CBLBlob_Release(blob);
 	return true;
@@ -217,68 +366,82 @@ void cblu_docw_end_array(CBLU_DocW* d, FLMutableArray arr) {
 bool cblu_docw_save(CBLU_DocW* d) {
 	if (!d) return false;
 	CBLError err = {0};
-	bool ok = CBLCollection_SaveDocument(d->core->coll, d->doc, &err);
-	if (!ok) fprintf(stderr, "CBL save failed: domain=%d code=%d\n", (int)err.domain, (int)err.code);
+	CBLU_TRACE1(save_entry, CBLDocument_ID(d->doc).size);
+	uint64_t t0 = cblu__now_ns();
+	bool ok = cblu__save_doc(&d->core, d->doc, &err);
+	cblu__stats_record(CBLU_OP_SAVE, t0, ok);
+	CBLU_TRACE4(save_return, CBLDocument_ID(d->doc).size, (int)ok, (int)err.domain, (int)err.code);
+	CBLU_REC_H(CBLU_REC_DOCW_SAVE, d, 0, NULL, ok);
+	if (!ok) cblu__error_in(d->sess ? &d->sess->last_err : NULL, "save", (int)err.domain, (int)err.code, CBLDocument_ID(d->doc));
 	CBLDocument_Release(d->doc); // doc retained by collection if saved
 	d->doc = NULL;
 	d->props = NULL;
-	free(d);
+	cblu__free(d);
 	return ok;
 }
 
 void cblu_docw_free(CBLU_DocW* d) {
 	if (!d) return;
+	CBLU_REC_H(CBLU_REC_DOCW_FREE, d, 0, NULL, 0);
 	if (d->doc) { CBLDocument_Release(d->doc); d->doc = NULL; }
 	d->props = NULL;
-	free(d);
+	cblu__free(d);
 }
 
 // ---- Read doc ----
 CBLU_DocR* cblu_docr_get(CBLU_Session* s, const char* doc_id) {
 	if (!s || !doc_id) return NULL;
 	CBLError err = {0};
-	const CBLDocument* doc = CBLCollection_GetDocument(s->core.coll, fl_from_c(doc_id), &err);
-	if (!doc) return NULL;
-	CBLU_DocR* d = (CBLU_DocR*)calloc(1, sizeof *d);
-	d->core  = &s->core;
+	CBLU_TRACE1(get_entry, strlen(doc_id));
+	uint64_t t0 = cblu__now_ns();
+	const CBLDocument* doc = CBLCollection_GetDocument(s->rcore.coll, fl_from_c(doc_id), &err);
+	cblu__stats_record(CBLU_OP_GET, t0, doc || err.code == 0);
+	CBLU_TRACE4(get_return, strlen(doc_id), (int)(doc != NULL), (int)err.domain, (int)err.code);
+	if (!doc) {
+		if (err.code) cblu__error_in(&s->last_err, "get", (int)err.domain, (int)err.code, fl_from_c(doc_id));
+		CBLU_REC(CBLU_REC_DOCR_GET, NULL, (uintptr_t)s, doc_id, 0);
+		return NULL;
+	}
+	CBLU_DocR* d = (CBLU_DocR*)cblu__calloc(CBLU_MEM_DOC, 1, sizeof *d);
+	if (!d) { CBLDocument_Release(doc); return NULL; }
+	d->core  = s->rcore;
 	d->doc   = doc;
 	d->props = CBLDocument_Properties(doc);
+	if (CBLU_REC_ON(d)) cblu__rec(CBLU_REC_DOCR_GET, d, (uintptr_t)s, doc_id, 0);
 	return d;
 }
 
+static inline FLValue key_get(CBLU_DocR* d, const char* key) {
+	CBLU_REC_H(CBLU_REC_DOCR_READ, d, 0, key, 0);
+	return FLDict_Get(d->props, fl_from_c(key));
+}
+
 bool cblu_docr_has(CBLU_DocR* d, const char* key) {
 	if (!d || !key) return false;
-	FLValue v = FLDict_Get(d->props, fl_from_c(key));
+	FLValue v = key_get(d, key);
 	return v != NULL;
 }
 
-bool cblu_docr_get_i64(CBLU_DocR* d, const char* key, int64_t* out) {
-	if (!d || !key || !out) return false;
-	FLValue v = FLDict_Get(d->props, fl_from_c(key));
+// Typed conversions shared by the key and key-path getters
+static bool val_i64(FLValue v, int64_t* out) {
 	if (!fl_is_number(v)) return false;
 	*out = (int64_t)FLValue_AsInt(v);
 	return true;
 }
 
-bool cblu_docr_get_u64(CBLU_DocR* d, const char* key, uint64_t* out) {
-	if (!d || !key || !out) return false;
-	FLValue v = FLDict_Get(d->props, fl_from_c(key));
+static bool val_u64(FLValue v, uint64_t* out) {
 	if (!fl_is_number(v)) return false;
 	*out = (uint64_t)FLValue_AsUnsigned(v); // correct unsigned accessor
 	return true;
 }
 
-bool cblu_docr_get_f64(CBLU_DocR* d, const char* key, double* out) {
-	if (!d || !key || !out) return false;
-	FLValue v = FLDict_Get(d->props, fl_from_c(key));
+static bool val_f64(FLValue v, double* out) {
 	if (!fl_is_number(v)) return false;
 	*out = FLValue_AsDouble(v);
 	return true;
 }
 
-bool cblu_docr_get_bool(CBLU_DocR* d, const char* key, bool* out) {
-	if (!d || !key || !out) return false;
-	FLValue v = FLDict_Get(d->props, fl_from_c(key));
+static bool val_bool(FLValue v, bool* out) {
 	if (!v) return false;
 	if (FLValue_GetType(v) == kFLBoolean || FLValue_GetType(v) == kFLNumber) {
 		*out = FLValue_AsBool(v);
@@ -287,9 +450,7 @@ bool cblu_docr_get_bool(CBLU_DocR* d, const char* key, bool* out) {
 	return false;
 }
 
-size_t cblu_docr_get_str(CBLU_DocR* d, const char* key, char* dst, size_t dst_size) {
-	if (!d || !key || !dst || dst_size == 0) return 0;
-	FLValue v = FLDict_Get(d->props, fl_from_c(key));
+static size_t val_str(FLValue v, char* dst, size_t dst_size) {
 	if (!fl_is_string(v)) { dst[0] = 0; return 0; }
 	FLString s = FLValue_AsString(v);
 	size_t n = (s.buf && s.size < (dst_size - 1)) ? s.size : (dst_size - 1);
@@ -297,9 +458,7 @@ size_t cblu_docr_get_str(CBLU_DocR* d, const char* key, char* dst, size_t dst_si
 	return n;
 }
 
-size_t cblu_docr_get_f64_array(CBLU_DocR* d, const char* key, double* out, size_t maxn) {
-	if (!d || !key || !out || !maxn) return 0;
-	FLValue v = FLDict_Get(d->props, fl_from_c(key));
+static size_t val_f64_array(FLValue v, double* out, size_t maxn) {
 	if (FLValue_GetType(v) != kFLArray) return 0;
 	FLArray a = FLValue_AsArray(v);
 	size_t n = FLArray_Count(a);
@@ -311,9 +470,7 @@ size_t cblu_docr_get_f64_array(CBLU_DocR* d, const char* key, double* out, size_
 	return n;
 }
 
-size_t cblu_docr_get_i64_array(CBLU_DocR* d, const char* key, int64_t* out, size_t maxn) {
-	if (!d || !key || !out || !maxn) return 0;
-	FLValue v = FLDict_Get(d->props, fl_from_c(key));
+static size_t val_i64_array(FLValue v, int64_t* out, size_t maxn) {
 	if (FLValue_GetType(v) != kFLArray) return 0;
 	FLArray a = FLValue_AsArray(v);
 	size_t n = FLArray_Count(a);
@@ -325,44 +482,175 @@ size_t cblu_docr_get_i64_array(CBLU_DocR* d, const char* key, int64_t* out, size
 	return n;
 }
 
-size_t cblu_docr_get_blob(CBLU_DocR* d, const char* key, void* dst, size_t dstSize,
-						  char* contentTypeDst, size_t ctDstSize) {
-	if (!d || !key || !dst || dstSize==0) return 0;
-	const CBLBlob* blob = NULL;
-	{
-		FLValue v = FLDict_Get(d->props, fl_from_c(key));
-		if (v) {
-		#if defined(FLValue_AsBlob)
-			blob = FLValue_AsBlob(v);
-		#elif defined(FLValue_GetBlob)
-			blob = FLValue_GetBlob(v);
-		#else
-			blob = NULL;
-		#endif
-		}
+// Views point into the document's Fleece data: no copy, not NUL-terminated
+static bool val_view_str(FLValue v, const char** out, size_t* out_len) {
+	if (!fl_is_string(v)) return false;
+	FLString s = FLValue_AsString(v);
+	*out = (const char*)s.buf;
+	*out_len = s.size;
+	return true;
+}
+
+static bool val_view_data(FLValue v, const void** out, size_t* out_len) {
+	FLValueType t = FLValue_GetType(v);
+	if (t != kFLData && t != kFLString) return false;
+	FLSlice s = (t == kFLData) ? FLValue_AsData(v) : FLValue_AsString(v);
+	*out = s.buf;
+	*out_len = s.size;
+	return true;
+}
+
+bool cblu_docr_get_i64(CBLU_DocR* d, const char* key, int64_t* out) {
+	if (!d || !key || !out) return false;
+	return val_i64(key_get(d, key), out);
+}
+
+bool cblu_docr_get_u64(CBLU_DocR* d, const char* key, uint64_t* out) {
+	if (!d || !key || !out) return false;
+	return val_u64(key_get(d, key), out);
+}
+
+bool cblu_docr_get_f64(CBLU_DocR* d, const char* key, double* out) {
+	if (!d || !key || !out) return false;
+	return val_f64(key_get(d, key), out);
+}
+
+bool cblu_docr_get_bool(CBLU_DocR* d, const char* key, bool* out) {
+	if (!d || !key || !out) return false;
+	return val_bool(key_get(d, key), out);
+}
+
+size_t cblu_docr_get_str(CBLU_DocR* d, const char* key, char* dst, size_t dst_size) {
+	if (!d || !key || !dst || dst_size == 0) return 0;
+	return val_str(key_get(d, key), dst, dst_size);
+}
+
+size_t cblu_docr_get_f64_array(CBLU_DocR* d, const char* key, double* out, size_t maxn) {
+	if (!d || !key || !out || !maxn) return 0;
+	return val_f64_array(key_get(d, key), out, maxn);
+}
+
+size_t cblu_docr_get_i64_array(CBLU_DocR* d, const char* key, int64_t* out, size_t maxn) {
+	if (!d || !key || !out || !maxn) return 0;
+	return val_i64_array(key_get(d, key), out, maxn);
+}
+
+bool cblu_docr_view_str(CBLU_DocR* d, const char* key, const char** out, size_t* out_len) {
+	if (!d || !key || !out || !out_len) return false;
+	return val_view_str(key_get(d, key), out, out_len);
+}
+
+bool cblu_docr_view_data(CBLU_DocR* d, const char* key, const void** out, size_t* out_len) {
+	if (!d || !key || !out || !out_len) return false;
+	return val_view_data(key_get(d, key), out, out_len);
+}
+
+// ---- Key paths ----
+struct CBLU_Path { FLKeyPath kp; };
+
+CBLU_Path* cblu_path_compile(const char* path) {
+	if (!path || !*path) return NULL;
+	FLError ferr = kFLNoError;
+	FLKeyPath kp = FLKeyPath_New(fl_from_c(path), &ferr);
+	if (!kp) {
+		cblu__error("key path compile", CBLU_ERR_DOMAIN_FLEECE, (int)ferr, kFLSliceNull);
+		return NULL;
 	}
-	if (!blob) return 0;
+	CBLU_Path* p = (CBLU_Path*)cblu__calloc(CBLU_MEM_PATH, 1, sizeof *p);
+	if (!p) { FLKeyPath_Free(kp); return NULL; }
+	p->kp = kp;
+	return p;
+}
 
-	if (contentTypeDst && ctDstSize>0) {
-		FLString ct = CBLBlob_ContentType(blob);
-		size_t n = (ct.buf && ct.size < (ctDstSize-1)) ? ct.size : (ctDstSize-1);
-		if (ct.buf) { memcpy(contentTypeDst, ct.buf, n); contentTypeDst[n]=0; } else { contentTypeDst[0]=0; }
+void cblu_path_free(CBLU_Path* p) {
+	if (!p) return;
+	FLKeyPath_Free(p->kp);
+	cblu__free(p);
+}
+
+static inline FLValue path_eval(CBLU_DocR* d, const CBLU_Path* p) {
+	return FLKeyPath_Eval(p->kp, (FLValue)d->props);
+}
+
+bool cblu_docr_path_has(CBLU_DocR* d, const CBLU_Path* p) {
+	if (!d || !p) return false;
+	return path_eval(d, p) != NULL;
+}
+
+bool cblu_docr_path_i64(CBLU_DocR* d, const CBLU_Path* p, int64_t* out) {
+	if (!d || !p || !out) return false;
+	return val_i64(path_eval(d, p), out);
+}
+
+bool cblu_docr_path_u64(CBLU_DocR* d, const CBLU_Path* p, uint64_t* out) {
+	if (!d || !p || !out) return false;
+	return val_u64(path_eval(d, p), out);
+}
+
+bool cblu_docr_path_f64(CBLU_DocR* d, const CBLU_Path* p, double* out) {
+	if (!d || !p || !out) return false;
+	return val_f64(path_eval(d, p), out);
+}
+
+bool cblu_docr_path_bool(CBLU_DocR* d, const CBLU_Path* p, bool* out) {
+	if (!d || !p || !out) return false;
+	return val_bool(path_eval(d, p), out);
+}
+
+size_t cblu_docr_path_str(CBLU_DocR* d, const CBLU_Path* p, char* dst, size_t dst_size) {
+	if (!d || !p || !dst || dst_size == 0) return 0;
+	return val_str(path_eval(d, p), dst, dst_size);
+}
+
+size_t cblu_docr_path_f64_array(CBLU_DocR* d, const CBLU_Path* p, double* out, size_t maxn) {
+	if (!d || !p || !out || !maxn) return 0;
+	return val_f64_array(path_eval(d, p), out, maxn);
+}
+
+size_t cblu_docr_path_i64_array(CBLU_DocR* d, const CBLU_Path* p, int64_t* out, size_t maxn) {
+	if (!d || !p || !out || !maxn) return 0;
+	return val_i64_array(path_eval(d, p), out, maxn);
+}
+
+bool cblu_docr_path_view_str(CBLU_DocR* d, const CBLU_Path* p, const char** out, size_t* out_len) {
+	if (!d || !p || !out || !out_len) return false;
+	return val_view_str(path_eval(d, p), out, out_len);
+}
+
+bool cblu_docr_path_view_data(CBLU_DocR* d, const CBLU_Path* p, const void** out, size_t* out_len) {
+	if (!d || !p || !out || !out_len) return false;
+	return val_view_data(path_eval(d, p), out, out_len);
+}
+
+size_t cblu_docr_path_count(CBLU_DocR* d, const CBLU_Path* p) {
+	if (!d || !p) return 0;
+	FLValue v = path_eval(d, p);
+	switch (FLValue_GetType(v)) {
+		case kFLArray: return FLArray_Count(FLValue_AsArray(v));
+		case kFLDict:  return FLDict_Count(FLValue_AsDict(v));
+		default:       return 0;
 	}
+}
 
-	CBLError err = {0};
-	FLSliceResult sr = CBLBlob_Content(blob, &err);
-	if (!sr.buf || sr.size == 0) { FLSliceResult_Release(sr); return 0; }
-	size_t nCopy = (sr.size < dstSize) ? sr.size : dstSize;
-	memcpy(dst, sr.buf, nCopy);
-	FLSliceResult_Release(sr);
+size_t cblu_docr_get_blob(CBLU_DocR* d, const char* key, void* dst, size_t dstSize,
+						  char* contentTypeDst, size_t ctDstSize) {
+	if (!d || !key || !dst || dstSize==0) return 0;
+	CBLU_BlobR* r = cblu_docr_blob_open(d, key);
+	if (!r) return 0;
+	if (contentTypeDst && ctDstSize>0) cblu_blobr_content_type(r, contentTypeDst, ctDstSize);
+	// Streams straight into dst: no intermediate copy of the whole blob
+	size_t nCopy = 0;
+	cblu_blobr_read(r, dst, dstSize, &nCopy);
+	cblu_blobr_close(r);
 	return nCopy;
 }
 
 void cblu_docr_free(CBLU_DocR* d) {
 	if (!d) return;
+	CBLU_REC_H(CBLU_REC_DOCR_FREE, d, 0, NULL, 0);
 	if (d->doc) { CBLDocument_Release(d->doc); d->doc = NULL; }
 	d->props = NULL;
-	free(d);
+	cblu__free(d);
 }
 
 bool cblu_open_collection(CBLU_Db* base, const char* scopeName, const char* collName, CBLU_Db** out_handle) {
@@ -370,27 +658,34 @@ bool cblu_open_collection(CBLU_Db* base, const char* scopeName, const char* coll
 	*out_handle = NULL;
 	CBLError err = {0};
 
-	// Get scope and collection
-	const CBLScope* scope = CBLDatabase_Scope(base->core.db, fl_from_c(scopeName), &err);
-	if (!scope) {
-		// scope may not exist
-		return false;
-	}
-	CBLCollection* coll = NULL;
-#ifdef CBLScope_Collection
-	coll = CBLScope_Collection(scope, fl_from_c(collName), &err);
-#else
-	// Older API exposes collection lookup on the database directly
-	coll = CBLDatabase_Collection(base->core.db, fl_from_c(scopeName), fl_from_c(collName), &err);
-#endif
+	// NULL with err.code == 0 when the scope or collection doesn't exist
+	CBLCollection* coll = CBLDatabase_Collection(base->core.db, fl_from_c(collName), fl_from_c(scopeName), &err);
 	if (!coll) {
+		if (err.code != 0) cblu__cbl_error("open collection", err);
 		return false;
 	}
 
 	// Create a lightweight handle bound to this collection
-	CBLU_Db* h = (CBLU_Db*)calloc(1, sizeof *h);
+	CBLU_Db* h = (CBLU_Db*)cblu__calloc(CBLU_MEM_DB, 1, sizeof *h);
+	if (!h) { CBLCollection_Release(coll); return false; }
 	h->core.db   = base->core.db;   // share DB (owned by base)
 	h->core.coll = coll;            // retained by API call
+	h->core.wmu  = base->core.wmu;  // one writer lock per CBLDatabase
+	h->epoch     = atomic_fetch_add_explicit(&g_db_epoch, 1, memory_order_relaxed) + 1;
 	*out_handle = h;
 	return true;
 }
+
+// ---- Internal collections ----
+bool cblu__sys_core(const CBLU_Core* base, const char* coll_name, CBLU_Core* out) {
+	CBLError err = {0};
+	cblu__write_lock(base);
+	CBLCollection* coll = CBLDatabase_CreateCollection(base->db, fl_from_c(coll_name), FLSTR(CBLU_SYS_SCOPE), &err);
+	cblu__write_unlock(base);
+	if (!coll) {
+		cblu__error("internal collection", (int)err.domain, (int)err.code, fl_from_c(coll_name));
+		return false;
+	}
+	*out = (CBLU_Core){ .db = base->db, .coll = coll, .wmu = base->wmu };
+	return true;
+}
@@ -25,13 +25,57 @@ typedef struct CBLU_Session CBLU_Session;
 typedef struct CBLU_DocW    CBLU_DocW;   // writeable doc
 typedef struct CBLU_DocR    CBLU_DocR;   // readable doc
 
+// ---- Threading ----
+//  CBLU_Db       shared by any number of threads; close it only after every
+//                session, document, query and module (counters, queue, event
+//                log, changes, ingest, shards) opened on it has been closed.
+//  CBLU_Session  one thread at a time. Use cblu_session_thread for a per-thread
+//                session without a transaction, or begin one per unit of work.
+//  CBLU_DocW     belongs to its session and thread; save or free it before the
+//                session ends.
+//  CBLU_DocR     immutable once fetched: it may outlive its session and be handed
+//                to another thread (one thread at a time; publish it through a
+//                queue, mutex or other release/acquire handoff). Valid until the
+//                CBLU_Db closes.
+//  CBLU_Query    one thread at a time; like a DocR it may outlive its session.
+//  Writes        a transactional session holds the database's writer lock from
+//                begin to end, and every save outside a transaction takes the
+//                same lock, so one thread's writes never land in another's open
+//                transaction. Concurrent transactions on one CBLU_Db therefore
+//                run one after another; keep them short, and don't call module
+//                functions (counters, queue, event log, import, ingest, shards)
+//                while holding one: they take their own lock before the writer
+//                lock, so the reverse order can deadlock. Sessions without a
+//                transaction read committed data through the reader pool if
+//                one is open, else the primary handle (which sees writes of an
+//                open transaction).
+
 // ---- Database lifecycle ----
 bool cblu_open(const char* db_name, const char* dir, CBLU_Db** out_db);  // creates if missing
 void cblu_close(CBLU_Db* db);
+typedef struct {
+	bool full_sync;  // fsync on every commit (durable across power loss; much slower on SD cards)
+} CBLU_OpenOptions;
+bool cblu_open_ex(const char* db_name, const char* dir, const CBLU_OpenOptions* opt, CBLU_Db** out_db);  // opt may be NULL
+// Handle on an existing collection of base's database; sessions on it read and write that
+// collection. cblu_close on it releases only the collection: close it before base.
+bool cblu_open_collection(CBLU_Db* base, const char* scopeName, const char* collName, CBLU_Db** out_handle);
+// Opens n extra read-only-use handles on the same file. Sessions without a transaction read
+// through one of them (fixed per thread); writes and transactional sessions use the primary.
+// Call once, before sessions are started. Readers see commits, not another session's open txn.
+bool cblu_open_readers(CBLU_Db* db, unsigned n);
 
 // ---- Session (optional transaction-like boundary) ----
 CBLU_Session* cblu_session_begin(CBLU_Db* db);           // default collection
 void          cblu_session_end(CBLU_Session* s);         // flush/cleanup (no txn for simplicity)
+// With use_txn the session's writes form one transaction, committed or rolled back at end.
+CBLU_Session* cblu_session_begin_txn(CBLU_Db* db, bool use_txn);
+void          cblu_session_end_txn(CBLU_Session* s, bool commit);
+// This thread's session on db (no transaction), created on first use and reused
+// after; ending it is a no-op. Freed at thread exit, or earlier by
+// cblu_session_thread_release (e.g. by long-lived threads before cblu_close).
+CBLU_Session* cblu_session_thread(CBLU_Db* db);
+void          cblu_session_thread_release(CBLU_Db* db);
 
 // ---- Write document API ----
 CBLU_DocW* cblu_docw_begin(CBLU_Session* s, const char* doc_id); // create/overwrite by id
@@ -39,8 +83,11 @@ void       cblu_docw_set_i64(CBLU_DocW* d, const char* key, int64_t v);
 void       cblu_docw_set_u64(CBLU_DocW* d, const char* key, uint64_t v);
 void       cblu_docw_set_f64(CBLU_DocW* d, const char* key, double v);
 void       cblu_docw_set_str(CBLU_DocW* d, const char* key, const char* s); // UTF-8
+void       cblu_docw_set_bool(CBLU_DocW* d, const char* key, bool v);
 void       cblu_docw_set_f64_array(CBLU_DocW* d, const char* key, const double* a, size_t n);
 void       cblu_docw_set_i64_array(CBLU_DocW* d, const char* key, const int64_t* a, size_t n);
+// Whole-payload blob (data must be resident); see cblu_docw_blob_begin for streaming.
+bool       cblu_docw_set_blob(CBLU_DocW* d, const char* key, const void* data, size_t size, const char* contentType);
 bool       cblu_docw_save(CBLU_DocW* d);  // commits into collection
 void       cblu_docw_free(CBLU_DocW* d);  // safe if not saved
 
@@ -57,8 +104,429 @@ size_t     cblu_docr_get_str(CBLU_DocR* d, const char* key, char* dst, size_t ds
 // Returns number of items copied (<= maxn). Missing/non-array → 0.
 size_t     cblu_docr_get_f64_array(CBLU_DocR* d, const char* key, double* out, size_t maxn);
 size_t     cblu_docr_get_i64_array(CBLU_DocR* d, const char* key, int64_t* out, size_t maxn);
+// Zero-copy views into the document: *out/*out_len are valid until cblu_docr_free.
+// Strings are NOT NUL-terminated. view_data also accepts string values.
+bool       cblu_docr_view_str(CBLU_DocR* d, const char* key, const char** out, size_t* out_len);
+bool       cblu_docr_view_data(CBLU_DocR* d, const char* key, const void** out, size_t* out_len);
+// Copies at most dstSize bytes of a blob into dst (streamed, no full-size buffer); returns bytes copied.
+// Use cblu_docr_blob_open to learn the size first or to read in chunks/ranges.
+size_t     cblu_docr_get_blob(CBLU_DocR* d, const char* key, void* dst, size_t dstSize,
+						  char* contentTypeDst, size_t ctDstSize);
 void       cblu_docr_free(CBLU_DocR* d);
 
+// ---- Nested reads (compiled key paths) ----
+// Paths like "gps.fix.lat" or "channels[3].gain" (negative indexes count from the end).
+// Compile once and reuse: evaluation does no string parsing. A compiled path is
+// immutable and may be shared between threads.
+typedef struct CBLU_Path CBLU_Path;
+CBLU_Path* cblu_path_compile(const char* path);  // NULL on syntax error
+void       cblu_path_free(CBLU_Path* p);
+
+// Same semantics as the cblu_docr_get_* counterparts
+bool   cblu_docr_path_has(CBLU_DocR* d, const CBLU_Path* p);
+bool   cblu_docr_path_i64(CBLU_DocR* d, const CBLU_Path* p, int64_t* out);
+bool   cblu_docr_path_u64(CBLU_DocR* d, const CBLU_Path* p, uint64_t* out);
+bool   cblu_docr_path_f64(CBLU_DocR* d, const CBLU_Path* p, double* out);
+bool   cblu_docr_path_bool(CBLU_DocR* d, const CBLU_Path* p, bool* out);
+size_t cblu_docr_path_str(CBLU_DocR* d, const CBLU_Path* p, char* dst, size_t dst_size);
+size_t cblu_docr_path_f64_array(CBLU_DocR* d, const CBLU_Path* p, double* out, size_t maxn);
+size_t cblu_docr_path_i64_array(CBLU_DocR* d, const CBLU_Path* p, int64_t* out, size_t maxn);
+bool   cblu_docr_path_view_str(CBLU_DocR* d, const CBLU_Path* p, const char** out, size_t* out_len);
+bool   cblu_docr_path_view_data(CBLU_DocR* d, const CBLU_Path* p, const void** out, size_t* out_len);
+size_t cblu_docr_path_count(CBLU_DocR* d, const CBLU_Path* p);  // items in an array/dict, else 0
+
+// ---- Blob streaming (read) ----
+// Reads run through CBLBlobReadStream into the caller's buffer at constant memory.
+// A reader keeps its document alive, so it may outlive the CBLU_DocR it came from.
+typedef struct CBLU_BlobR CBLU_BlobR;
+CBLU_BlobR* cblu_docr_blob_open(CBLU_DocR* d, const char* key);  // NULL if key isn't a blob
+uint64_t    cblu_blobr_size(CBLU_BlobR* r);                       // total length, known up front
+size_t      cblu_blobr_content_type(CBLU_BlobR* r, char* dst, size_t dst_size);
+// Fills dst with up to n bytes from the current position; *out_read < n only at end of blob.
+bool        cblu_blobr_read(CBLU_BlobR* r, void* dst, size_t n, size_t* out_read);
+// Range read: seeks to offset first (no-op if already there). Reads past the end are clipped.
+bool        cblu_blobr_read_at(CBLU_BlobR* r, uint64_t offset, void* dst, size_t n, size_t* out_read);
+void        cblu_blobr_close(CBLU_BlobR* r);
+
+// ---- Blob streaming (write) ----
+// Content goes to the blob store chunk by chunk; finish attaches the blob to the doc under key.
+// With crc32c=true a CRC-32C of the content is computed on a helper thread during the writes.
+typedef struct CBLU_BlobW CBLU_BlobW;
+CBLU_BlobW* cblu_docw_blob_begin(CBLU_DocW* d, const char* key, const char* content_type, bool crc32c);
+bool        cblu_blobw_write(CBLU_BlobW* w, const void* data, size_t n);
+bool        cblu_blobw_write_fd(CBLU_BlobW* w, int fd, uint64_t max_bytes);  // 0: until EOF
+uint64_t    cblu_blobw_size(CBLU_BlobW* w);                                  // bytes written so far
+bool        cblu_blobw_finish(CBLU_BlobW* w, uint32_t* out_crc32c);  // frees w; false if any write failed
+void        cblu_blobw_abort(CBLU_BlobW* w);                          // discard; doc is unchanged
+
+// ---- Blob mapping (zero-copy, read-only) ----
+// Maps the blob's file in the database's attachments directory. *out_ptr/*out_len stay valid
+// until cblu_blob_unmap, independent of d. NULL if the blob is missing or not stored as a
+// plain file. The fd (owned by the map) can be given to sendfile().
+typedef struct CBLU_BlobMap CBLU_BlobMap;
+CBLU_BlobMap* cblu_docr_blob_map(CBLU_DocR* d, const char* key, const void** out_ptr, size_t* out_len);
+int           cblu_blobmap_fd(CBLU_BlobMap* m);
+void          cblu_blob_unmap(CBLU_BlobMap* m);
+
+// ---- Bulk blob ingestion (parallel) ----
+// Worker threads stream files into the blob store (digest computed while writing); one writer
+// thread attaches each blob to its document (other properties kept) in batched transactions.
+// Bytes read but not yet committed never exceed max_inflight_bytes (a larger file runs alone).
+typedef struct CBLU_Ingest CBLU_Ingest;
+typedef struct {
+	unsigned threads;             // file workers (0: 4)
+	uint64_t max_inflight_bytes;  // 0: 64 MiB
+	unsigned batch_docs;          // docs per transaction (0: 64)
+} CBLU_IngestOptions;
+typedef struct {
+	uint64_t files;           // committed
+	uint64_t bytes;           // committed blob bytes
+	uint64_t failed;          // files that could not be read, stored or saved
+	uint64_t inflight_bytes;  // currently between read and commit
+} CBLU_IngestStats;
+
+CBLU_Ingest* cblu_ingest_begin(CBLU_Db* db, const CBLU_IngestOptions* opt);  // opt may be NULL
+// Queues one file; blocks while the queue is full. Strings are copied.
+bool         cblu_ingest_add(CBLU_Ingest* g, const char* path, const char* doc_id, const char* key, const char* content_type);
+void         cblu_ingest_stats(CBLU_Ingest* g, CBLU_IngestStats* out);  // progress while running
+bool         cblu_ingest_finish(CBLU_Ingest* g, CBLU_IngestStats* out); // drains and frees; false if any failed
+
+// ---- NDJSON import ----
+// One JSON object per line, parsed once with Fleece and saved batch_docs per transaction.
+// The doc ID comes from id_field (string, or integer in decimal); without it an ID is generated.
+// A '_'-prefixed id_field (the default) can't be stored in the body: it is always removed, and a
+// value that couldn't be the ID (object, float, null, "") moves to the name without the '_'s
+// ("_id" -> "id"), unless the body already has that key.
+typedef struct {
+	uint64_t records;          // saved
+	uint64_t bytes;            // input bytes consumed
+	uint64_t failed;           // unparsable lines, non-objects, failed saves
+	double   seconds;
+	double   records_per_sec;
+	double   bytes_per_sec;
+} CBLU_ImportStats;
+typedef struct {
+	const char* id_field;      // NULL/"": "_id"
+	bool        keep_id_field; // keep a used id in the body; not with a '_'-prefixed id_field (import fails)
+	unsigned    batch_docs;    // 0: 10000
+	void      (*progress)(void* ctx, const CBLU_ImportStats* st);  // after each commit
+	void*       progress_ctx;
+} CBLU_ImportOptions;
+
+bool cblu_import_ndjson_fd(CBLU_Db* db, int fd, const CBLU_ImportOptions* opt, CBLU_ImportStats* out);
+bool cblu_import_ndjson_file(CBLU_Db* db, const char* path, const CBLU_ImportOptions* opt, CBLU_ImportStats* out);
+
+// ---- Export (sequence order) ----
+// NDJSON: each line is the body with "_id" first (re-importable with the default options).
+// FLEECE: "CBLUFLX1", then per doc u32 id_len | id | u64 seq | u32 len | Fleece body (little-endian).
+// parts > 1 splits the sequence range and writes "<path>.<i>" in parallel (over the reader pool
+// if one is open); a range too small to split is written to "<path>.0" alone.
+typedef enum { CBLU_EXPORT_NDJSON = 0, CBLU_EXPORT_FLEECE = 1 } CBLU_ExportFormat;
+typedef struct {
+	CBLU_ExportFormat format;
+	unsigned          parts;       // 0/1: single file at path
+	uint64_t          after_seq;   // export only sequences > after_seq
+} CBLU_ExportOptions;
+typedef struct {
+	uint64_t docs;
+	uint64_t bytes;
+	double   seconds;
+} CBLU_ExportStats;
+
+bool cblu_export(CBLU_Db* db, const char* path, const CBLU_ExportOptions* opt, CBLU_ExportStats* out);
+
+// ---- Incremental changes (since a persisted checkpoint) ----
+// Enumerates live documents whose sequence is above the checkpoint, in sequence order.
+// Deletions are not reported. The checkpoint is one document in the internal collection
+// cblu.changes, so commit is atomic. Only committed documents are returned: scans go through
+// the reader pool when it is open (before begin), else they wait for open transactions.
+typedef struct CBLU_Changes CBLU_Changes;
+typedef struct {
+	const char* doc_id;  size_t doc_id_len;   // NUL-terminated; valid until the next call
+	const char* rev_id;  size_t rev_id_len;
+	const char* body;    size_t body_len;     // JSON
+	uint64_t    seq;
+} CBLU_Change;
+
+CBLU_Changes* cblu_changes_begin(CBLU_Db* db, const char* checkpoint_name);
+uint64_t      cblu_changes_since(CBLU_Changes* c);                            // committed checkpoint
+size_t        cblu_changes_next(CBLU_Changes* c, CBLU_Change* out, size_t max); // 0: caught up
+bool          cblu_changes_commit(CBLU_Changes* c);  // checkpoint := last sequence returned
+void          cblu_changes_end(CBLU_Changes* c);     // uncommitted progress is discarded
+
+// ---- Errors (structured, lock-free ring) ----
+// Every failure is recorded in a process-wide ring of the most recent 1024 errors and in
+// the calling thread's last-error slot. Logging is rate-limited (default: 10 lines/s to stderr).
+#define CBLU_ERR_DOMAIN_CBL      1    // Couchbase Lite (CBLErrorDomain values 1..6 pass through)
+#define CBLU_ERR_DOMAIN_POSIX    2    // code is errno
+#define CBLU_ERR_DOMAIN_FLEECE   4
+#define CBLU_ERR_DOMAIN_WRAPPER  100  // code is one of CBLU_ERR_*
+enum {
+	CBLU_ERR_NOMEM = 1,     // allocation failed; result truncated or operation not done
+	CBLU_ERR_THREAD,        // helper thread, lock or thread key couldn't be set up
+	CBLU_ERR_MISMATCH,      // persisted layout doesn't match the open parameters
+	CBLU_ERR_REJECTED,      // a caller callback refused the data
+	CBLU_ERR_INVALID,       // argument the call can't accept (e.g. wrong kind of block)
+};
+typedef struct {
+	uint64_t    seq;        // position in the ring since process start
+	uint64_t    time_ns;    // CLOCK_REALTIME
+	uint64_t    doc_hash;   // FNV-1a 64 of the doc ID involved, 0 if none
+	int32_t     domain, code;
+	const char* api;        // static string naming the failed step, e.g. "save", "blob read"
+} CBLU_ErrorRec;
+
+// Copies records after *cursor (start at 0) and advances it. *out_lost counts records
+// that were overwritten before they could be read. Safe from any thread, never blocks writers.
+size_t   cblu_errors_read(uint64_t* cursor, CBLU_ErrorRec* out, size_t max, uint64_t* out_lost);
+uint64_t cblu_errors_total(void);
+// fn NULL logs to stderr; max_per_sec 0 disables logging. suppressed = lines dropped since the last.
+typedef void (*CBLU_ErrorLogFn)(void* ctx, const CBLU_ErrorRec* e, uint64_t suppressed);
+void     cblu_errors_set_log(CBLU_ErrorLogFn fn, void* ctx, uint32_t max_per_sec);
+bool     cblu_last_error(CBLU_ErrorRec* out);                       // this thread's latest
+bool     cblu_session_last_error(CBLU_Session* s, CBLU_ErrorRec* out);  // latest from s's docs/txn
+
+// ---- Memory (allocator hooks and accounting) ----
+// All wrapper allocations (handles, buffers, queues) go through one allocator, libc by default,
+// and are counted per handle type. Couchbase Lite's own memory is not included.
+typedef struct {
+	void* (*malloc_fn)(void* ctx, size_t size);
+	void* (*realloc_fn)(void* ctx, void* p, size_t old_size, size_t new_size);  // may be NULL
+	void  (*free_fn)(void* ctx, void* p, size_t size);
+	void*   ctx;
+} CBLU_Allocator;
+// Call before anything else: false while any wrapper block is live, including one being
+// allocated by another thread at the same moment. NULL restores libc.
+bool cblu_set_allocator(const CBLU_Allocator* a);
+
+typedef enum {
+	CBLU_MEM_DB, CBLU_MEM_SESSION, CBLU_MEM_DOC, CBLU_MEM_PATH, CBLU_MEM_BLOB, CBLU_MEM_QUERY,
+	CBLU_MEM_ARROW, CBLU_MEM_CHANGES, CBLU_MEM_COUNTERS, CBLU_MEM_QUEUE, CBLU_MEM_EVLOG,
+	CBLU_MEM_INGEST, CBLU_MEM_IO,        // import/export buffers
+	CBLU_MEM_SHARDS, CBLU_MEM_METRICS, CBLU_MEM_STATS,
+	CBLU_MEM_COUNT                       // pass to cblu_mem_stats for the total
+} CBLU_MemType;
+typedef struct {
+	uint64_t live_bytes, peak_bytes;     // requested sizes, without allocator overhead
+	uint64_t allocs, frees, failed;      // failed: allocator returned NULL or limit reached
+} CBLU_MemStats;
+void        cblu_mem_stats(CBLU_MemType t, CBLU_MemStats* out);
+const char* cblu_mem_type_name(CBLU_MemType t);
+// Allocations that would take live bytes (all types) above max fail; 0 = no limit.
+void        cblu_mem_set_limit(uint64_t max_live_bytes);
+
+// ---- Statistics (per-operation counts and latency histograms) ----
+// Always on. Each thread records into its own shard; a snapshot merges them.
+// Internal transactions (counters, queue, import, ...) count as commit/rollback too.
+typedef enum {
+	CBLU_OP_OPEN,        // cblu_open / cblu_open_ex
+	CBLU_OP_SAVE,        // cblu_docw_save
+	CBLU_OP_GET,         // cblu_docr_get (a missing doc is not an error)
+	CBLU_OP_BLOB_READ,   // cblu_blobr_read / read_at, cblu_docr_get_blob
+	CBLU_OP_BLOB_WRITE,  // cblu_blobw_write / write_fd chunks
+	CBLU_OP_COMMIT,
+	CBLU_OP_ROLLBACK,
+	CBLU_OP_QUERY,       // cblu_query_begin (compile + execute)
+	CBLU_OP_COUNT
+} CBLU_Op;
+
+// Log-linear buckets: exact below 8 ns, then 8 per power of two up to 2^40 ns
+#define CBLU_STATS_BUCKETS 312
+typedef struct {
+	uint64_t calls, errors, sum_ns, max_ns;
+	uint64_t buckets[CBLU_STATS_BUCKETS];
+} CBLU_OpStats;
+typedef struct { CBLU_OpStats op[CBLU_OP_COUNT]; } CBLU_Stats;
+
+void        cblu_stats_snapshot(CBLU_Stats* out);  // totals since process start
+const char* cblu_stats_op_name(CBLU_Op op);        // "open", "save", ...
+uint64_t    cblu_stats_bucket_upper_ns(unsigned bucket);  // inclusive; UINT64_MAX for the last
+uint64_t    cblu_stats_percentile_ns(const CBLU_OpStats* s, double pct);  // e.g. 99.9
+
+// ---- Metrics exposition (Prometheus text format) ----
+// Renders all statistics, plus db file size and document count when db is non-NULL.
+// Returns the full length (excluding NUL); output is truncated if that is >= cap.
+size_t cblu_metrics_render(CBLU_Db* db, char* buf, size_t cap);
+// Atomically replaces path (tmp file + fsync + rename); name it *.prom for node_exporter.
+bool   cblu_metrics_write_file(CBLU_Db* db, const char* path);
+// Re-renders every interval_ms on its own thread, into path or fn (exactly one of them).
+// db must stay open until cblu_metrics_stop, which emits once more before returning.
+typedef void (*CBLU_MetricsFn)(void* ctx, const char* text, size_t len);
+typedef struct CBLU_MetricsTimer CBLU_MetricsTimer;
+CBLU_MetricsTimer* cblu_metrics_start(CBLU_Db* db, uint32_t interval_ms, const char* path,
+									  CBLU_MetricsFn fn, void* ctx);
+void               cblu_metrics_stop(CBLU_MetricsTimer* t);
+
+// ---- Trace recording (for offline replay) ----
+// Process-wide and opt-in. While recording, sessions, document writes and reads, key reads
+// and queries are appended to a binary file: handles, doc IDs, keys, value kinds and sizes
+// (never the values), N1QL text and timing. bench/cblu_replay re-executes a trace.
+// Only session-level calls are recorded: handles begun before recording started, shard
+// documents and the wrapper's own internal queries and saves are left out.
+bool cblu_record_start(const char* path);  // false if already recording or path can't be created
+bool cblu_record_stop(void);               // flushes and closes; false if any write failed
+
+// File: "CBLUREC1", then records of
+//   u8 op | varint dt_ns (since previous record) | varint handle | varint a | varint len, s[len] | varint b
+// Handles are the caller-visible pointers; a value may be reused after its FREE/END/SAVE record.
+typedef enum {
+	CBLU_REC_SESSION_BEGIN = 1,  // handle=session  a=use_txn
+	CBLU_REC_SESSION_END,        // handle=session  a=commit
+	CBLU_REC_DOCW_BEGIN,         // handle=doc      a=session  s=doc ID
+	CBLU_REC_DOCW_SET,           // handle=doc      a=CBLU_RecKind  s=key  b=bytes (str, blob) or items (arrays)
+	CBLU_REC_DOCW_SAVE,          // handle=doc      b=ok (handle is freed)
+	CBLU_REC_DOCW_FREE,          // handle=doc
+	CBLU_REC_DOCR_GET,           // handle=doc (0 if missing)  a=session  s=doc ID
+	CBLU_REC_DOCR_READ,          // handle=doc      s=key
+	CBLU_REC_DOCR_FREE,          // handle=doc
+	CBLU_REC_QUERY_BEGIN,        // handle=query    a=session  s=N1QL
+	CBLU_REC_QUERY_FREE,         // handle=query    b=rows fetched
+} CBLU_RecOp;
+typedef enum {
+	CBLU_REC_I64 = 1, CBLU_REC_U64, CBLU_REC_F64, CBLU_REC_BOOL, CBLU_REC_STR,
+	CBLU_REC_F64_ARRAY, CBLU_REC_I64_ARRAY, CBLU_REC_BLOB,
+} CBLU_RecKind;
+
+// ---- Counters (sharded; folded into documents periodically) ----
+// Adds go to per-thread in-memory cells, so hot counters don't contend on one revision.
+// A fold adds the pending cells into integer properties of their documents in one transaction.
+// The counter set borrows db's handles: close it before cblu_close(db).
+typedef struct CBLU_Counters CBLU_Counters;
+CBLU_Counters* cblu_counters_open(CBLU_Db* db, uint32_t flush_ms);  // flush_ms == 0: fold only on flush/close
+bool           cblu_counter_add(CBLU_Counters* c, const char* doc_id, const char* key, int64_t delta);
+// Exact value: stored property + unfolded cells. false if the counter has never been seen.
+bool           cblu_counter_get(CBLU_Counters* c, const char* doc_id, const char* key, int64_t* out);
+bool           cblu_counters_flush(CBLU_Counters* c);  // fold now; on failure deltas are kept for the next fold
+void           cblu_counters_close(CBLU_Counters* c);  // final fold, then free
+
+// ---- Work queue (durable, claim/ack with lease) ----
+// Messages are documents in the internal collection cblu.queue of db's database, so they don't
+// show up in queries, export or changes. The ready list and leases are kept in memory,
+// so claims are O(1) and never scan. Leases are not persisted: after a restart every
+// unacked message is claimable again (at-least-once). Safe for many consumer threads.
+typedef struct CBLU_Queue CBLU_Queue;
+typedef struct {
+	uint64_t    seq;        // enqueue order, unique per queue
+	uint32_t    attempts;   // deliveries since open, including this one
+	const void* data;       // valid until ack/nack
+	size_t      size;
+	uint64_t    _gen;       // lease token (internal)
+	const void* _doc;       // retained body (internal)
+} CBLU_QueueMsg;
+
+CBLU_Queue* cblu_queue_open(CBLU_Db* db, const char* name);  // rebuilds the index from persisted head..tail
+// Appends n messages in one transaction; all or none are enqueued.
+bool        cblu_queue_enqueue(CBLU_Queue* q, const void* const* data, const size_t* sizes, size_t n);
+// Leases up to max ready messages for lease_ms; expired leases become claimable again. Returns count.
+size_t      cblu_queue_claim(CBLU_Queue* q, size_t max, uint32_t lease_ms, CBLU_QueueMsg* out);
+// Removes messages in one transaction. false if any lease had already been lost. Always releases msgs.
+bool        cblu_queue_ack(CBLU_Queue* q, CBLU_QueueMsg* msgs, size_t n);
+void        cblu_queue_nack(CBLU_Queue* q, CBLU_QueueMsg* msgs, size_t n);  // back to the end of the ready list
+size_t      cblu_queue_size(CBLU_Queue* q);   // ready + leased
+void        cblu_queue_close(CBLU_Queue* q);  // outstanding messages must be acked/nacked first
+
+// ---- Event log (append-only, compacted into snapshots) ----
+// Events are opaque byte strings numbered from 1. The caller's fold keeps the derived state;
+// every snapshot_every events it is saved into a snapshot document and the covered events are
+// purged, so open replays at most snapshot_every events however long the log is. Each event is
+// one small document, so appends cost the same at any length. Its documents live in the
+// internal collection cblu.evlog of db's database.
+typedef struct CBLU_EventLog CBLU_EventLog;
+typedef struct {
+	void* ctx;
+	void (*reset)(void* ctx);                                             // optional: clear state
+	void (*apply)(void* ctx, uint64_t seq, const void* ev, size_t size);  // fold one event
+	void (*save)(void* ctx, CBLU_DocW* snap);   // write state with cblu_docw_set_* (key "cblu.seq" is reserved)
+	bool (*load)(void* ctx, CBLU_DocR* snap);   // restore state with cblu_docr_get_*
+} CBLU_EventFold;
+
+// Restores state (snapshot + tail replay) through fold before returning.
+CBLU_EventLog* cblu_evlog_open(CBLU_Db* db, const char* name, uint32_t snapshot_every,
+							   const CBLU_EventFold* fold);
+bool           cblu_evlog_append(CBLU_EventLog* l, const void* ev, size_t size, uint64_t* out_seq);
+bool           cblu_evlog_snapshot(CBLU_EventLog* l);  // compact now
+uint64_t       cblu_evlog_seq(CBLU_EventLog* l);       // last appended sequence
+void           cblu_evlog_close(CBLU_EventLog* l);
+
+// ---- Query (SQL++ / N1QL, forward-only cursor) ----
+// Name the collection in the query text: "_" is the default collection, "scope.coll" others.
+typedef struct CBLU_Query CBLU_Query;
+CBLU_Query* cblu_query_begin(CBLU_Session* s, const char* n1ql);  // NULL on compile/execute error
+bool        cblu_query_next(CBLU_Query* q);                       // advance to the next row
+unsigned    cblu_query_columns(CBLU_Query* q);
+size_t      cblu_query_column_name(CBLU_Query* q, unsigned col, char* dst, size_t dst_size);
+bool        cblu_query_get_i64(CBLU_Query* q, unsigned col, int64_t* out);
+bool        cblu_query_get_f64(CBLU_Query* q, unsigned col, double* out);
+size_t      cblu_query_get_str(CBLU_Query* q, unsigned col, char* dst, size_t dst_size);
+void        cblu_query_free(CBLU_Query* q);
+
+// ---- Arrow C Data Interface export (no Arrow dependency) ----
+// Buffers are 64-byte aligned and owned by the exported array; consumers adopt
+// them zero-copy and call release() on both structs when done.
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+#define ARROW_FLAG_DICTIONARY_ORDERED 1
+#define ARROW_FLAG_NULLABLE 2
+#define ARROW_FLAG_MAP_KEYS_SORTED 4
+struct ArrowSchema {
+	const char* format;
+	const char* name;
+	const char* metadata;
+	int64_t flags;
+	int64_t n_children;
+	struct ArrowSchema** children;
+	struct ArrowSchema* dictionary;
+	void (*release)(struct ArrowSchema*);
+	void* private_data;
+};
+struct ArrowArray {
+	int64_t length;
+	int64_t null_count;
+	int64_t offset;
+	int64_t n_buffers;
+	int64_t n_children;
+	const void** buffers;
+	struct ArrowArray** children;
+	struct ArrowArray* dictionary;
+	void (*release)(struct ArrowArray*);
+	void* private_data;
+};
+#endif
+
+// Drains up to max_rows (0: all) remaining rows into a struct array ("+s"), one child per
+// column. Column types follow the first non-null value: int64, float64, bool or utf8
+// (arrays/dicts as JSON); ints widen to float64 if a fractional value follows.
+bool cblu_query_to_arrow(CBLU_Query* q, size_t max_rows, struct ArrowSchema* out_schema, struct ArrowArray* out_array);
+// Numeric array property (a series) as a flat float64 / int64 array; non-numbers are nulls
+bool cblu_docr_f64_array_to_arrow(CBLU_DocR* d, const char* key, struct ArrowSchema* out_schema, struct ArrowArray* out_array);
+bool cblu_docr_i64_array_to_arrow(CBLU_DocR* d, const char* key, struct ArrowSchema* out_schema, struct ArrowArray* out_array);
+
+// ---- Sharded database (N files "<name>.<i>", routed by hash) ----
+// Each shard has a writer thread that saves submitted docs in batched transactions.
+// The shard count is recorded in shard 0 (internal collection cblu.shards) and must match on
+// every open.
+typedef struct CBLU_ShardedDb CBLU_ShardedDb;
+bool       cblu_shards_open(const char* db_name, const char* dir, unsigned nshards, CBLU_ShardedDb** out);
+void       cblu_shards_close(CBLU_ShardedDb* s);  // drains pending writes
+unsigned   cblu_shards_count(CBLU_ShardedDb* s);
+unsigned   cblu_shards_route(CBLU_ShardedDb* s, const char* key);   // FNV-1a(key) % nshards
+CBLU_Db*   cblu_shards_db(CBLU_ShardedDb* s, unsigned shard);       // for sessions on one shard
+
+// Begin a doc on the shard chosen by route_key (NULL: by doc_id); fill with cblu_docw_set_*.
+CBLU_DocW* cblu_shards_docw_begin(CBLU_ShardedDb* s, const char* doc_id, const char* route_key);
+// Takes ownership on success; blocks if the shard is backlogged. Only handles from
+// cblu_shards_docw_begin on s are accepted (others: false, still the caller's).
+bool       cblu_shards_submit(CBLU_ShardedDb* s, CBLU_DocW* d);
+bool       cblu_shards_flush(CBLU_ShardedDb* s);  // waits for submitted docs; false if any failed since last flush
+
+// Scatter-gather. out[i] is NULL for missing ids; free hits with cblu_docr_free. Returns hits.
+// Reads route by doc_id, so docs submitted with a custom route_key are found via cblu_shards_db.
+size_t     cblu_shards_get_many(CBLU_ShardedDb* s, const char* const* ids, size_t n, CBLU_DocR** out);
+// Runs the query on every shard in parallel; fn calls are serialized. Return false from fn to stop.
+// Reads run on the shards' writer threads, so fn must not call cblu_shards_submit/flush.
+typedef bool (*CBLU_ShardRowFn)(void* ctx, unsigned shard, CBLU_Query* row);
+bool       cblu_shards_query(CBLU_ShardedDb* s, const char* n1ql, CBLU_ShardRowFn fn, void* ctx);
+
 #ifdef __cplusplus
 }
 #endif
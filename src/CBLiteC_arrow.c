@@ -0,0 +1,365 @@
+//
+//  CBLiteC_arrow.c
+//
+//  Arrow C Data Interface export of query results and numeric series.
+//
+//  Columns are built in 64-byte aligned contiguous buffers owned by the
+//  exported ArrowArray; consumers adopt them without copying and free them
+//  through the release callback. Column types come from the first non-null
+//  value: integers → int64 ("l"), other numbers → float64 ("g", an int64
+//  column is widened in place if a fractional value shows up later),
+//  booleans → "b", strings → utf8 ("u"), arrays/dicts → their JSON as utf8.
+//  A value that doesn't fit the column's type is exported as null.
+//
+
+#include "CBLiteC_internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define ARROW_ALIGN  64
+
+enum { COL_NULL = 0, COL_I64, COL_F64, COL_BOOL, COL_UTF8 };
+
+typedef struct {
+	int      type;
+	int64_t  length, nulls;
+	int64_t  lead;              // nulls seen before the type was known
+	uint8_t* validity;   size_t vcap;   // bytes
+	uint8_t* data;       size_t dlen, dcap;
+	int32_t* offsets;    size_t ocap;   // utf8: length+1 entries
+} ColBuilder;
+
+// ---- release callbacks ----
+typedef struct {
+	const void* buffers[3];
+	void*       owned[3];
+	struct ArrowArray** children;
+	int64_t     nchildren;
+} ArrayPriv;
+
+static void arrow_array_release(struct ArrowArray* a) {
+	if (!a || !a->release) return;
+	ArrayPriv* p = (ArrayPriv*)a->private_data;
+	if (p) {
+		for (int64_t i = 0; i < p->nchildren; i++) {
+			if (p->children[i]->release) p->children[i]->release(p->children[i]);
+			cblu__free(p->children[i]);
+		}
+		cblu__free(p->children);
+		for (int i = 0; i < 3; i++) cblu__free(p->owned[i]);
+		cblu__free(p);
+	}
+	a->release = NULL;
+}
+
+typedef struct {
+	char*                name;
+	char*                format;
+	struct ArrowSchema** children;
+	int64_t              nchildren;
+} SchemaPriv;
+
+static void arrow_schema_release(struct ArrowSchema* s) {
+	if (!s || !s->release) return;
+	SchemaPriv* p = (SchemaPriv*)s->private_data;
+	if (p) {
+		for (int64_t i = 0; i < p->nchildren; i++) {
+			if (p->children[i]->release) p->children[i]->release(p->children[i]);
+			cblu__free(p->children[i]);
+		}
+		cblu__free(p->children);
+		cblu__free(p->name);
+		cblu__free(p->format);
+		cblu__free(p);
+	}
+	s->release = NULL;
+}
+
+static bool schema_init(struct ArrowSchema* s, const char* format, const char* name, int64_t nchildren) {
+	memset(s, 0, sizeof *s);
+	SchemaPriv* p = (SchemaPriv*)cblu__calloc(CBLU_MEM_ARROW, 1, sizeof *p);
+	if (!p) return false;
+	p->format = cblu__strdup(CBLU_MEM_ARROW, format);
+	p->name   = cblu__strdup(CBLU_MEM_ARROW, name ? name : "");
+	p->children = nchildren ? (struct ArrowSchema**)cblu__calloc(CBLU_MEM_ARROW, (size_t)nchildren, sizeof *p->children) : NULL;
+	if (!p->format || !p->name || (nchildren && !p->children)) {
+		cblu__free(p->format); cblu__free(p->name); cblu__free(p->children); cblu__free(p);
+		return false;
+	}
+	p->nchildren   = nchildren;
+	s->format      = p->format;
+	s->name        = p->name;
+	s->flags       = ARROW_FLAG_NULLABLE;
+	s->n_children  = nchildren;
+	s->children    = p->children;
+	s->release     = arrow_schema_release;
+	s->private_data = p;
+	return true;
+}
+
+// ---- column building ----
+static bool grow(uint8_t** buf, size_t* cap, size_t need) {
+	if (need <= *cap) return true;
+	size_t cap2 = *cap ? *cap : 256;
+	while (cap2 < need) cap2 *= 2;
+	void* nb = cblu__aligned_alloc(CBLU_MEM_ARROW, ARROW_ALIGN, cap2);
+	if (!nb) return false;
+	if (*buf) memcpy(nb, *buf, *cap);
+	memset((uint8_t*)nb + *cap, 0, cap2 - *cap);
+	cblu__free(*buf);
+	*buf = (uint8_t*)nb;
+	*cap = cap2;
+	return true;
+}
+
+static inline void bit_set(uint8_t* bits, int64_t i, bool v) {
+	if (v) bits[i >> 3] |= (uint8_t)(1u << (i & 7));
+	else   bits[i >> 3] &= (uint8_t)~(1u << (i & 7));
+}
+
+// Appends one slot (value or null) in the column's current layout
+static bool col_slot(ColBuilder* c, bool valid) {
+	int64_t i = c->length;
+	if (!grow(&c->validity, &c->vcap, (size_t)(i / 8 + 1))) return false;
+	switch (c->type) {
+		case COL_I64: case COL_F64:
+			if (!grow(&c->data, &c->dcap, (size_t)(i + 1) * 8)) return false;
+			c->dlen = (size_t)(i + 1) * 8;
+			break;
+		case COL_BOOL:
+			if (!grow(&c->data, &c->dcap, (size_t)(i / 8 + 1))) return false;
+			break;
+		case COL_UTF8: {
+			uint8_t* o = (uint8_t*)c->offsets;
+			if (!grow(&o, &c->ocap, (size_t)(i + 2) * sizeof(int32_t))) return false;
+			c->offsets = (int32_t*)o;
+			c->offsets[i + 1] = c->offsets[i];
+			break;
+		}
+		default: break;
+	}
+	bit_set(c->validity, i, valid);
+	if (!valid) c->nulls++;
+	c->length++;
+	return true;
+}
+
+static bool col_set_type(ColBuilder* c, int type) {
+	c->type = type;
+	int64_t lead = c->lead;
+	c->length = 0; c->nulls = 0; c->lead = 0;
+	if (type == COL_UTF8) {
+		uint8_t* o = (uint8_t*)c->offsets;
+		if (!grow(&o, &c->ocap, sizeof(int32_t))) return false;
+		c->offsets = (int32_t*)o;
+		c->offsets[0] = 0;
+	}
+	for (int64_t i = 0; i < lead; i++) if (!col_slot(c, false)) return false;
+	return true;
+}
+
+static bool col_append_utf8(ColBuilder* c, const void* s, size_t n) {
+	int64_t i = c->length;
+	if ((uint64_t)c->offsets[i] + n > INT32_MAX) return col_slot(c, false);  // exceeds "u" offsets
+	if (!grow(&c->data, &c->dcap, (size_t)c->offsets[i] + n)) return false;
+	if (!col_slot(c, true)) return false;
+	memcpy(c->data + c->offsets[i], s, n);
+	c->offsets[i + 1] = c->offsets[i] + (int32_t)n;
+	return true;
+}
+
+static bool col_append(ColBuilder* c, FLValue v) {
+	FLValueType t = v ? FLValue_GetType(v) : kFLNull;
+	if (t == kFLNull || t == kFLUndefined) {
+		if (c->type == COL_NULL) { c->lead++; c->length++; c->nulls++; return true; }
+		return col_slot(c, false);
+	}
+	if (c->type == COL_NULL) {
+		int type = (t == kFLNumber)  ? (FLValue_IsInteger(v) ? COL_I64 : COL_F64)
+				 : (t == kFLBoolean) ? COL_BOOL : COL_UTF8;
+		c->length -= c->lead; c->nulls -= c->lead;
+		if (!col_set_type(c, type)) return false;
+	}
+	switch (c->type) {
+		case COL_I64:
+			if (t == kFLNumber && !FLValue_IsInteger(v)) {
+				// Widen to float64 in place: same 8-byte slots
+				for (int64_t i = 0; i < c->length; i++) {
+					int64_t x; memcpy(&x, c->data + i * 8, 8);
+					double d = (double)x; memcpy(c->data + i * 8, &d, 8);
+				}
+				c->type = COL_F64;
+				return col_append(c, v);
+			}
+			if (t != kFLNumber) return col_slot(c, false);
+			if (!col_slot(c, true)) return false;
+			{ int64_t x = FLValue_AsInt(v); memcpy(c->data + (c->length - 1) * 8, &x, 8); }
+			return true;
+		case COL_F64:
+			if (t != kFLNumber) return col_slot(c, false);
+			if (!col_slot(c, true)) return false;
+			{ double d = FLValue_AsDouble(v); memcpy(c->data + (c->length - 1) * 8, &d, 8); }
+			return true;
+		case COL_BOOL:
+			if (t != kFLBoolean) return col_slot(c, false);
+			if (!col_slot(c, true)) return false;
+			bit_set(c->data, c->length - 1, FLValue_AsBool(v));
+			return true;
+		case COL_UTF8:
+			if (t == kFLString) { FLString s = FLValue_AsString(v); return col_append_utf8(c, s.buf, s.size); }
+			if (t == kFLArray || t == kFLDict) {
+				FLStringResult js = FLValue_ToJSON(v);
+				bool ok = col_append_utf8(c, js.buf, js.size);
+				FLSliceResult_Release(js);
+				return ok;
+			}
+			return col_slot(c, false);
+		default:
+			return false;
+	}
+}
+
+static void col_free(ColBuilder* c) {
+	cblu__free(c->validity); cblu__free(c->data); cblu__free(c->offsets);
+	memset(c, 0, sizeof *c);
+}
+
+static const char* col_format(const ColBuilder* c) {
+	switch (c->type) {
+		case COL_I64:  return "l";
+		case COL_F64:  return "g";
+		case COL_BOOL: return "b";
+		case COL_UTF8: return "u";
+		default:       return "n";
+	}
+}
+
+// Moves the builder's buffers into out (the builder is left empty)
+static bool col_export(ColBuilder* c, struct ArrowArray* out) {
+	memset(out, 0, sizeof *out);
+	ArrayPriv* p = (ArrayPriv*)cblu__calloc(CBLU_MEM_ARROW, 1, sizeof *p);
+	if (!p) return false;
+	out->length     = c->length;
+	out->null_count = c->nulls;
+	out->buffers    = p->buffers;
+	out->release    = arrow_array_release;
+	out->private_data = p;
+	if (c->type == COL_NULL) {
+		out->n_buffers = 0;           // null type has no buffers
+	} else {
+		p->owned[0] = c->validity;
+		p->buffers[0] = c->nulls ? c->validity : NULL;
+		p->owned[1] = (c->type == COL_UTF8) ? (void*)c->offsets : (void*)c->data;
+		p->buffers[1] = p->owned[1];
+		out->n_buffers = 2;
+		if (c->type == COL_UTF8) {
+			p->owned[2] = c->data;
+			p->buffers[2] = c->data;
+			out->n_buffers = 3;
+		} else {
+			cblu__free(c->offsets);
+		}
+		c->validity = NULL; c->data = NULL; c->offsets = NULL;
+	}
+	col_free(c);
+	return true;
+}
+
+// Wraps built columns as a struct array ("+s") with one child per column
+static bool export_struct(ColBuilder* cols, char** names, unsigned ncols, int64_t rows,
+						  struct ArrowSchema* out_schema, struct ArrowArray* out_array) {
+	if (!schema_init(out_schema, "+s", "", ncols)) return false;
+	out_schema->flags = 0;
+	memset(out_array, 0, sizeof *out_array);
+	ArrayPriv* p = (ArrayPriv*)cblu__calloc(CBLU_MEM_ARROW, 1, sizeof *p);
+	if (p && ncols) p->children = (struct ArrowArray**)cblu__calloc(CBLU_MEM_ARROW, ncols, sizeof *p->children);
+	if (!p || (ncols && !p->children)) { cblu__free(p); out_schema->release(out_schema); return false; }
+	out_array->length       = rows;
+	out_array->n_buffers    = 1;       // validity only; no null rows
+	out_array->buffers      = p->buffers;
+	out_array->n_children   = ncols;
+	out_array->children     = p->children;
+	out_array->release      = arrow_array_release;
+	out_array->private_data = p;
+
+	bool ok = true;
+	for (unsigned i = 0; i < ncols; i++) {
+		struct ArrowSchema* cs = (struct ArrowSchema*)cblu__calloc(CBLU_MEM_ARROW, 1, sizeof *cs);
+		struct ArrowArray*  ca = (struct ArrowArray*)cblu__calloc(CBLU_MEM_ARROW, 1, sizeof *ca);
+		if (!cs || !ca || !schema_init(cs, col_format(&cols[i]), names ? names[i] : NULL, 0) || !col_export(&cols[i], ca)) {
+			if (cs && cs->release) cs->release(cs);
+			cblu__free(cs); cblu__free(ca);
+			ok = false;
+			break;
+		}
+		out_schema->children[i] = cs;
+		((SchemaPriv*)out_schema->private_data)->nchildren = i + 1;
+		out_schema->n_children = i + 1;
+		p->children[i] = ca;
+		p->nchildren   = i + 1;
+		out_array->n_children = i + 1;
+	}
+	if (!ok) { out_array->release(out_array); out_schema->release(out_schema); }
+	return ok;
+}
+
+// ---- Public API ----
+bool cblu_query_to_arrow(CBLU_Query* q, size_t max_rows, struct ArrowSchema* out_schema, struct ArrowArray* out_array) {
+	if (!q || !out_schema || !out_array) return false;
+	unsigned ncols = q->ncols;
+	ColBuilder* cols = (ColBuilder*)cblu__calloc(CBLU_MEM_ARROW, ncols ? ncols : 1, sizeof *cols);
+	char** names = (char**)cblu__calloc(CBLU_MEM_ARROW, ncols ? ncols : 1, sizeof *names);
+	if (!cols || !names) { cblu__free(cols); cblu__free(names); return false; }
+
+	bool ok = true;
+	for (unsigned i = 0; i < ncols && ok; i++) {
+		FLSlice n = CBLQuery_ColumnName(q->query, i);
+		names[i] = (char*)cblu__malloc(CBLU_MEM_ARROW, n.size + 1);
+		if (!names[i]) { ok = false; break; }
+		if (n.size) memcpy(names[i], n.buf, n.size);
+		names[i][n.size] = 0;
+	}
+	int64_t rows = 0;
+	while (ok && (max_rows == 0 || (size_t)rows < max_rows) && CBLResultSet_Next(q->rs)) {
+		for (unsigned i = 0; i < ncols && ok; i++) ok = col_append(&cols[i], CBLResultSet_ValueAtIndex(q->rs, i));
+		rows++;
+	}
+	q->rows += (uint64_t)rows;
+	if (ok) ok = export_struct(cols, names, ncols, rows, out_schema, out_array);
+	for (unsigned i = 0; i < ncols; i++) { col_free(&cols[i]); cblu__free(names[i]); }
+	cblu__free(cols); cblu__free(names);
+	return ok;
+}
+
+// Numeric array property as a flat Arrow array; non-numbers become nulls
+static bool docr_array_to_arrow(CBLU_DocR* d, const char* key, int type,
+								struct ArrowSchema* out_schema, struct ArrowArray* out_array) {
+	if (!d || !key || !out_schema || !out_array) return false;
+	FLValue v = FLDict_Get(d->props, fl_from_c(key));
+	if (FLValue_GetType(v) != kFLArray) return false;
+	FLArray a = FLValue_AsArray(v);
+	uint32_t n = FLArray_Count(a);
+
+	ColBuilder c = {0};
+	bool ok = col_set_type(&c, type);
+	for (uint32_t i = 0; i < n && ok; i++) {
+		FLValue item = FLArray_Get(a, i);
+		if (!fl_is_number(item)) { ok = col_slot(&c, false); continue; }
+		ok = col_slot(&c, true);
+		if (!ok) break;
+		if (type == COL_F64) { double x = FLValue_AsDouble(item); memcpy(c.data + (size_t)i * 8, &x, 8); }
+		else                 { int64_t x = FLValue_AsInt(item);   memcpy(c.data + (size_t)i * 8, &x, 8); }
+	}
+	if (ok) ok = schema_init(out_schema, col_format(&c), key, 0);
+	if (ok && !col_export(&c, out_array)) { out_schema->release(out_schema); ok = false; }
+	col_free(&c);
+	return ok;
+}
+
+bool cblu_docr_f64_array_to_arrow(CBLU_DocR* d, const char* key, struct ArrowSchema* out_schema, struct ArrowArray* out_array) {
+	return docr_array_to_arrow(d, key, COL_F64, out_schema, out_array);
+}
+
+bool cblu_docr_i64_array_to_arrow(CBLU_DocR* d, const char* key, struct ArrowSchema* out_schema, struct ArrowArray* out_array) {
+	return docr_array_to_arrow(d, key, COL_I64, out_schema, out_array);
+}
@@ -0,0 +1,419 @@
+//
+//  CBLiteC_blob.c
+//
+//  Streaming blob access: content is read through CBLBlobReadStream straight
+//  into caller buffers and written chunk by chunk through CBLBlobWriteStream,
+//  so a blob is never held in memory as a whole. Stored blobs can also be
+//  mapped read-only for zero-copy serving.
+//
+
+#include "CBLiteC_internal.h"
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+struct CBLU_BlobR {
+	const CBLDocument* doc;      // retained: owns the blob's metadata
+	const CBLBlob*     blob;
+	CBLBlobReadStream* stream;
+	uint64_t           pos;
+	uint64_t           size;
+};
+
+// ---- Read ----
+CBLU_BlobR* cblu_docr_blob_open(CBLU_DocR* d, const char* key) {
+	if (!d || !key) return NULL;
+	const CBLBlob* blob = fl_get_blob(FLDict_Get(d->props, fl_from_c(key)));
+	if (!blob) return NULL;
+	CBLError err = {0};
+	CBLBlobReadStream* stream = CBLBlob_OpenContentStream(blob, &err);
+	if (!stream) {
+		cblu__cbl_error("blob open", err);
+		return NULL;
+	}
+	CBLU_BlobR* r = (CBLU_BlobR*)cblu__calloc(CBLU_MEM_BLOB, 1, sizeof *r);
+	if (!r) { CBLBlobReader_Close(stream); return NULL; }
+	r->doc    = CBLDocument_Retain(d->doc);
+	r->blob   = blob;
+	r->stream = stream;
+	r->size   = CBLBlob_Length(blob);
+	return r;
+}
+
+uint64_t cblu_blobr_size(CBLU_BlobR* r) {
+	return r ? r->size : 0;
+}
+
+size_t cblu_blobr_content_type(CBLU_BlobR* r, char* dst, size_t dst_size) {
+	if (!r || !dst || dst_size == 0) return 0;
+	FLString ct = CBLBlob_ContentType(r->blob);
+	size_t n = (ct.buf && ct.size < (dst_size - 1)) ? ct.size : (dst_size - 1);
+	if (ct.buf) { memcpy(dst, ct.buf, n); dst[n] = 0; } else { dst[0] = 0; n = 0; }
+	return n;
+}
+
+bool cblu_blobr_read(CBLU_BlobR* r, void* dst, size_t n, size_t* out_read) {
+	if (out_read) *out_read = 0;
+	if (!r || (!dst && n > 0)) return false;
+	size_t got = 0;
+	CBLU_TRACE1(blob_read_entry, n);
+	uint64_t t0 = cblu__now_ns();
+	// The stream may return short reads; keep going until n bytes or EOF
+	while (got < n) {
+		CBLError err = {0};
+		int rc = CBLBlobReader_Read(r->stream, (char*)dst + got, n - got, &err);
+		if (rc < 0) {
+			cblu__cbl_error("blob read", err);
+			cblu__stats_record(CBLU_OP_BLOB_READ, t0, false);
+			CBLU_TRACE3(blob_read_return, got, 0, (int)err.code);
+			r->pos += got;
+			if (out_read) *out_read = got;
+			return false;
+		}
+		if (rc == 0) break;
+		got += (size_t)rc;
+	}
+	cblu__stats_record(CBLU_OP_BLOB_READ, t0, true);
+	CBLU_TRACE3(blob_read_return, got, 1, 0);
+	r->pos += got;
+	if (out_read) *out_read = got;
+	return true;
+}
+
+bool cblu_blobr_read_at(CBLU_BlobR* r, uint64_t offset, void* dst, size_t n, size_t* out_read) {
+	if (out_read) *out_read = 0;
+	if (!r) return false;
+	if (offset >= r->size) return true;
+	if (offset != r->pos) {
+		CBLError err = {0};
+		int64_t p = CBLBlobReader_Seek(r->stream, (int64_t)offset, kCBLSeekModeFromStart, &err);
+		if (p < 0) {
+			cblu__cbl_error("blob seek", err);
+			return false;
+		}
+		r->pos = (uint64_t)p;
+	}
+	if (n > r->size - offset) n = (size_t)(r->size - offset);
+	return cblu_blobr_read(r, dst, n, out_read);
+}
+
+void cblu_blobr_close(CBLU_BlobR* r) {
+	if (!r) return;
+	if (r->stream) CBLBlobReader_Close(r->stream);
+	if (r->doc) CBLDocument_Release(r->doc);
+	cblu__free(r);
+}
+
+// ---- Write ----
+// Chunks are written through CBLBlobWriteStream (which digests and stores them);
+// an optional CRC-32C runs on a helper thread alongside each write.
+
+#define CBLU_BLOB_CHUNK  (256u * 1024u)
+#define CBLU_BLOB_ALIGN  4096u
+
+// Per-thread reusable I/O buffer, released when the thread exits
+static pthread_key_t  g_buf_key;
+static pthread_once_t g_buf_once = PTHREAD_ONCE_INIT;
+
+static void blob_buf_key(void) { pthread_key_create(&g_buf_key, cblu__free); }
+
+static void* blob_buf(void) {
+	pthread_once(&g_buf_once, blob_buf_key);
+	void* b = pthread_getspecific(g_buf_key);
+	if (!b) {
+		if (!(b = cblu__aligned_alloc(CBLU_MEM_BLOB, CBLU_BLOB_ALIGN, CBLU_BLOB_CHUNK))) return NULL;
+		pthread_setspecific(g_buf_key, b);
+	}
+	return b;
+}
+
+// CRC-32C (Castagnoli), hardware-assisted where the target has it
+#if defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+static uint32_t crc32c_update(uint32_t crc, const uint8_t* p, size_t n) {
+	crc = ~crc;
+	for (; n >= 8; n -= 8, p += 8) { uint64_t v; memcpy(&v, p, 8); crc = __crc32cd(crc, v); }
+	while (n--) crc = __crc32cb(crc, *p++);
+	return ~crc;
+}
+#elif defined(__SSE4_2__)
+#include <nmmintrin.h>
+static uint32_t crc32c_update(uint32_t crc, const uint8_t* p, size_t n) {
+	uint64_t c = ~crc;
+	for (; n >= 8; n -= 8, p += 8) { uint64_t v; memcpy(&v, p, 8); c = _mm_crc32_u64(c, v); }
+	uint32_t c32 = (uint32_t)c;
+	while (n--) c32 = _mm_crc32_u8(c32, *p++);
+	return ~c32;
+}
+#else
+static uint32_t g_crc32c_table[256];
+static pthread_once_t g_crc32c_once = PTHREAD_ONCE_INIT;
+static void crc32c_init(void) {
+	for (uint32_t i = 0; i < 256; i++) {
+		uint32_t c = i;
+		for (int k = 0; k < 8; k++) c = (c & 1) ? (c >> 1) ^ 0x82F63B78u : (c >> 1);
+		g_crc32c_table[i] = c;
+	}
+}
+static uint32_t crc32c_update(uint32_t crc, const uint8_t* p, size_t n) {
+	pthread_once(&g_crc32c_once, crc32c_init);
+	crc = ~crc;
+	while (n--) crc = g_crc32c_table[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+	return ~crc;
+}
+#endif
+
+typedef struct {
+	pthread_t       thread;
+	pthread_mutex_t mu;
+	pthread_cond_t  cv;
+	const void*     data;      // job in flight (NULL: idle)
+	size_t          size;
+	bool            stop;
+	uint32_t        crc;
+} BlobHasher;
+
+static void* blob_hasher_main(void* arg) {
+	BlobHasher* h = (BlobHasher*)arg;
+	pthread_mutex_lock(&h->mu);
+	for (;;) {
+		while (!h->stop && !h->data) pthread_cond_wait(&h->cv, &h->mu);
+		if (h->stop) break;
+		const void* data = h->data; size_t size = h->size;
+		pthread_mutex_unlock(&h->mu);
+		uint32_t crc = crc32c_update(h->crc, (const uint8_t*)data, size);
+		pthread_mutex_lock(&h->mu);
+		h->crc  = crc;
+		h->data = NULL;
+		pthread_cond_broadcast(&h->cv);
+	}
+	pthread_mutex_unlock(&h->mu);
+	return NULL;
+}
+
+static void blob_hash_submit(BlobHasher* h, const void* data, size_t size) {
+	pthread_mutex_lock(&h->mu);
+	h->data = data; h->size = size;
+	pthread_cond_broadcast(&h->cv);
+	pthread_mutex_unlock(&h->mu);
+}
+
+static void blob_hash_wait(BlobHasher* h) {
+	pthread_mutex_lock(&h->mu);
+	while (h->data) pthread_cond_wait(&h->cv, &h->mu);
+	pthread_mutex_unlock(&h->mu);
+}
+
+struct CBLU_BlobW {
+	CBLU_DocW*          doc;
+	char*               key;
+	char*               content_type;
+	CBLBlobWriteStream* stream;
+	BlobHasher*         hasher;    // NULL unless hashing was requested
+	uint64_t            written;
+	bool                failed;
+};
+
+static void blob_hasher_stop(CBLU_BlobW* w) {
+	if (!w->hasher) return;
+	pthread_mutex_lock(&w->hasher->mu);
+	w->hasher->stop = true;
+	pthread_cond_broadcast(&w->hasher->cv);
+	pthread_mutex_unlock(&w->hasher->mu);
+	pthread_join(w->hasher->thread, NULL);
+	pthread_cond_destroy(&w->hasher->cv);
+	pthread_mutex_destroy(&w->hasher->mu);
+	cblu__free(w->hasher);
+	w->hasher = NULL;
+}
+
+static void blob_writer_free(CBLU_BlobW* w) {
+	blob_hasher_stop(w);
+	if (w->stream) CBLBlobWriter_Close(w->stream);
+	cblu__free(w->key);
+	cblu__free(w->content_type);
+	cblu__free(w);
+}
+
+CBLU_BlobW* cblu_docw_blob_begin(CBLU_DocW* d, const char* key, const char* content_type, bool crc32c) {
+	if (!d || !key) return NULL;
+	CBLU_BlobW* w = (CBLU_BlobW*)cblu__calloc(CBLU_MEM_BLOB, 1, sizeof *w);
+	if (!w) return NULL;
+	w->doc          = d;
+	w->key          = cblu__strdup(CBLU_MEM_BLOB, key);
+	w->content_type = cblu__strdup(CBLU_MEM_BLOB, content_type ? content_type : "application/octet-stream");
+	if (!w->key || !w->content_type) { blob_writer_free(w); return NULL; }
+
+	CBLError err = {0};
+	w->stream = CBLBlobWriter_Create(d->core.db, &err);
+	if (!w->stream) {
+		cblu__cbl_error("blob writer create", err);
+		blob_writer_free(w);
+		return NULL;
+	}
+	if (crc32c) {
+		w->hasher = (BlobHasher*)cblu__calloc(CBLU_MEM_BLOB, 1, sizeof *w->hasher);
+		if (!w->hasher) { blob_writer_free(w); return NULL; }
+		pthread_mutex_init(&w->hasher->mu, NULL);
+		pthread_cond_init(&w->hasher->cv, NULL);
+		if (pthread_create(&w->hasher->thread, NULL, blob_hasher_main, w->hasher) != 0) {
+			pthread_cond_destroy(&w->hasher->cv);
+			pthread_mutex_destroy(&w->hasher->mu);
+			cblu__free(w->hasher); w->hasher = NULL;
+			blob_writer_free(w);
+			return NULL;
+		}
+	}
+	return w;
+}
+
+// Writes one chunk to the stream while the hasher (if any) digests the same bytes
+static bool blob_write_chunk(CBLU_BlobW* w, const void* data, size_t n) {
+	if (n == 0) return true;
+	if (w->hasher) blob_hash_submit(w->hasher, data, n);
+	CBLError err = {0};
+	CBLU_TRACE1(blob_write_entry, n);
+	uint64_t t0 = cblu__now_ns();
+	bool ok = CBLBlobWriter_Write(w->stream, data, n, &err);
+	if (w->hasher) blob_hash_wait(w->hasher);  // caller may reuse data after we return
+	cblu__stats_record(CBLU_OP_BLOB_WRITE, t0, ok);
+	CBLU_TRACE3(blob_write_return, n, (int)ok, (int)err.code);
+	if (!ok) {
+		cblu__cbl_error("blob write", err);
+		w->failed = true;
+		return false;
+	}
+	w->written += n;
+	return true;
+}
+
+bool cblu_blobw_write(CBLU_BlobW* w, const void* data, size_t n) {
+	if (!w || w->failed || (!data && n > 0)) return false;
+	return blob_write_chunk(w, data, n);
+}
+
+bool cblu_blobw_write_fd(CBLU_BlobW* w, int fd, uint64_t max_bytes) {
+	if (!w || w->failed || fd < 0) return false;
+	void* buf = blob_buf();
+	if (!buf) return false;
+	uint64_t left = max_bytes ? max_bytes : UINT64_MAX;
+	while (left > 0) {
+		size_t want = left < CBLU_BLOB_CHUNK ? (size_t)left : CBLU_BLOB_CHUNK;
+		ssize_t r = read(fd, buf, want);
+		if (r < 0) {
+			if (errno == EINTR) continue;
+			cblu__posix_error("blob fd read", errno);
+			w->failed = true;
+			return false;
+		}
+		if (r == 0) break;
+		if (!blob_write_chunk(w, buf, (size_t)r)) return false;
+		left -= (uint64_t)r;
+	}
+	return true;
+}
+
+uint64_t cblu_blobw_size(CBLU_BlobW* w) {
+	return w ? w->written : 0;
+}
+
+bool cblu_blobw_finish(CBLU_BlobW* w, uint32_t* out_crc32c) {
+	if (!w) return false;
+	if (w->failed) { blob_writer_free(w); return false; }
+	if (out_crc32c) *out_crc32c = w->hasher ? w->hasher->crc : 0;
+	// The blob takes ownership of the stream
+	CBLBlob* blob = CBLBlob_CreateWithStream(fl_from_c(w->content_type), w->stream);
+	w->stream = NULL;
+	bool ok = blob != NULL;
+	if (blob) {
+		FLMutableDict_SetBlob(w->doc->props, fl_from_c(w->key), blob);
+		CBLBlob_Release(blob);
+	}
+	blob_writer_free(w);
+	return ok;
+}
+
+void cblu_blobw_abort(CBLU_BlobW* w) {
+	if (w) blob_writer_free(w);
+}
+
+// ---- Memory-mapped access ----
+// Blob content lives unencrypted in "<db>.cblite2/Attachments/<key>.blob", where <key>
+// is the base64 of the SHA-1 digest with '/' replaced by '_'. Mapping that file
+// read-only gives zero-copy access; the fd can be passed to sendfile().
+
+struct CBLU_BlobMap {
+	int    fd;
+	void*  addr;
+	size_t len;
+};
+
+static bool blob_file_path(const CBLU_Core* core, const CBLBlob* blob, char* buf, size_t n) {
+	FLString digest = CBLBlob_Digest(blob);
+	static const char prefix[] = "sha1-";
+	if (!digest.buf || digest.size <= sizeof prefix - 1 || memcmp(digest.buf, prefix, sizeof prefix - 1) != 0)
+		return false;
+	FLStringResult dir = CBLDatabase_Path(core->db);  // ends with '/'
+	size_t dlen = dir.size, klen = digest.size - (sizeof prefix - 1);
+	bool fits = dlen + sizeof "Attachments/" - 1 + klen + sizeof ".blob" <= n;
+	if (fits) {
+		char* p = buf;
+		memcpy(p, dir.buf, dlen); p += dlen;
+		memcpy(p, "Attachments/", 12); p += 12;
+		const char* k = (const char*)digest.buf + (sizeof prefix - 1);
+		for (size_t i = 0; i < klen; i++) *p++ = (k[i] == '/') ? '_' : k[i];
+		memcpy(p, ".blob", sizeof ".blob");
+	}
+	FLSliceResult_Release(dir);
+	return fits;
+}
+
+CBLU_BlobMap* cblu_docr_blob_map(CBLU_DocR* d, const char* key, const void** out_ptr, size_t* out_len) {
+	if (out_ptr) *out_ptr = NULL;
+	if (out_len) *out_len = 0;
+	if (!d || !key || !out_ptr || !out_len) return NULL;
+	const CBLBlob* blob = fl_get_blob(FLDict_Get(d->props, fl_from_c(key)));
+	if (!blob) return NULL;
+
+	char path[4096];
+	if (!blob_file_path(&d->core, blob, path, sizeof path)) return NULL;
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		cblu__posix_error("blob map open", errno);
+		return NULL;
+	}
+	struct stat st;
+	// A size mismatch means the store isn't plain files (e.g. encrypted); don't guess
+	if (fstat(fd, &st) != 0 || (uint64_t)st.st_size != CBLBlob_Length(blob)) { close(fd); return NULL; }
+
+	CBLU_BlobMap* m = (CBLU_BlobMap*)cblu__calloc(CBLU_MEM_BLOB, 1, sizeof *m);
+	if (!m) { close(fd); return NULL; }
+	m->fd  = fd;
+	m->len = (size_t)st.st_size;
+	if (m->len > 0) {
+		m->addr = mmap(NULL, m->len, PROT_READ, MAP_SHARED, fd, 0);
+		if (m->addr == MAP_FAILED) {
+			cblu__posix_error("blob mmap", errno);
+			close(fd); cblu__free(m);
+			return NULL;
+		}
+	}
+	*out_ptr = m->addr;
+	*out_len = m->len;
+	return m;
+}
+
+int cblu_blobmap_fd(CBLU_BlobMap* m) {
+	return m ? m->fd : -1;
+}
+
+void cblu_blob_unmap(CBLU_BlobMap* m) {
+	if (!m) return;
+	if (m->addr && m->len) munmap(m->addr, m->len);
+	if (m->fd >= 0) close(m->fd);
+	cblu__free(m);
+}
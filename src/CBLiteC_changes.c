@@ -0,0 +1,151 @@
+//
+//  CBLiteC_changes.c
+//
+//  Incremental change enumeration from a persisted sequence checkpoint.
+//  The checkpoint is a single document "cblu.ckpt:<name>" in the internal
+//  collection cblu.changes, so committing it is atomic and never touches the
+//  scanned collection. Scans see committed data only: a checkpoint past a
+//  sequence that a rolled-back transaction gave out would skip the doc that
+//  later reuses it.
+//
+
+#include "CBLiteC_internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define CBLU_CKPT_COLLECTION  "changes"      // in CBLU_SYS_SCOPE
+#define CBLU_CKPT_PREFIX      "cblu.ckpt:"
+
+typedef struct { size_t id, id_len, rev, rev_len, body, body_len; uint64_t seq; } ChangeRef;
+
+struct CBLU_Changes {
+	CBLU_Core   core;       // scanned: a reader when the pool is open, else the primary
+	CBLU_Core   ckpt;       // internal collection holding the checkpoint (retained)
+	bool        scan_lock;  // core is the primary: scan under its writer lock
+	char*       ckpt_id;
+	uint64_t    since;      // persisted checkpoint
+	uint64_t    cursor;     // last sequence scanned
+	uint64_t    returned;   // highest sequence handed to the caller
+	// per-batch storage: strings in 'arena', located by offset until the batch is complete
+	char*       arena;
+	size_t      alen, acap;
+	ChangeRef*  refs;
+	size_t      nrefs, max;
+	bool        oom;
+};
+
+static size_t arena_put(CBLU_Changes* c, const void* data, size_t n) {
+	if (c->alen + n + 1 > c->acap) {
+		size_t cap = c->acap ? c->acap : 64 * 1024;
+		while (cap < c->alen + n + 1) cap *= 2;
+		char* a = (char*)cblu__realloc(CBLU_MEM_CHANGES, c->arena, cap);
+		if (!a) { c->oom = true; return 0; }
+		c->arena = a; c->acap = cap;
+	}
+	size_t off = c->alen;
+	if (n) memcpy(c->arena + off, data, n);
+	c->arena[off + n] = 0;  // NUL-terminate every field for C callers
+	c->alen += n + 1;
+	return off;
+}
+
+static bool changes_row(void* ctx, FLString id, uint64_t seq, FLString rev, FLDict body) {
+	CBLU_Changes* c = (CBLU_Changes*)ctx;
+	c->cursor = seq;
+
+	ChangeRef* r = &c->refs[c->nrefs];
+	FLStringResult js = FLValue_ToJSON((FLValue)body);
+	r->seq      = seq;
+	r->id       = arena_put(c, id.buf, id.size);   r->id_len   = id.size;
+	r->rev      = arena_put(c, rev.buf, rev.size); r->rev_len  = rev.size;
+	r->body     = arena_put(c, js.buf, js.size);   r->body_len = js.size;
+	FLSliceResult_Release(js);
+	if (c->oom) return false;
+	c->nrefs++;
+	return true;
+}
+
+CBLU_Changes* cblu_changes_begin(CBLU_Db* db, const char* checkpoint_name) {
+	if (!db || !checkpoint_name || !*checkpoint_name) return NULL;
+	CBLU_Changes* c = (CBLU_Changes*)cblu__calloc(CBLU_MEM_CHANGES, 1, sizeof *c);
+	if (!c) return NULL;
+	// A reader connection never sees another session's open transaction; the
+	// primary does, so without readers the scan holds the writer lock instead
+	c->scan_lock = db->nreaders == 0;
+	c->core = c->scan_lock ? db->core : db->readers[0];
+	size_t n = strlen(CBLU_CKPT_PREFIX) + strlen(checkpoint_name) + 1;
+	c->ckpt_id = (char*)cblu__malloc(CBLU_MEM_CHANGES, n);
+	if (!c->ckpt_id || !cblu__sys_core(&db->core, CBLU_CKPT_COLLECTION, &c->ckpt)) {
+		cblu__free(c->ckpt_id);
+		cblu__free(c);
+		return NULL;
+	}
+	snprintf(c->ckpt_id, n, "%s%s", CBLU_CKPT_PREFIX, checkpoint_name);
+
+	CBLError err = {0};
+	const CBLDocument* doc = CBLCollection_GetDocument(c->ckpt.coll, fl_from_c(c->ckpt_id), &err);
+	if (doc) {
+		c->since = FLValue_AsUnsigned(FLDict_Get(CBLDocument_Properties(doc), FLSTR("seq")));
+		CBLDocument_Release(doc);
+	}
+	c->cursor = c->returned = c->since;
+	return c;
+}
+
+uint64_t cblu_changes_since(CBLU_Changes* c) {
+	return c ? c->since : 0;
+}
+
+size_t cblu_changes_next(CBLU_Changes* c, CBLU_Change* out, size_t max) {
+	if (!c || !out || max == 0) return 0;
+	if (max > c->max) {
+		ChangeRef* r = (ChangeRef*)cblu__realloc(CBLU_MEM_CHANGES, c->refs, max * sizeof *r);
+		if (!r) return 0;
+		c->refs = r; c->max = max;
+	}
+	c->alen = 0;
+	c->nrefs = 0;
+	c->oom = false;
+	if (c->scan_lock) cblu__write_lock(&c->core);
+	cblu__seq_scan(&c->core, c->cursor, 0, max, changes_row, c);
+	if (c->scan_lock) cblu__write_unlock(&c->core);
+	if (c->oom) {
+		cblu__wrapper_error("changes", CBLU_ERR_NOMEM);  // batch truncated
+		if (c->nrefs) c->cursor = c->refs[c->nrefs - 1].seq;
+		else c->cursor = c->returned;
+	}
+
+	for (size_t i = 0; i < c->nrefs; i++) {
+		const ChangeRef* r = &c->refs[i];
+		out[i] = (CBLU_Change){
+			.doc_id = c->arena + r->id,   .doc_id_len = r->id_len,
+			.rev_id = c->arena + r->rev,  .rev_id_len = r->rev_len,
+			.body   = c->arena + r->body, .body_len   = r->body_len,
+			.seq    = r->seq,
+		};
+	}
+	if (c->nrefs) c->returned = c->refs[c->nrefs - 1].seq;
+	return c->nrefs;
+}
+
+bool cblu_changes_commit(CBLU_Changes* c) {
+	if (!c) return false;
+	if (c->returned == c->since) return true;
+	CBLDocument* doc = CBLDocument_CreateWithID(fl_from_c(c->ckpt_id));
+	FLMutableDict_SetUInt(CBLDocument_MutableProperties(doc), FLSTR("seq"), c->returned);
+	CBLError err = {0};
+	bool ok = cblu__save_doc(&c->ckpt, doc, &err);
+	CBLDocument_Release(doc);
+	if (!ok) cblu__cbl_error("checkpoint save", err);
+	else c->since = c->returned;
+	return ok;
+}
+
+void cblu_changes_end(CBLU_Changes* c) {
+	if (!c) return;
+	CBLCollection_Release(c->ckpt.coll);
+	cblu__free(c->refs);
+	cblu__free(c->arena);
+	cblu__free(c->ckpt_id);
+	cblu__free(c);
+}
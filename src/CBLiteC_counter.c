@@ -0,0 +1,340 @@
+//
+//  CBLiteC_counter.c
+//
+//  Sharded counters: writers bump per-thread cells in memory, a flush folds
+//  the cells into their documents in one transaction.
+//
+
+#include "CBLiteC_internal.h"
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include <errno.h>
+
+#define CBLU_COUNTER_SHARDS   16      // power of two
+#define CBLU_COUNTER_SLOTS    256     // initial index slots, power of two (grows x2)
+#define CBLU_COUNTER_RETRIES  8       // conflict retries per document on fold
+
+// One cache line per cell so threads on different shards never share a line
+typedef struct {
+	_Atomic int64_t v;
+	char pad[64 - sizeof(int64_t)];
+} CounterCell;
+
+typedef struct CounterEntry {
+	uint64_t    hash;
+	char*       doc_id;
+	char*       key;
+	CounterCell cells[CBLU_COUNTER_SHARDS];
+} CounterEntry;
+
+// Open-addressed index of entry pointers. Slots only ever go from NULL to an
+// entry, and a grow publishes a fresh copy, so adds probe it without a lock.
+// Superseded tables stay allocated (chained through `older`) until close,
+// since a lock-free reader may still be probing one.
+typedef struct CounterTable {
+	struct CounterTable*   older;
+	size_t                 nslots;
+	_Atomic(CounterEntry*) slots[];
+} CounterTable;
+
+struct CBLU_Counters {
+	CBLU_Core              core;
+	pthread_rwlock_t       lock;     // inserts/grow take it for write, folds for read
+	_Atomic(CounterTable*) table;
+	size_t                 count;
+	pthread_mutex_t  fold_mu;    // serializes folds and exact reads
+	// background folding
+	pthread_t        thread;
+	pthread_mutex_t  wake_mu;
+	pthread_cond_t   wake_cv;
+	uint32_t         flush_ms;
+	bool             has_thread;
+	bool             stop;
+};
+
+static _Atomic unsigned g_next_shard = 0;
+static _Thread_local unsigned tl_shard = UINT32_MAX;
+
+static inline unsigned counter_shard(void) {
+	if (tl_shard == UINT32_MAX)
+		tl_shard = atomic_fetch_add_explicit(&g_next_shard, 1, memory_order_relaxed) & (CBLU_COUNTER_SHARDS - 1);
+	return tl_shard;
+}
+
+// FNV-1a over "doc_id\0key"
+static uint64_t counter_hash(const char* doc_id, const char* key) {
+	uint64_t h = 1469598103934665603ULL;
+	for (const char* p = doc_id; *p; p++) { h ^= (uint8_t)*p; h *= 1099511628211ULL; }
+	h ^= 0; h *= 1099511628211ULL;
+	for (const char* p = key; *p; p++)    { h ^= (uint8_t)*p; h *= 1099511628211ULL; }
+	return h;
+}
+
+static CounterTable* counter_table_new(size_t nslots) {
+	CounterTable* t = (CounterTable*)cblu__calloc(CBLU_MEM_COUNTERS, 1, sizeof *t + nslots * sizeof t->slots[0]);
+	if (t) t->nslots = nslots;
+	return t;
+}
+
+// Lock-free; safe against a concurrent insert or grow
+static CounterEntry* counter_find(const CBLU_Counters* c, uint64_t h, const char* doc_id, const char* key) {
+	CounterTable* t = atomic_load_explicit(&c->table, memory_order_acquire);
+	size_t mask = t->nslots - 1;
+	for (size_t i = h & mask;; i = (i + 1) & mask) {
+		CounterEntry* e = atomic_load_explicit(&t->slots[i], memory_order_acquire);
+		if (!e) return NULL;
+		if (e->hash == h && strcmp(e->doc_id, doc_id) == 0 && strcmp(e->key, key) == 0) return e;
+	}
+}
+
+// Caller holds the write lock and has checked there is a free slot
+static void counter_place(CounterTable* t, CounterEntry* e) {
+	size_t mask = t->nslots - 1;
+	size_t i = e->hash & mask;
+	while (atomic_load_explicit(&t->slots[i], memory_order_relaxed)) i = (i + 1) & mask;
+	atomic_store_explicit(&t->slots[i], e, memory_order_release);
+}
+
+// Keeps the load factor at or under 3/4. Returns false only when the table is
+// full and a bigger one could not be allocated.
+static bool counter_reserve(CBLU_Counters* c) {
+	CounterTable* t = atomic_load_explicit(&c->table, memory_order_relaxed);
+	if ((c->count + 1) * 4 <= t->nslots * 3) return true;
+	CounterTable* n = counter_table_new(t->nslots * 2);
+	if (!n) return c->count + 1 < t->nslots; // keep the old table; probes just get longer
+	for (size_t i = 0; i < t->nslots; i++) {
+		CounterEntry* e = atomic_load_explicit(&t->slots[i], memory_order_relaxed);
+		if (e) counter_place(n, e);
+	}
+	n->older = t;
+	atomic_store_explicit(&c->table, n, memory_order_release);
+	return true;
+}
+
+static int64_t counter_pending(const CounterEntry* e) {
+	int64_t sum = 0;
+	for (unsigned i = 0; i < CBLU_COUNTER_SHARDS; i++)
+		sum += atomic_load_explicit(&e->cells[i].v, memory_order_relaxed);
+	return sum;
+}
+
+// ---- Folding ----
+typedef struct { CounterEntry* e; int64_t delta; } FoldItem;
+
+static int fold_item_cmp(const void* a, const void* b) {
+	return strcmp(((const FoldItem*)a)->e->doc_id, ((const FoldItem*)b)->e->doc_id);
+}
+
+// Adds every item in [items, items+n) (all sharing one doc_id) into that document
+static bool fold_doc(CBLU_Counters* c, FoldItem* items, size_t n) {
+	CBLError err = {0};
+	for (int attempt = 0; attempt < CBLU_COUNTER_RETRIES; attempt++) {
+		FLString id = fl_from_c(items[0].e->doc_id);
+		CBLDocument* doc = CBLCollection_GetMutableDocument(c->core.coll, id, &err);
+		if (!doc) {
+			if (err.code != 0 && !(err.domain == kCBLDomain && err.code == kCBLErrorNotFound)) break;
+			doc = CBLDocument_CreateWithID(id);
+		}
+		FLMutableDict props = CBLDocument_MutableProperties(doc);
+		for (size_t i = 0; i < n; i++) {
+			FLString k = fl_from_c(items[i].e->key);
+			FLValue cur = FLDict_Get((FLDict)props, k);
+			int64_t base = fl_is_number(cur) ? (int64_t)FLValue_AsInt(cur) : 0;
+			FLMutableDict_SetInt(props, k, base + items[i].delta);
+		}
+		err = (CBLError){0};
+		bool ok = CBLCollection_SaveDocumentWithConcurrencyControl(c->core.coll, doc,
+			kCBLConcurrencyControlFailOnConflict, &err);
+		CBLDocument_Release(doc);
+		if (ok) return true;
+		if (!(err.domain == kCBLDomain && err.code == kCBLErrorConflict)) break;
+	}
+	cblu__error("counter fold", (int)err.domain, (int)err.code, fl_from_c(items[0].e->doc_id));
+	return false;
+}
+
+// Puts deltas that could not be persisted back into the shards
+static void fold_restore(FoldItem* items, size_t n) {
+	for (size_t i = 0; i < n; i++)
+		atomic_fetch_add_explicit(&items[i].e->cells[0].v, items[i].delta, memory_order_relaxed);
+}
+
+bool cblu_counters_flush(CBLU_Counters* c) {
+	if (!c) return false;
+	pthread_mutex_lock(&c->fold_mu);
+
+	// Entries are never removed while the counter set is open, so the pointers
+	// collected under the read lock stay valid after it is released.
+	pthread_rwlock_rdlock(&c->lock);
+	FoldItem* items = c->count ? (FoldItem*)cblu__malloc(CBLU_MEM_COUNTERS, c->count * sizeof *items) : NULL;
+	size_t n = 0;
+	if (items) {
+		CounterTable* t = atomic_load_explicit(&c->table, memory_order_relaxed);
+		for (size_t s = 0; s < t->nslots; s++) {
+			CounterEntry* e = atomic_load_explicit(&t->slots[s], memory_order_relaxed);
+			if (e) {
+				int64_t delta = 0;
+				for (unsigned i = 0; i < CBLU_COUNTER_SHARDS; i++)
+					delta += atomic_exchange_explicit(&e->cells[i].v, 0, memory_order_relaxed);
+				if (delta != 0) items[n++] = (FoldItem){ e, delta };
+			}
+		}
+	}
+	bool oom = (c->count && !items);
+	pthread_rwlock_unlock(&c->lock);
+
+	if (oom) { pthread_mutex_unlock(&c->fold_mu); return false; }
+	if (n == 0) { cblu__free(items); pthread_mutex_unlock(&c->fold_mu); return true; }
+
+	qsort(items, n, sizeof *items, fold_item_cmp);
+
+	CBLError err = {0};
+	bool ok = cblu__begin_txn(&c->core, &err);
+	if (!ok) {
+		cblu__cbl_error("counter begin txn", err);
+		fold_restore(items, n);
+		cblu__free(items);
+		pthread_mutex_unlock(&c->fold_mu);
+		return false;
+	}
+
+	for (size_t i = 0; i < n && ok; ) {
+		size_t j = i + 1;
+		while (j < n && strcmp(items[j].e->doc_id, items[i].e->doc_id) == 0) j++;
+		ok = fold_doc(c, items + i, j - i);
+		i = j;
+	}
+
+	err = (CBLError){0};
+	if (!cblu__end_txn(&c->core, ok, &err)) {
+		cblu__cbl_error("counter end txn", err);
+		ok = false;
+	}
+	if (!ok) fold_restore(items, n);
+
+	cblu__free(items);
+	pthread_mutex_unlock(&c->fold_mu);
+	return ok;
+}
+
+static void* counter_thread(void* arg) {
+	CBLU_Counters* c = (CBLU_Counters*)arg;
+	pthread_mutex_lock(&c->wake_mu);
+	while (!c->stop) {
+		struct timespec ts;
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_sec  += c->flush_ms / 1000;
+		ts.tv_nsec += (long)(c->flush_ms % 1000) * 1000000L;
+		if (ts.tv_nsec >= 1000000000L) { ts.tv_sec++; ts.tv_nsec -= 1000000000L; }
+		int rc = 0;
+		while (!c->stop && rc != ETIMEDOUT) rc = pthread_cond_timedwait(&c->wake_cv, &c->wake_mu, &ts);
+		if (c->stop) break;
+		pthread_mutex_unlock(&c->wake_mu);
+		cblu_counters_flush(c);
+		pthread_mutex_lock(&c->wake_mu);
+	}
+	pthread_mutex_unlock(&c->wake_mu);
+	return NULL;
+}
+
+// ---- Public API ----
+CBLU_Counters* cblu_counters_open(CBLU_Db* db, uint32_t flush_ms) {
+	if (!db) return NULL;
+	CBLU_Counters* c = (CBLU_Counters*)cblu__calloc(CBLU_MEM_COUNTERS, 1, sizeof *c);
+	if (!c) return NULL;
+	c->core = db->core;
+	CounterTable* t = counter_table_new(CBLU_COUNTER_SLOTS);
+	if (!t) { cblu__free(c); return NULL; }
+	atomic_init(&c->table, t);
+	pthread_rwlock_init(&c->lock, NULL);
+	pthread_mutex_init(&c->fold_mu, NULL);
+	pthread_mutex_init(&c->wake_mu, NULL);
+	pthread_cond_init(&c->wake_cv, NULL);
+	c->flush_ms = flush_ms;
+	if (flush_ms > 0) {
+		if (pthread_create(&c->thread, NULL, counter_thread, c) == 0) c->has_thread = true;
+		else cblu__wrapper_error("counter flush thread", CBLU_ERR_THREAD);  // folding on demand only
+	}
+	return c;
+}
+
+bool cblu_counter_add(CBLU_Counters* c, const char* doc_id, const char* key, int64_t delta) {
+	if (!c || !doc_id || !key) return false;
+	uint64_t h = counter_hash(doc_id, key);
+	unsigned shard = counter_shard();
+
+	// Hot path: no lock, entries live until close
+	CounterEntry* e = counter_find(c, h, doc_id, key);
+	if (e) { atomic_fetch_add_explicit(&e->cells[shard].v, delta, memory_order_relaxed); return true; }
+
+	// First touch of this counter: insert under the write lock
+	pthread_rwlock_wrlock(&c->lock);
+	e = counter_find(c, h, doc_id, key);
+	if (!e) {
+		e = (CounterEntry*)cblu__calloc(CBLU_MEM_COUNTERS, 1, sizeof *e);
+		if (e) { e->doc_id = cblu__strdup(CBLU_MEM_COUNTERS, doc_id); e->key = cblu__strdup(CBLU_MEM_COUNTERS, key); }
+		if (!e || !e->doc_id || !e->key || !counter_reserve(c)) {
+			if (e) { cblu__free(e->doc_id); cblu__free(e->key); cblu__free(e); }
+			pthread_rwlock_unlock(&c->lock);
+			return false;
+		}
+		e->hash = h;
+		// The delta lands before the entry is published; a fold can't see it earlier
+		atomic_store_explicit(&e->cells[shard].v, delta, memory_order_relaxed);
+		counter_place(atomic_load_explicit(&c->table, memory_order_relaxed), e);
+		c->count++;
+		pthread_rwlock_unlock(&c->lock);
+		return true;
+	}
+	atomic_fetch_add_explicit(&e->cells[shard].v, delta, memory_order_relaxed);
+	pthread_rwlock_unlock(&c->lock);
+	return true;
+}
+
+bool cblu_counter_get(CBLU_Counters* c, const char* doc_id, const char* key, int64_t* out) {
+	if (!c || !doc_id || !key || !out) return false;
+	// Holding fold_mu means no delta is "in flight" between the shards and the document
+	pthread_mutex_lock(&c->fold_mu);
+	bool found = false;
+	int64_t sum = 0;
+
+	CBLError err = {0};
+	const CBLDocument* doc = CBLCollection_GetDocument(c->core.coll, fl_from_c(doc_id), &err);
+	if (doc) {
+		FLValue v = FLDict_Get(CBLDocument_Properties(doc), fl_from_c(key));
+		if (fl_is_number(v)) { sum = (int64_t)FLValue_AsInt(v); found = true; }
+		CBLDocument_Release(doc);
+	}
+
+	CounterEntry* e = counter_find(c, counter_hash(doc_id, key), doc_id, key);
+	if (e) { sum += counter_pending(e); found = true; }
+
+	pthread_mutex_unlock(&c->fold_mu);
+	if (found) *out = sum;
+	return found;
+}
+
+void cblu_counters_close(CBLU_Counters* c) {
+	if (!c) return;
+	if (c->has_thread) {
+		pthread_mutex_lock(&c->wake_mu);
+		c->stop = true;
+		pthread_cond_signal(&c->wake_cv);
+		pthread_mutex_unlock(&c->wake_mu);
+		pthread_join(c->thread, NULL);
+	}
+	cblu_counters_flush(c);
+	CounterTable* t = atomic_load_explicit(&c->table, memory_order_relaxed);
+	for (size_t s = 0; s < t->nslots; s++) {
+		CounterEntry* e = atomic_load_explicit(&t->slots[s], memory_order_relaxed);
+		if (e) { cblu__free(e->doc_id); cblu__free(e->key); cblu__free(e); }
+	}
+	while (t) { CounterTable* older = t->older; cblu__free(t); t = older; }
+	pthread_cond_destroy(&c->wake_cv);
+	pthread_mutex_destroy(&c->wake_mu);
+	pthread_mutex_destroy(&c->fold_mu);
+	pthread_rwlock_destroy(&c->lock);
+	cblu__free(c);
+}
@@ -0,0 +1,175 @@
+//
+//  CBLiteC_error.c
+//
+//  Structured error records. Every failure is written to a fixed-size ring
+//  (multi-producer: a sequence number comes from one fetch_add, and the slot is
+//  then claimed by CAS on its version, so a writer a lap behind can never
+//  overwrite a newer record and readers detect torn or overwritten ones) and to
+//  the calling thread's last-error slot. Logging is optional and rate-limited,
+//  so a failure storm never funnels every thread through the stdio lock.
+//
+
+#include "CBLiteC_internal.h"
+#include <stdatomic.h>
+#include <sched.h>
+#include <stdio.h>
+#include <time.h>
+
+#define CBLU_ERROR_RING      1024u   // power of two
+#define CBLU_ERROR_LOG_RATE  10      // default log lines per second
+
+typedef struct {
+	_Atomic uint64_t    ver;   // 2*seq+1 while writing, 2*seq+2 when complete
+	_Atomic uint64_t    time_ns, doc_hash;
+	_Atomic int32_t     domain, code;
+	_Atomic(const char*) api;
+} ErrorSlot;
+
+static ErrorSlot        g_ring[CBLU_ERROR_RING];
+static _Atomic uint64_t g_head;   // records ever written
+
+static _Atomic(CBLU_ErrorLogFn) g_log_fn;
+static void* _Atomic            g_log_ctx;
+static _Atomic uint32_t         g_log_rate = CBLU_ERROR_LOG_RATE;
+static _Atomic uint64_t         g_log_window;      // current second
+static _Atomic uint32_t         g_log_count;       // lines logged in it
+static _Atomic uint64_t         g_log_suppressed;  // dropped since the last line
+
+static _Thread_local CBLU_ErrorRec t_last;
+static _Thread_local bool          t_has_last;
+
+static uint64_t doc_hash(FLString doc) {
+	if (!doc.buf || !doc.size) return 0;
+	uint64_t h = 0xCBF29CE484222325ull;  // FNV-1a
+	const uint8_t* p = (const uint8_t*)doc.buf;
+	for (size_t i = 0; i < doc.size; i++) { h ^= p[i]; h *= 0x100000001B3ull; }
+	return h;
+}
+
+static void error_log(const CBLU_ErrorRec* e) {
+	uint32_t rate = atomic_load_explicit(&g_log_rate, memory_order_relaxed);
+	if (rate == 0) return;
+	uint64_t sec = e->time_ns / 1000000000ull;
+	uint64_t win = atomic_load_explicit(&g_log_window, memory_order_relaxed);
+	if (sec != win && atomic_compare_exchange_strong(&g_log_window, &win, sec))
+		atomic_store_explicit(&g_log_count, 0, memory_order_relaxed);
+	if (atomic_fetch_add_explicit(&g_log_count, 1, memory_order_relaxed) >= rate) {
+		atomic_fetch_add_explicit(&g_log_suppressed, 1, memory_order_relaxed);
+		return;
+	}
+	uint64_t dropped = atomic_exchange_explicit(&g_log_suppressed, 0, memory_order_relaxed);
+	CBLU_ErrorLogFn fn = atomic_load_explicit(&g_log_fn, memory_order_acquire);
+	if (fn) { fn(atomic_load_explicit(&g_log_ctx, memory_order_relaxed), e, dropped); return; }
+	if (dropped) fprintf(stderr, "CBL %llu error(s) not logged (rate limit)\n", (unsigned long long)dropped);
+	if (e->doc_hash)
+		fprintf(stderr, "CBL %s failed: domain=%d code=%d doc=%016llx\n", e->api, (int)e->domain, (int)e->code, (unsigned long long)e->doc_hash);
+	else
+		fprintf(stderr, "CBL %s failed: domain=%d code=%d\n", e->api, (int)e->domain, (int)e->code);
+}
+
+void cblu__error_in(CBLU_ErrorRec* session_slot, const char* api, int domain, int code, FLString doc) {
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	uint64_t seq = atomic_fetch_add_explicit(&g_head, 1, memory_order_relaxed);
+	CBLU_ErrorRec e = {
+		.seq = seq, .time_ns = (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec,
+		.doc_hash = doc_hash(doc), .domain = domain, .code = code, .api = api,
+	};
+
+	// Claim: wait out an older writer still in the slot (odd ver); give up if a
+	// newer record already claimed it, since readers will count ours as lost anyway.
+	ErrorSlot* s = &g_ring[seq & (CBLU_ERROR_RING - 1)];
+	uint64_t cur = atomic_load_explicit(&s->ver, memory_order_relaxed);
+	bool claimed = false;
+	while (cur < 2 * seq + 1) {
+		if (cur & 1) {
+			sched_yield();
+			cur = atomic_load_explicit(&s->ver, memory_order_relaxed);
+			continue;
+		}
+		if (atomic_compare_exchange_weak_explicit(&s->ver, &cur, 2 * seq + 1,
+												  memory_order_relaxed, memory_order_relaxed)) {
+			claimed = true;
+			break;
+		}
+	}
+	if (claimed) {
+		atomic_thread_fence(memory_order_release);
+		atomic_store_explicit(&s->time_ns,  e.time_ns,  memory_order_relaxed);
+		atomic_store_explicit(&s->doc_hash, e.doc_hash, memory_order_relaxed);
+		atomic_store_explicit(&s->domain,   e.domain,   memory_order_relaxed);
+		atomic_store_explicit(&s->code,     e.code,     memory_order_relaxed);
+		atomic_store_explicit(&s->api,      e.api,      memory_order_relaxed);
+		atomic_store_explicit(&s->ver, 2 * seq + 2, memory_order_release);
+	}
+
+	t_last = e;
+	t_has_last = true;
+	if (session_slot) *session_slot = e;
+	error_log(&e);
+}
+
+void cblu__error(const char* api, int domain, int code, FLString doc) {
+	cblu__error_in(NULL, api, domain, code, doc);
+}
+
+// ---- Public API ----
+size_t cblu_errors_read(uint64_t* cursor, CBLU_ErrorRec* out, size_t max, uint64_t* out_lost) {
+	if (out_lost) *out_lost = 0;
+	if (!cursor || !out || !max) return 0;
+	uint64_t head = atomic_load_explicit(&g_head, memory_order_acquire);
+	uint64_t lost = 0;
+	if (head - *cursor > CBLU_ERROR_RING) {  // overwritten before we got to them
+		lost = head - CBLU_ERROR_RING - *cursor;
+		*cursor = head - CBLU_ERROR_RING;
+	}
+	size_t n = 0;
+	while (n < max && *cursor < head) {
+		uint64_t seq = *cursor;
+		ErrorSlot* s = &g_ring[seq & (CBLU_ERROR_RING - 1)];
+		uint64_t v1 = atomic_load_explicit(&s->ver, memory_order_acquire);
+		if (v1 < 2 * seq + 2) break;  // our writer hasn't finished (or claimed) yet; read it next time
+		CBLU_ErrorRec e = {
+			.seq      = seq,
+			.time_ns  = atomic_load_explicit(&s->time_ns,  memory_order_relaxed),
+			.doc_hash = atomic_load_explicit(&s->doc_hash, memory_order_relaxed),
+			.domain   = atomic_load_explicit(&s->domain,   memory_order_relaxed),
+			.code     = atomic_load_explicit(&s->code,     memory_order_relaxed),
+			.api      = atomic_load_explicit(&s->api,      memory_order_relaxed),
+		};
+		atomic_thread_fence(memory_order_acquire);
+		uint64_t v2 = atomic_load_explicit(&s->ver, memory_order_relaxed);
+		(*cursor)++;
+		// Only the exact record for seq, unchanged across the copy, is accepted
+		if (v1 != 2 * seq + 2 || v2 != v1) { lost++; continue; }  // overwritten by a later lap
+		out[n++] = e;
+	}
+	if (out_lost) *out_lost = lost;
+	return n;
+}
+
+uint64_t cblu_errors_total(void) {
+	return atomic_load_explicit(&g_head, memory_order_relaxed);
+}
+
+void cblu_errors_set_log(CBLU_ErrorLogFn fn, void* ctx, uint32_t max_per_sec) {
+	atomic_store_explicit(&g_log_ctx, ctx, memory_order_relaxed);
+	atomic_store_explicit(&g_log_fn, fn, memory_order_release);
+	atomic_store_explicit(&g_log_rate, max_per_sec, memory_order_relaxed);
+}
+
+CBLU_ErrorRec cblu__last_error(void) {
+	return t_has_last ? t_last : (CBLU_ErrorRec){0};
+}
+
+bool cblu_last_error(CBLU_ErrorRec* out) {
+	if (!out || !t_has_last) return false;
+	*out = t_last;
+	return true;
+}
+
+bool cblu_session_last_error(CBLU_Session* s, CBLU_ErrorRec* out) {
+	if (!s || !out || !s->last_err.api) return false;
+	*out = s->last_err;
+	return true;
+}
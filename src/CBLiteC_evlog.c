@@ -0,0 +1,169 @@
+//
+//  CBLiteC_evlog.c
+//
+//  Append-only event log with snapshot compaction.
+//
+//  Each event is its own small document "cblu.ev:<name>:<seq>", so an append
+//  costs one constant-size save however many events came before it. Every
+//  snapshot_every events the caller's fold state is written to
+//  "cblu.ev:<name>:snap" and the events it covers are purged in the same
+//  transaction, so reopening replays at most snapshot_every events. All of
+//  them live in the internal collection cblu.evlog.
+//
+
+#include "CBLiteC_internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <pthread.h>
+
+#define CBLU_EVLOG_SEQ_KEY     "cblu.seq"  // reserved key in the snapshot document (LiteCore refuses top-level "_" keys)
+#define CBLU_EVLOG_COLLECTION  "evlog"
+#define CBLU_EVLOG_PREFIX      "cblu.ev:"
+
+struct CBLU_EventLog {
+	CBLU_Core       core;
+	char*           name;
+	CBLU_EventFold  fold;
+	uint32_t        snapshot_every;
+	pthread_mutex_t mu;
+	uint64_t        seq;          // last appended
+	uint64_t        snap_seq;     // last folded into the snapshot doc; events up to it are purged
+};
+
+static void event_id(const CBLU_EventLog* l, uint64_t seq, char* buf, size_t n) {
+	snprintf(buf, n, CBLU_EVLOG_PREFIX "%s:%020" PRIu64, l->name, seq);
+}
+
+static void snap_id(const CBLU_EventLog* l, char* buf, size_t n) {
+	snprintf(buf, n, CBLU_EVLOG_PREFIX "%s:snap", l->name);
+}
+
+// Saves the fold state at l->seq and purges the events it covers
+static bool evlog_compact(CBLU_EventLog* l) {
+	char id[256];
+	CBLError err = {0};
+	if (!cblu__begin_txn(&l->core, &err)) {
+		cblu__cbl_error("evlog begin txn", err);
+		return false;
+	}
+
+	snap_id(l, id, sizeof id);
+	CBLU_DocW w = { .core = l->core, .doc = CBLDocument_CreateWithID(fl_from_c(id)) };
+	w.props = CBLDocument_MutableProperties(w.doc);
+	l->fold.save(l->fold.ctx, &w);
+	FLMutableDict_SetUInt(w.props, FLSTR(CBLU_EVLOG_SEQ_KEY), l->seq);
+	bool ok = cblu__save_doc(&l->core, w.doc, &err);
+	CBLDocument_Release(w.doc);
+
+	for (uint64_t seq = l->snap_seq + 1; ok && seq <= l->seq; seq++) {
+		event_id(l, seq, id, sizeof id);
+		ok = CBLCollection_PurgeDocumentByID(l->core.coll, fl_from_c(id), &err);
+		if (!ok && err.domain == kCBLDomain && err.code == kCBLErrorNotFound) { ok = true; err = (CBLError){0}; }
+	}
+	if (!ok) cblu__cbl_error("evlog compact", err);
+
+	CBLError err2 = {0};
+	if (!cblu__end_txn(&l->core, ok, &err2)) {
+		cblu__cbl_error("evlog end txn", err2);
+		ok = false;
+	}
+	if (ok) l->snap_seq = l->seq;
+	return ok;
+}
+
+// ---- Public API ----
+CBLU_EventLog* cblu_evlog_open(CBLU_Db* db, const char* name, uint32_t snapshot_every,
+							   const CBLU_EventFold* fold) {
+	if (!db || !name || !*name || !fold || !fold->apply || !fold->save || !fold->load) return NULL;
+	if (snapshot_every == 0) return NULL;
+	CBLU_EventLog* l = (CBLU_EventLog*)cblu__calloc(CBLU_MEM_EVLOG, 1, sizeof *l);
+	if (!l) return NULL;
+	l->name = cblu__strdup(CBLU_MEM_EVLOG, name);
+	if (!l->name || !cblu__sys_core(&db->core, CBLU_EVLOG_COLLECTION, &l->core)) {
+		cblu__free(l->name); cblu__free(l); return NULL;
+	}
+	l->fold = *fold;
+	l->snapshot_every = snapshot_every;
+	pthread_mutex_init(&l->mu, NULL);
+
+	if (l->fold.reset) l->fold.reset(l->fold.ctx);
+
+	// Snapshot first, then the events after it
+	char id[256];
+	snap_id(l, id, sizeof id);
+	CBLError err = {0};
+	const CBLDocument* snap = CBLCollection_GetDocument(l->core.coll, fl_from_c(id), &err);
+	if (snap) {
+		CBLU_DocR r = { .core = l->core, .doc = snap, .props = CBLDocument_Properties(snap) };
+		l->snap_seq = FLValue_AsUnsigned(FLDict_Get(r.props, FLSTR(CBLU_EVLOG_SEQ_KEY)));
+		bool loaded = l->fold.load(l->fold.ctx, &r);
+		CBLDocument_Release(snap);
+		if (!loaded) {
+			cblu__error("evlog snapshot load", CBLU_ERR_DOMAIN_WRAPPER, CBLU_ERR_REJECTED, fl_from_c(name));
+			pthread_mutex_destroy(&l->mu);
+			CBLCollection_Release(l->core.coll);
+			cblu__free(l->name); cblu__free(l);
+			return NULL;
+		}
+	}
+	for (l->seq = l->snap_seq; ; l->seq++) {
+		event_id(l, l->seq + 1, id, sizeof id);
+		const CBLDocument* doc = CBLCollection_GetDocument(l->core.coll, fl_from_c(id), &err);
+		if (!doc) break;
+		FLSlice ev = FLValue_AsData(FLDict_Get(CBLDocument_Properties(doc), FLSTR("ev")));
+		l->fold.apply(l->fold.ctx, l->seq + 1, ev.buf, ev.size);
+		CBLDocument_Release(doc);
+	}
+	return l;
+}
+
+bool cblu_evlog_append(CBLU_EventLog* l, const void* ev, size_t size, uint64_t* out_seq) {
+	if (!l || (!ev && size > 0)) return false;
+	pthread_mutex_lock(&l->mu);
+	uint64_t seq = l->seq + 1;
+	char id[256];
+	event_id(l, seq, id, sizeof id);
+	CBLDocument* doc = CBLDocument_CreateWithID(fl_from_c(id));
+	FLMutableDict_SetData(CBLDocument_MutableProperties(doc), FLSTR("ev"), (FLSlice){ .buf = ev, .size = size });
+	CBLError err = {0};
+	bool ok = cblu__save_doc(&l->core, doc, &err);
+	CBLDocument_Release(doc);
+	if (!ok) {
+		cblu__cbl_error("evlog append", err);
+		pthread_mutex_unlock(&l->mu);
+		return false;
+	}
+
+	l->seq = seq;
+	l->fold.apply(l->fold.ctx, seq, ev, size);
+	// A failed compaction is retried on the next append; the log stays complete meanwhile
+	if (seq - l->snap_seq >= l->snapshot_every) evlog_compact(l);
+	if (out_seq) *out_seq = seq;
+	pthread_mutex_unlock(&l->mu);
+	return true;
+}
+
+bool cblu_evlog_snapshot(CBLU_EventLog* l) {
+	if (!l) return false;
+	pthread_mutex_lock(&l->mu);
+	bool ok = (l->seq == l->snap_seq) || evlog_compact(l);
+	pthread_mutex_unlock(&l->mu);
+	return ok;
+}
+
+uint64_t cblu_evlog_seq(CBLU_EventLog* l) {
+	if (!l) return 0;
+	pthread_mutex_lock(&l->mu);
+	uint64_t seq = l->seq;
+	pthread_mutex_unlock(&l->mu);
+	return seq;
+}
+
+void cblu_evlog_close(CBLU_EventLog* l) {
+	if (!l) return;
+	pthread_mutex_destroy(&l->mu);
+	CBLCollection_Release(l->core.coll);
+	cblu__free(l->name);
+	cblu__free(l);
+}
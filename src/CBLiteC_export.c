@@ -0,0 +1,201 @@
+//
+//  CBLiteC_export.c
+//
+//  Collection export in sequence order, as NDJSON or length-prefixed Fleece.
+//
+//  NDJSON lines are the document body with "_id" added first, which is what
+//  cblu_import_ndjson_* reads back by default. The binary format is
+//
+//      "CBLUFLX1"  then per document:
+//      u32 id_len | id | u64 sequence | u32 body_len | Fleece-encoded body
+//
+//  (integers little-endian). With parts > 1 the sequence range is split and
+//  each part is written by its own thread to "<path>.<i>".
+//
+
+#include "CBLiteC_internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CBLU_EXPORT_BUF        (1u << 20)
+#define CBLU_EXPORT_MAX_PARTS  64
+#define CBLU_EXPORT_MAGIC      "CBLUFLX1"
+
+typedef struct {
+	const CBLU_Core*  core;
+	CBLU_ExportFormat format;
+	uint64_t          after, upto;
+	char              path[4096];
+	int               fd;
+	char*             buf;
+	size_t            len;
+	FLEncoder         enc;
+	uint64_t          docs, bytes;
+	bool              ok;
+} ExportPart;
+
+static bool part_flush(ExportPart* p) {
+	size_t off = 0;
+	while (off < p->len) {
+		ssize_t w = write(p->fd, p->buf + off, p->len - off);
+		if (w < 0 && errno == EINTR) continue;
+		if (w < 0) { cblu__posix_error("export write", errno); p->ok = false; return false; }
+		off += (size_t)w;
+	}
+	p->bytes += p->len;
+	p->len = 0;
+	return true;
+}
+
+static bool part_put(ExportPart* p, const void* data, size_t n) {
+	if (!p->ok) return false;
+	if (p->len + n > CBLU_EXPORT_BUF) {
+		if (!part_flush(p)) return false;
+		if (n > CBLU_EXPORT_BUF) {  // oversized record: write through
+			size_t len = p->len; char* buf = p->buf;
+			p->buf = (char*)data; p->len = n;
+			bool ok = part_flush(p);
+			p->buf = buf; p->len = len;
+			return ok;
+		}
+	}
+	memcpy(p->buf + p->len, data, n);
+	p->len += n;
+	return true;
+}
+
+static bool part_put_u32(ExportPart* p, uint32_t v) {
+	uint8_t b[4] = { (uint8_t)v, (uint8_t)(v >> 8), (uint8_t)(v >> 16), (uint8_t)(v >> 24) };
+	return part_put(p, b, sizeof b);
+}
+
+static bool part_put_u64(ExportPart* p, uint64_t v) {
+	uint8_t b[8];
+	for (int i = 0; i < 8; i++) b[i] = (uint8_t)(v >> (8 * i));
+	return part_put(p, b, sizeof b);
+}
+
+// JSON string literal for id
+static bool part_put_json_string(ExportPart* p, FLString s) {
+	static const char hex[] = "0123456789abcdef";
+	const uint8_t* c = (const uint8_t*)s.buf;
+	size_t run = 0;
+	part_put(p, "\"", 1);
+	for (size_t i = 0; i < s.size; i++) {
+		if (c[i] >= 0x20 && c[i] != '"' && c[i] != '\\') { run++; continue; }
+		part_put(p, c + i - run, run);
+		run = 0;
+		char esc[6] = { '\\', (char)c[i], 0 };
+		if (c[i] < 0x20) { esc[1] = 'u'; esc[2] = '0'; esc[3] = '0'; esc[4] = hex[c[i] >> 4]; esc[5] = hex[c[i] & 15]; part_put(p, esc, 6); }
+		else part_put(p, esc, 2);
+	}
+	part_put(p, c + s.size - run, run);
+	return part_put(p, "\"", 1);
+}
+
+static bool export_row(void* ctx, FLString id, uint64_t seq, FLString rev, FLDict body) {
+	(void)rev;
+	ExportPart* p = (ExportPart*)ctx;
+	if (p->format == CBLU_EXPORT_FLEECE) {
+		FLEncoder_Reset(p->enc);
+		FLEncoder_WriteValue(p->enc, (FLValue)body);
+		FLError ferr = kFLNoError;
+		FLSliceResult fl = FLEncoder_Finish(p->enc, &ferr);
+		if (!fl.buf) { p->ok = false; return false; }
+		part_put_u32(p, (uint32_t)id.size);
+		part_put(p, id.buf, id.size);
+		part_put_u64(p, seq);
+		part_put_u32(p, (uint32_t)fl.size);
+		part_put(p, fl.buf, fl.size);
+		FLSliceResult_Release(fl);
+	} else {
+		FLStringResult js = FLValue_ToJSON((FLValue)body);  // "{...}"
+		part_put(p, "{\"_id\":", 7);
+		part_put_json_string(p, id);
+		if (js.size > 2) { part_put(p, ",", 1); part_put(p, (const char*)js.buf + 1, js.size - 1); }
+		else part_put(p, "}", 1);
+		part_put(p, "\n", 1);
+		FLSliceResult_Release(js);
+	}
+	if (p->ok) p->docs++;
+	return p->ok;
+}
+
+static void* export_part_run(void* arg) {
+	ExportPart* p = (ExportPart*)arg;
+	p->fd = open(p->path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (p->fd < 0) {
+		cblu__posix_error("export open", errno);
+		p->ok = false;
+		return NULL;
+	}
+	p->buf = (char*)cblu__malloc(CBLU_MEM_IO, CBLU_EXPORT_BUF);
+	p->enc = (p->format == CBLU_EXPORT_FLEECE) ? FLEncoder_New() : NULL;
+	if (!p->buf || (p->format == CBLU_EXPORT_FLEECE && !p->enc)) p->ok = false;
+	if (p->ok && p->format == CBLU_EXPORT_FLEECE) part_put(p, CBLU_EXPORT_MAGIC, 8);
+	if (p->ok && !cblu__seq_scan(p->core, p->after, p->upto, 0, export_row, p)) p->ok = false;
+	if (p->ok) part_flush(p);
+	if (p->ok && fsync(p->fd) != 0) p->ok = false;
+	close(p->fd);
+	if (p->enc) FLEncoder_Free(p->enc);
+	cblu__free(p->buf);
+	return NULL;
+}
+
+bool cblu_export(CBLU_Db* db, const char* path, const CBLU_ExportOptions* opt, CBLU_ExportStats* out) {
+	if (out) memset(out, 0, sizeof *out);
+	if (!db || !path) return false;
+	CBLU_ExportOptions o = {0};
+	if (opt) o = *opt;
+	unsigned parts = o.parts ? o.parts : 1;
+	if (parts > CBLU_EXPORT_MAX_PARTS) parts = CBLU_EXPORT_MAX_PARTS;
+
+	struct timespec t0, t1;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+
+	ExportPart* ps = (ExportPart*)cblu__calloc(CBLU_MEM_IO, parts, sizeof *ps);
+	pthread_t*  th = (pthread_t*)cblu__calloc(CBLU_MEM_IO, parts, sizeof *th);
+	bool*  started = (bool*)cblu__calloc(CBLU_MEM_IO, parts, sizeof *started);
+	if (!ps || !th || !started) { cblu__free(ps); cblu__free(th); cblu__free(started); return false; }
+
+	// Split (after, max] into equal sequence ranges; the last part is open-ended
+	uint64_t max  = parts > 1 ? cblu__max_seq(&db->core) : 0;
+	uint64_t span = (max > o.after_seq) ? (max - o.after_seq + parts - 1) / parts : 0;
+	if (span == 0) parts = 1;  // nothing to split
+	for (unsigned i = 0; i < parts; i++) {
+		ExportPart* p = &ps[i];
+		// Spread parts over the reader pool when there is one, so queries run in parallel
+		p->core   = db->nreaders ? &db->readers[i % db->nreaders] : &db->core;
+		p->format = o.format;
+		p->after  = o.after_seq + span * i;
+		p->upto   = (i + 1 < parts) ? o.after_seq + span * (i + 1) : 0;
+		p->ok     = true;
+		if (o.parts > 1) snprintf(p->path, sizeof p->path, "%s.%u", path, i);
+		else           snprintf(p->path, sizeof p->path, "%s", path);
+		if (i > 0 && pthread_create(&th[i], NULL, export_part_run, p) == 0) started[i] = true;
+	}
+	for (unsigned i = 0; i < parts; i++) {
+		if (!started[i]) export_part_run(&ps[i]);
+	}
+	bool ok = true;
+	uint64_t docs = 0, bytes = 0;
+	for (unsigned i = 0; i < parts; i++) {
+		if (started[i]) pthread_join(th[i], NULL);
+		ok = ok && ps[i].ok;
+		docs += ps[i].docs;
+		bytes += ps[i].bytes;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	if (out) {
+		out->docs    = docs;
+		out->bytes   = bytes;
+		out->seconds = (double)(t1.tv_sec - t0.tv_sec) + (double)(t1.tv_nsec - t0.tv_nsec) / 1e9;
+	}
+	cblu__free(ps); cblu__free(th); cblu__free(started);
+	return ok;
+}
@@ -0,0 +1,187 @@
+//
+//  CBLiteC_import.c
+//
+//  NDJSON bulk import: one JSON object per line, parsed once by Fleece's JSON
+//  parser, saved in large transactions. Lines are split with memchr over a
+//  large read buffer, so the reader never becomes the bottleneck.
+//
+
+#include "CBLiteC_internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CBLU_IMPORT_BUF    (1u << 20)   // initial read buffer; grows for longer lines
+#define CBLU_IMPORT_BATCH  10000
+
+typedef struct {
+	CBLU_Core          core;
+	CBLU_ImportOptions opt;
+	FLString           id_field;
+	FLString           moved_field;  // reserved id_field without its '_'s: where an unusable id goes
+	bool               reserved;     // id_field starts with '_', which LiteCore refuses as a top-level key
+	CBLU_ImportStats   st;
+	struct timespec    t0;
+	unsigned           in_batch;
+	bool               txn;
+} Importer;
+
+static double elapsed_s(const struct timespec* t0) {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (double)(t.tv_sec - t0->tv_sec) + (double)(t.tv_nsec - t0->tv_nsec) / 1e9;
+}
+
+static void import_update_rates(Importer* im) {
+	im->st.seconds = elapsed_s(&im->t0);
+	if (im->st.seconds > 0) {
+		im->st.records_per_sec = (double)im->st.records / im->st.seconds;
+		im->st.bytes_per_sec   = (double)im->st.bytes / im->st.seconds;
+	}
+}
+
+static bool import_commit(Importer* im) {
+	if (!im->txn) return true;
+	CBLError err = {0};
+	bool ok = cblu__end_txn(&im->core, true, &err);
+	if (!ok) {
+		cblu__cbl_error("import commit", err);
+		im->st.records -= im->in_batch;
+		im->st.failed  += im->in_batch;
+	}
+	im->txn = false;
+	im->in_batch = 0;
+	import_update_rates(im);
+	if (im->opt.progress) im->opt.progress(im->opt.progress_ctx, &im->st);
+	return ok;
+}
+
+static void import_line(Importer* im, const char* line, size_t len) {
+	while (len && (line[len-1] == '\r' || line[len-1] == ' ' || line[len-1] == '\t')) len--;
+	if (len == 0) return;
+	im->st.bytes += len;
+
+	FLError ferr = kFLNoError;
+	FLDoc fdoc = FLDoc_FromJSON((FLSlice){ .buf = line, .size = len }, &ferr);
+	FLDict root = fdoc ? FLValue_AsDict(FLDoc_GetRoot(fdoc)) : NULL;
+	if (!root) {
+		im->st.failed++;
+		if (fdoc) FLDoc_Release(fdoc);
+		return;
+	}
+
+	// Doc ID from the configured field: strings as-is, integers in decimal, otherwise auto
+	char num[24];
+	FLString id = { NULL, 0 };
+	FLValue idv = FLDict_Get(root, im->id_field);
+	if (fl_is_string(idv)) id = FLValue_AsString(idv);
+	else if (fl_is_number(idv) && FLValue_IsInteger(idv)) {
+		int n = snprintf(num, sizeof num, "%" PRId64, (int64_t)FLValue_AsInt(idv));
+		id = (FLString){ .buf = num, .size = (size_t)n };
+	}
+	CBLDocument* doc = id.size ? CBLDocument_CreateWithID(id) : CBLDocument_Create();
+
+	// Shallow mutable copy: shares the parsed values, copies only what we change.
+	// A used id leaves the body unless kept; an unusable one stays, except that
+	// a reserved field can't be saved, so its value moves to moved_field.
+	FLMutableDict props = FLDict_MutableCopy(root, kFLDefaultCopy);
+	if (idv && im->reserved) {
+		if (!id.size && im->moved_field.size && !FLDict_Get(root, im->moved_field))
+			FLMutableDict_SetValue(props, im->moved_field, idv);
+		FLMutableDict_Remove(props, im->id_field);
+	} else if (id.size && !im->opt.keep_id_field) {
+		FLMutableDict_Remove(props, im->id_field);
+	}
+	CBLDocument_SetProperties(doc, props);
+	FLMutableDict_Release(props);
+
+	if (!im->txn) {
+		CBLError terr = {0};
+		im->txn = cblu__begin_txn(&im->core, &terr);
+		if (!im->txn) cblu__cbl_error("import begin txn", terr);
+	}
+	CBLError err = {0};
+	if (cblu__save_doc(&im->core, doc, &err)) {
+		im->st.records++;
+		if (im->txn) im->in_batch++;
+	} else {
+		im->st.failed++;
+	}
+	CBLDocument_Release(doc);
+	FLDoc_Release(fdoc);  // after the save: props referenced its values
+
+	if (im->in_batch >= im->opt.batch_docs) import_commit(im);
+}
+
+bool cblu_import_ndjson_fd(CBLU_Db* db, int fd, const CBLU_ImportOptions* opt, CBLU_ImportStats* out) {
+	if (out) memset(out, 0, sizeof *out);
+	if (!db || fd < 0) return false;
+	Importer im = { .core = db->core };
+	if (opt) im.opt = *opt;
+	if (!im.opt.batch_docs) im.opt.batch_docs = CBLU_IMPORT_BATCH;
+	im.id_field = fl_from_c(im.opt.id_field && *im.opt.id_field ? im.opt.id_field : "_id");
+	im.reserved = ((const char*)im.id_field.buf)[0] == '_';
+	if (im.reserved && im.opt.keep_id_field) {  // would fail every save
+		cblu__wrapper_error("import", CBLU_ERR_INVALID);
+		return false;
+	}
+	im.moved_field = im.id_field;
+	while (im.moved_field.size && ((const char*)im.moved_field.buf)[0] == '_') {
+		im.moved_field.buf = (const char*)im.moved_field.buf + 1;
+		im.moved_field.size--;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &im.t0);
+#if defined(POSIX_FADV_SEQUENTIAL)
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+	size_t cap = CBLU_IMPORT_BUF, len = 0;
+	char* buf = (char*)cblu__malloc(CBLU_MEM_IO, cap);
+	if (!buf) return false;
+	bool io_ok = true;
+	for (;;) {
+		if (len == cap) {  // a single line longer than the buffer
+			char* nb = (char*)cblu__realloc(CBLU_MEM_IO, buf, cap * 2);
+			if (!nb) { io_ok = false; break; }
+			buf = nb; cap *= 2;
+		}
+		ssize_t r = read(fd, buf + len, cap - len);
+		if (r < 0 && errno == EINTR) continue;
+		if (r < 0) { cblu__posix_error("import read", errno); io_ok = false; break; }
+		if (r == 0) break;
+		len += (size_t)r;
+
+		char* p = buf;
+		char* end = buf + len;
+		char* nl;
+		while ((nl = (char*)memchr(p, '\n', (size_t)(end - p))) != NULL) {
+			import_line(&im, p, (size_t)(nl - p));
+			p = nl + 1;
+		}
+		len = (size_t)(end - p);
+		memmove(buf, p, len);
+	}
+	if (io_ok && len) import_line(&im, buf, len);  // last line without '\n'
+	cblu__free(buf);
+	import_commit(&im);
+	import_update_rates(&im);
+	if (out) *out = im.st;
+	return io_ok && im.st.failed == 0;
+}
+
+bool cblu_import_ndjson_file(CBLU_Db* db, const char* path, const CBLU_ImportOptions* opt, CBLU_ImportStats* out) {
+	if (out) memset(out, 0, sizeof *out);
+	if (!path) return false;
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		cblu__posix_error("import open", errno);
+		return false;
+	}
+	bool ok = cblu_import_ndjson_fd(db, fd, opt, out);
+	close(fd);
+	return ok;
+}
@@ -0,0 +1,303 @@
+//
+//  CBLiteC_ingest.c
+//
+//  Parallel bulk blob import: worker threads stream files into the blob store
+//  (CBLBlobWriteStream computes the digest as it writes), and one writer
+//  thread attaches the finished blobs to documents in batched transactions.
+//  Bytes that are read but not yet committed are capped by max_inflight_bytes;
+//  each worker holds a single fixed-size buffer, so memory stays flat.
+//
+
+#include "CBLiteC_internal.h"
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define CBLU_INGEST_THREADS   4
+#define CBLU_INGEST_INFLIGHT  (64u * 1024u * 1024u)
+#define CBLU_INGEST_BATCH     64
+#define CBLU_INGEST_CHUNK     (256u * 1024u)
+#define CBLU_INGEST_QUEUE     256          // queued files per stage
+
+typedef struct IngestJob {
+	struct IngestJob* next;
+	char*    path;
+	char*    doc_id;
+	char*    key;
+	char*    content_type;
+	uint64_t size;          // reserved from the in-flight budget
+	CBLBlob* blob;          // set by the worker
+} IngestJob;
+
+typedef struct {
+	IngestJob* head;
+	IngestJob* tail;
+	size_t     len;
+} JobList;
+
+struct CBLU_Ingest {
+	CBLU_Core          core;
+	CBLU_IngestOptions opt;
+	pthread_mutex_t    mu;
+	pthread_cond_t     cv;          // any state change; waiters re-check their condition
+	JobList            todo;        // added, waiting for a worker
+	JobList            done;        // blob written, waiting for the writer
+	uint64_t           inflight;    // budget bytes held by jobs read but not committed
+	bool               closing;     // no more adds
+	unsigned           workers_live;
+	pthread_t*         workers;
+	unsigned           nworkers;
+	pthread_t          writer;
+	bool               has_writer;
+	IngestJob**        batch;       // writer's scratch, batch_docs entries
+	CBLU_IngestStats   stats;
+};
+
+static void job_push(JobList* l, IngestJob* j) {
+	j->next = NULL;
+	if (l->tail) l->tail->next = j; else l->head = j;
+	l->tail = j;
+	l->len++;
+}
+
+static IngestJob* job_pop(JobList* l) {
+	IngestJob* j = l->head;
+	if (!j) return NULL;
+	l->head = j->next;
+	if (!l->head) l->tail = NULL;
+	l->len--;
+	return j;
+}
+
+static void job_free(IngestJob* j) {
+	if (!j) return;
+	if (j->blob) CBLBlob_Release(j->blob);
+	cblu__free(j->path); cblu__free(j->doc_id); cblu__free(j->key); cblu__free(j->content_type);
+	cblu__free(j);
+}
+
+// Streams one file into the blob store; the returned blob is not yet attached
+static CBLBlob* ingest_stream_file(CBLU_Ingest* g, IngestJob* j, void* buf) {
+	int fd = open(j->path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		cblu__posix_error("ingest open", errno);
+		return NULL;
+	}
+#if defined(POSIX_FADV_SEQUENTIAL)
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+	CBLError err = {0};
+	CBLBlobWriteStream* ws = CBLBlobWriter_Create(g->core.db, &err);
+	if (!ws) {
+		cblu__cbl_error("ingest blob writer", err);
+		close(fd);
+		return NULL;
+	}
+	bool ok = true;
+	for (;;) {
+		ssize_t r = read(fd, buf, CBLU_INGEST_CHUNK);
+		if (r < 0 && errno == EINTR) continue;
+		if (r < 0) { cblu__posix_error("ingest read", errno); ok = false; break; }
+		if (r == 0) break;
+		if (!CBLBlobWriter_Write(ws, buf, (size_t)r, &err)) {
+			cblu__cbl_error("ingest blob write", err);
+			ok = false;
+			break;
+		}
+	}
+	close(fd);
+	if (!ok) { CBLBlobWriter_Close(ws); return NULL; }
+	return CBLBlob_CreateWithStream(fl_from_c(j->content_type), ws);  // takes the stream
+}
+
+static void* ingest_worker(void* arg) {
+	CBLU_Ingest* g = (CBLU_Ingest*)arg;
+	void* buf = cblu__aligned_alloc(CBLU_MEM_INGEST, 4096, CBLU_INGEST_CHUNK);
+
+	pthread_mutex_lock(&g->mu);
+	for (;;) {
+		IngestJob* j = NULL;
+		for (;;) {
+			j = g->todo.head;
+			if (!j) {
+				if (g->closing) break;
+				pthread_cond_wait(&g->cv, &g->mu);
+				continue;
+			}
+			// An oversized file is admitted alone so the pipeline can't stall
+			bool fits = g->inflight == 0 || g->inflight + j->size <= g->opt.max_inflight_bytes;
+			if (fits && g->done.len < CBLU_INGEST_QUEUE) break;
+			pthread_cond_wait(&g->cv, &g->mu);
+		}
+		if (!j) break;
+		job_pop(&g->todo);
+		g->inflight += j->size;
+		pthread_cond_broadcast(&g->cv);  // room in todo for add()
+		pthread_mutex_unlock(&g->mu);
+
+		j->blob = buf ? ingest_stream_file(g, j, buf) : NULL;
+
+		pthread_mutex_lock(&g->mu);
+		if (j->blob) {
+			job_push(&g->done, j);
+		} else {
+			g->inflight -= j->size;
+			g->stats.failed++;
+			job_free(j);
+		}
+		pthread_cond_broadcast(&g->cv);
+	}
+	g->workers_live--;
+	pthread_cond_broadcast(&g->cv);
+	pthread_mutex_unlock(&g->mu);
+	cblu__free(buf);
+	return NULL;
+}
+
+// Adds the blob under key, keeping any other properties the document already has
+static bool ingest_attach(CBLU_Ingest* g, IngestJob* j, CBLError* err) {
+	FLString id = fl_from_c(j->doc_id);
+	CBLDocument* doc = CBLCollection_GetMutableDocument(g->core.coll, id, err);
+	if (!doc) doc = CBLDocument_CreateWithID(id);
+	FLMutableDict_SetBlob(CBLDocument_MutableProperties(doc), fl_from_c(j->key), j->blob);
+	bool ok = cblu__save_doc(&g->core, doc, err);
+	CBLDocument_Release(doc);
+	return ok;
+}
+
+static void* ingest_writer(void* arg) {
+	CBLU_Ingest* g = (CBLU_Ingest*)arg;
+	IngestJob** batch = g->batch;
+
+	pthread_mutex_lock(&g->mu);
+	for (;;) {
+		while (!g->done.len && g->workers_live > 0) pthread_cond_wait(&g->cv, &g->mu);
+		if (!g->done.len) break;
+		size_t n = 0;
+		while (n < g->opt.batch_docs && g->done.len) batch[n++] = job_pop(&g->done);
+		pthread_cond_broadcast(&g->cv);
+		pthread_mutex_unlock(&g->mu);
+
+		CBLError err = {0};
+		uint64_t ok_files = 0, ok_bytes = 0, failed = 0;
+		bool txn = cblu__begin_txn(&g->core, &err);
+		if (!txn) cblu__cbl_error("ingest begin txn", err);
+		for (size_t i = 0; i < n; i++) {
+			err = (CBLError){0};
+			if (ingest_attach(g, batch[i], &err)) { ok_files++; ok_bytes += CBLBlob_Length(batch[i]->blob); }
+			else {
+				cblu__error("ingest save", (int)err.domain, (int)err.code, fl_from_c(batch[i]->doc_id));
+				failed++;
+			}
+		}
+		if (txn) {
+			err = (CBLError){0};
+			if (!cblu__end_txn(&g->core, true, &err)) {
+				cblu__cbl_error("ingest commit", err);
+				failed += ok_files; ok_files = 0; ok_bytes = 0;
+			}
+		}
+
+		pthread_mutex_lock(&g->mu);
+		for (size_t i = 0; i < n; i++) { g->inflight -= batch[i]->size; job_free(batch[i]); }
+		g->stats.files  += ok_files;
+		g->stats.bytes  += ok_bytes;
+		g->stats.failed += failed;
+		pthread_cond_broadcast(&g->cv);
+	}
+	pthread_mutex_unlock(&g->mu);
+	return NULL;
+}
+
+// ---- Public API ----
+CBLU_Ingest* cblu_ingest_begin(CBLU_Db* db, const CBLU_IngestOptions* opt) {
+	if (!db) return NULL;
+	CBLU_Ingest* g = (CBLU_Ingest*)cblu__calloc(CBLU_MEM_INGEST, 1, sizeof *g);
+	if (!g) return NULL;
+	g->core = db->core;
+	if (opt) g->opt = *opt;
+	if (!g->opt.threads)            g->opt.threads = CBLU_INGEST_THREADS;
+	if (!g->opt.max_inflight_bytes) g->opt.max_inflight_bytes = CBLU_INGEST_INFLIGHT;
+	if (!g->opt.batch_docs)         g->opt.batch_docs = CBLU_INGEST_BATCH;
+	pthread_mutex_init(&g->mu, NULL);
+	pthread_cond_init(&g->cv, NULL);
+
+	g->workers = (pthread_t*)cblu__calloc(CBLU_MEM_INGEST, g->opt.threads, sizeof *g->workers);
+	g->batch   = (IngestJob**)cblu__malloc(CBLU_MEM_INGEST, g->opt.batch_docs * sizeof *g->batch);
+	if (!g->workers || !g->batch) { cblu_ingest_finish(g, NULL); return NULL; }
+	pthread_mutex_lock(&g->mu);
+	for (unsigned i = 0; i < g->opt.threads; i++) {
+		if (pthread_create(&g->workers[i], NULL, ingest_worker, g) != 0) break;
+		g->nworkers++;
+		g->workers_live++;
+	}
+	pthread_mutex_unlock(&g->mu);
+	if (g->nworkers == 0 || pthread_create(&g->writer, NULL, ingest_writer, g) != 0) {
+		cblu_ingest_finish(g, NULL);
+		return NULL;
+	}
+	g->has_writer = true;
+	return g;
+}
+
+bool cblu_ingest_add(CBLU_Ingest* g, const char* path, const char* doc_id, const char* key, const char* content_type) {
+	if (!g || !path || !doc_id || !key) return false;
+	struct stat st;
+	if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+		pthread_mutex_lock(&g->mu);
+		g->stats.failed++;
+		pthread_mutex_unlock(&g->mu);
+		return false;
+	}
+	IngestJob* j = (IngestJob*)cblu__calloc(CBLU_MEM_INGEST, 1, sizeof *j);
+	if (!j) return false;
+	j->path         = cblu__strdup(CBLU_MEM_INGEST, path);
+	j->doc_id       = cblu__strdup(CBLU_MEM_INGEST, doc_id);
+	j->key          = cblu__strdup(CBLU_MEM_INGEST, key);
+	j->content_type = cblu__strdup(CBLU_MEM_INGEST, content_type ? content_type : "application/octet-stream");
+	j->size         = (uint64_t)st.st_size;
+	if (!j->path || !j->doc_id || !j->key || !j->content_type) { job_free(j); return false; }
+
+	pthread_mutex_lock(&g->mu);
+	while (g->todo.len >= CBLU_INGEST_QUEUE) pthread_cond_wait(&g->cv, &g->mu);
+	job_push(&g->todo, j);
+	pthread_cond_broadcast(&g->cv);
+	pthread_mutex_unlock(&g->mu);
+	return true;
+}
+
+void cblu_ingest_stats(CBLU_Ingest* g, CBLU_IngestStats* out) {
+	if (!g || !out) return;
+	pthread_mutex_lock(&g->mu);
+	*out = g->stats;
+	out->inflight_bytes = g->inflight;
+	pthread_mutex_unlock(&g->mu);
+}
+
+bool cblu_ingest_finish(CBLU_Ingest* g, CBLU_IngestStats* out) {
+	if (!g) return false;
+	pthread_mutex_lock(&g->mu);
+	g->closing = true;
+	pthread_cond_broadcast(&g->cv);
+	pthread_mutex_unlock(&g->mu);
+
+	for (unsigned i = 0; i < g->nworkers; i++) pthread_join(g->workers[i], NULL);
+	if (g->has_writer) pthread_join(g->writer, NULL);
+
+	// Only reachable when startup failed part-way
+	IngestJob* j;
+	while ((j = job_pop(&g->todo))) { g->stats.failed++; job_free(j); }
+	while ((j = job_pop(&g->done))) { g->stats.failed++; job_free(j); }
+
+	bool ok = g->stats.failed == 0;
+	if (out) { *out = g->stats; out->inflight_bytes = 0; }
+	cblu__free(g->workers);
+	cblu__free(g->batch);
+	pthread_cond_destroy(&g->cv);
+	pthread_mutex_destroy(&g->mu);
+	cblu__free(g);
+	return ok;
+}
@@ -0,0 +1,126 @@
+//
+//  CBLiteC_internal.h
+//
+//  Private structs and helpers shared by the CBLiteC translation units.
+//  Not part of the public API — include CBLiteC.h from application code.
+//
+
+#ifndef CBLiteC_internal_h
+#define CBLiteC_internal_h
+
+#pragma once
+#include "CBLiteC.h"
+#include "CBLiteC_trace.h"
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+// If your installation uses framework-style includes, swap these for <cbl/...>
+#include "CBLDatabase.h"
+#include "CBLCollection.h"
+#include "CBLDocument.h"
+#include "Fleece.h"
+#include "CBLBlob.h"
+#include "CBLQuery.h"
+
+// --- Fleece portability shims (older/newer headers may use 'Unsigned' vs 'UInt') ---
+#if !defined(FLMutableDict_SetUInt) && defined(FLMutableDict_SetUnsigned)
+#define FLMutableDict_SetUInt FLMutableDict_SetUnsigned
+#endif
+
+#if !defined(FLMutableArray_AppendUInt) && defined(FLMutableArray_AppendUnsigned)
+#define FLMutableArray_AppendUInt FLMutableArray_AppendUnsigned
+#endif
+
+// --- Small helpers ---
+static inline bool fl_is_number(FLValue v) {
+	return v && FLValue_GetType(v) == kFLNumber;
+}
+
+static inline bool fl_is_string(FLValue v) {
+	return v && FLValue_GetType(v) == kFLString;
+}
+
+// Blob metadata dict → blob (NULL if v isn't one); owned by the containing document
+static inline const CBLBlob* fl_get_blob(FLValue v) {
+	FLDict dict = FLValue_AsDict(v);
+	return (dict && FLDict_IsBlob(dict)) ? FLDict_GetBlob(dict) : NULL;
+}
+
+static inline FLString fl_from_c(const char* s) {
+	return (FLString){ .buf = s, .size = s ? strlen(s) : 0 };
+}
+
+// --- Opaque/inner structs ---
+typedef struct {
+	CBLDatabase*     db;
+	CBLCollection*   coll;
+	pthread_mutex_t* wmu;   // writer lock of the owning CBLU_Db; NULL on reader handles
+} CBLU_Core;
+
+// write_mu is recursive: a transaction holds it and saves inside it take it again.
+// epoch tells a reopened CBLU_Db at a reused address apart in per-thread caches.
+struct CBLU_Db      { CBLU_Core core; CBLU_Core* readers; unsigned nreaders; pthread_mutex_t write_mu; uint64_t epoch; };
+struct CBLU_Session { CBLU_Core core; CBLU_Core rcore; bool txn_active; bool thread_owned; CBLU_ErrorRec last_err; };  // rcore: handle used for reads
+// recorded: opened by a public begin/get while recording was on, so its later calls are recorded too
+// shard: index + 1 when made by cblu_shards_docw_begin (the only handles submit accepts), else 0
+struct CBLU_DocW    { CBLU_Core core; CBLDocument* doc; FLMutableDict props; CBLU_Session* sess; unsigned shard; bool recorded; };  // sess: NULL outside sessions
+struct CBLU_DocR    { CBLU_Core core; const CBLDocument* doc; FLDict props; bool recorded; };  // core by value: may outlive its session
+struct CBLU_Query   { CBLU_Core core; CBLQuery* query; CBLResultSet* rs; unsigned ncols; uint64_t rows; bool recorded; };
+
+// --- Shared between translation units ---
+// CBLiteC.c — the wrapper's own documents (queues, event logs) live in scope
+// CBLU_SYS_SCOPE, one collection per module, so user queries, export and the
+// changes feed never see them. out->coll is retained: release it when done.
+#define     CBLU_SYS_SCOPE  "cblu"
+bool        cblu__sys_core(const CBLU_Core* base, const char* coll_name, CBLU_Core* out);
+
+// CBLiteC_query.c
+CBLU_Query* cblu__query_open(const CBLU_Core* core, const char* n1ql);
+FLValue     cblu__query_value(CBLU_Query* q, unsigned col);
+bool        cblu__coll_expr(const CBLU_Core* core, char* buf, size_t n);
+typedef bool (*CBLU_SeqScanFn)(void* ctx, FLString id, uint64_t seq, FLString rev, FLDict body);
+bool        cblu__seq_scan(const CBLU_Core* core, uint64_t after, uint64_t upto, size_t limit,
+						   CBLU_SeqScanFn fn, void* ctx);
+uint64_t    cblu__max_seq(const CBLU_Core* core);
+
+// CBLiteC_stats.c
+uint64_t    cblu__now_ns(void);
+void        cblu__stats_record(CBLU_Op op, uint64_t t0, bool ok);  // t0 from cblu__now_ns
+bool        cblu__begin_txn(const CBLU_Core* core, CBLError* err);             // writer lock + BeginTransaction + trace
+bool        cblu__end_txn(const CBLU_Core* core, bool commit, CBLError* err);  // EndTransaction + stats, then unlock
+bool        cblu__save_doc(const CBLU_Core* core, CBLDocument* doc, CBLError* err);  // SaveDocument under the writer lock
+
+// Writer lock: every write outside a transaction takes it, so it can't land in
+// another thread's open transaction on the same CBLDatabase
+static inline void cblu__write_lock(const CBLU_Core* core)   { if (core->wmu) pthread_mutex_lock(core->wmu); }
+static inline void cblu__write_unlock(const CBLU_Core* core) { if (core->wmu) pthread_mutex_unlock(core->wmu); }
+
+// CBLiteC_error.c — api is a static string naming the failed step
+void        cblu__error(const char* api, int domain, int code, FLString doc);
+void        cblu__error_in(CBLU_ErrorRec* session_slot, const char* api, int domain, int code, FLString doc);
+CBLU_ErrorRec cblu__last_error(void);  // this thread's latest record, zeroed if none
+
+// CBLiteC_mem.c — wrapper allocations; free any of them with cblu__free
+void*       cblu__malloc(CBLU_MemType t, size_t n);
+void*       cblu__calloc(CBLU_MemType t, size_t count, size_t size);
+void*       cblu__realloc(CBLU_MemType t, void* p, size_t n);  // not for aligned blocks
+void*       cblu__aligned_alloc(CBLU_MemType t, size_t align, size_t n);
+char*       cblu__strdup(CBLU_MemType t, const char* s);
+void        cblu__free(void* p);
+
+// CBLiteC_record.c — CBLU_REC costs one relaxed load while recording is off
+extern _Atomic bool cblu__rec_on;
+void        cblu__rec(CBLU_RecOp op, const void* h, uint64_t a, const char* s, uint64_t b);
+#define     CBLU_REC(op, h, a, s, b) \
+	do { if (atomic_load_explicit(&cblu__rec_on, memory_order_relaxed)) cblu__rec((op), (h), (a), (s), (b)); } while (0)
+// For calls on a DocW/DocR/Query: only handles whose begin was recorded, so a replay
+// never sees a save or free without its begin (internal handles are never recorded)
+#define     CBLU_REC_ON(h) ((h)->recorded = atomic_load_explicit(&cblu__rec_on, memory_order_relaxed))
+#define     CBLU_REC_H(op, h, a, s, b) \
+	do { if ((h)->recorded) CBLU_REC((op), (h), (a), (s), (b)); } while (0)
+#define     cblu__cbl_error(api, err)      cblu__error((api), (int)(err).domain, (int)(err).code, kFLSliceNull)
+#define     cblu__posix_error(api, errnum) cblu__error((api), CBLU_ERR_DOMAIN_POSIX, (errnum), kFLSliceNull)
+#define     cblu__wrapper_error(api, code) cblu__error((api), CBLU_ERR_DOMAIN_WRAPPER, (code), kFLSliceNull)
+
+#endif /* CBLiteC_internal_h */
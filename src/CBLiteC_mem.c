@@ -0,0 +1,219 @@
+//
+//  CBLiteC_mem.c
+//
+//  Every allocation the wrapper makes goes through here: to the embedder's
+//  allocator if one was installed, else libc. A small header in front of each
+//  block records its size and handle type, so frees are attributed without a
+//  lookup and live/peak bytes per type come from a few atomics. Couchbase
+//  Lite's and Fleece's own allocations are not included.
+//
+
+#include "CBLiteC_internal.h"
+#include <stdalign.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <sched.h>
+
+typedef struct {
+	uint64_t size;    // bytes requested
+	uint32_t type;    // CBLU_MemType
+	uint16_t offset;  // from the start of the underlying block to the caller's pointer
+	uint16_t extra;   // underlying block size - size
+} MemHdr;
+
+#define MEM_ALIGN  alignof(max_align_t)
+#define MEM_HDR    ((sizeof(MemHdr) + MEM_ALIGN - 1) / MEM_ALIGN * MEM_ALIGN)
+#define CBLU_MEM_MAX_ALIGN  16384u   // keeps offset and extra in 16 bits
+
+typedef struct {
+	alignas(64) _Atomic uint64_t live;  // own cache line per type
+	_Atomic uint64_t peak, allocs, frees, failed;
+} MemCounters;
+
+static MemCounters       g_mem[CBLU_MEM_COUNT];
+static _Atomic uint64_t  g_mem_live;   // all types
+static _Atomic uint64_t  g_mem_peak;
+static _Atomic uint64_t  g_mem_limit;  // 0: none
+static CBLU_Allocator    g_alloc;      // malloc_fn NULL: libc
+
+// Live blocks of any size. cblu_set_allocator swaps g_alloc only by moving this
+// from 0 to MEM_INSTALLING; an allocation that lands meanwhile waits for the swap.
+#define MEM_INSTALLING  (UINT64_C(1) << 63)
+static _Atomic uint64_t  g_mem_blocks;
+
+static const char* const kMemNames[CBLU_MEM_COUNT] = {
+	"db", "session", "doc", "path", "blob", "query", "arrow", "changes", "counters",
+	"queue", "evlog", "ingest", "io", "shards", "metrics", "stats",
+};
+
+static inline void peak_raise(_Atomic uint64_t* peak, uint64_t v) {
+	uint64_t p = atomic_load_explicit(peak, memory_order_relaxed);
+	while (v > p && !atomic_compare_exchange_weak_explicit(peak, &p, v, memory_order_relaxed, memory_order_relaxed)) {}
+}
+
+// Counts n more live bytes, unless that would pass the limit
+static bool mem_reserve(CBLU_MemType t, uint64_t n) {
+	uint64_t total = atomic_fetch_add_explicit(&g_mem_live, n, memory_order_relaxed) + n;
+	uint64_t limit = atomic_load_explicit(&g_mem_limit, memory_order_relaxed);
+	if (limit && total > limit) {
+		atomic_fetch_sub_explicit(&g_mem_live, n, memory_order_relaxed);
+		return false;
+	}
+	peak_raise(&g_mem_peak, total);
+	peak_raise(&g_mem[t].peak, atomic_fetch_add_explicit(&g_mem[t].live, n, memory_order_relaxed) + n);
+	return true;
+}
+
+static void mem_release(CBLU_MemType t, uint64_t n) {
+	atomic_fetch_sub_explicit(&g_mem_live, n, memory_order_relaxed);
+	atomic_fetch_sub_explicit(&g_mem[t].live, n, memory_order_relaxed);
+}
+
+static void mem_failed(CBLU_MemType t) {
+	atomic_fetch_add_explicit(&g_mem[t].failed, 1, memory_order_relaxed);
+	cblu__wrapper_error("alloc", CBLU_ERR_NOMEM);
+}
+
+static inline MemHdr* hdr_of(void* p) { return (MemHdr*)((char*)p - MEM_HDR); }
+
+// Pins g_alloc for one more block; pairs with block_put
+static void block_get(void) {
+	uint64_t b = atomic_fetch_add_explicit(&g_mem_blocks, 1, memory_order_acquire);
+	while (b & MEM_INSTALLING) {
+		sched_yield();
+		b = atomic_load_explicit(&g_mem_blocks, memory_order_acquire);
+	}
+}
+
+static inline void block_put(void) {
+	atomic_fetch_sub_explicit(&g_mem_blocks, 1, memory_order_release);
+}
+
+// align is a power of two, MEM_ALIGN..CBLU_MEM_MAX_ALIGN
+static void* mem_alloc(CBLU_MemType t, size_t align, size_t n) {
+	if ((unsigned)t >= CBLU_MEM_COUNT) t = CBLU_MEM_STATS;
+	size_t extra = MEM_HDR + (align - MEM_ALIGN);
+	if (n > SIZE_MAX - extra) return NULL;
+	if (!mem_reserve(t, n)) { mem_failed(t); return NULL; }
+	block_get();
+	char* raw = (char*)(g_alloc.malloc_fn ? g_alloc.malloc_fn(g_alloc.ctx, n + extra) : malloc(n + extra));
+	if (!raw) { block_put(); mem_release(t, n); mem_failed(t); return NULL; }
+	atomic_fetch_add_explicit(&g_mem[t].allocs, 1, memory_order_relaxed);
+	uintptr_t user = ((uintptr_t)raw + MEM_HDR + align - 1) & ~(uintptr_t)(align - 1);
+	MemHdr* h = hdr_of((void*)user);
+	h->size   = n;
+	h->type   = (uint32_t)t;
+	h->offset = (uint16_t)(user - (uintptr_t)raw);
+	h->extra  = (uint16_t)extra;
+	return (void*)user;
+}
+
+// ---- Internal API ----
+void* cblu__malloc(CBLU_MemType t, size_t n) {
+	return mem_alloc(t, MEM_ALIGN, n);
+}
+
+void* cblu__calloc(CBLU_MemType t, size_t count, size_t size) {
+	if (size && count > SIZE_MAX / size) return NULL;
+	void* p = mem_alloc(t, MEM_ALIGN, count * size);
+	if (p) memset(p, 0, count * size);
+	return p;
+}
+
+void* cblu__aligned_alloc(CBLU_MemType t, size_t align, size_t n) {
+	if (align < MEM_ALIGN) align = MEM_ALIGN;
+	if ((align & (align - 1)) || align > CBLU_MEM_MAX_ALIGN) return NULL;
+	return mem_alloc(t, align, n);
+}
+
+char* cblu__strdup(CBLU_MemType t, const char* s) {
+	if (!s) return NULL;
+	size_t n = strlen(s) + 1;
+	char* d = (char*)mem_alloc(t, MEM_ALIGN, n);
+	if (d) memcpy(d, s, n);
+	return d;
+}
+
+// Keeps p's type. Blocks from cblu__aligned_alloc are refused (CBLU_ERR_INVALID).
+void* cblu__realloc(CBLU_MemType t, void* p, size_t n) {
+	if (!p) return cblu__malloc(t, n);
+	MemHdr* h = hdr_of(p);
+	if (h->offset != MEM_HDR || h->extra != MEM_HDR) {  // aligned: raw block doesn't start at the header
+		cblu__wrapper_error("realloc", CBLU_ERR_INVALID);
+		return NULL;
+	}
+	CBLU_MemType pt = (CBLU_MemType)h->type;
+	size_t old = (size_t)h->size;
+	if (g_alloc.malloc_fn && !g_alloc.realloc_fn) {  // embedder allocator without realloc: move
+		void* np = cblu__malloc(pt, n);
+		if (!np) return NULL;
+		memcpy(np, p, old < n ? old : n);
+		cblu__free(p);
+		return np;
+	}
+	if (n > SIZE_MAX - MEM_HDR) return NULL;
+	if (n > old && !mem_reserve(pt, n - old)) { mem_failed(pt); return NULL; }
+	char* raw = (char*)p - MEM_HDR;
+	char* nr = (char*)(g_alloc.realloc_fn ? g_alloc.realloc_fn(g_alloc.ctx, raw, old + MEM_HDR, n + MEM_HDR)
+										  : realloc(raw, n + MEM_HDR));
+	if (!nr) {
+		if (n > old) mem_release(pt, n - old);
+		mem_failed(pt);
+		return NULL;
+	}
+	if (n < old) mem_release(pt, old - n);
+	((MemHdr*)nr)->size = n;  // offset and extra stay MEM_HDR
+	return nr + MEM_HDR;
+}
+
+void cblu__free(void* p) {
+	if (!p) return;
+	MemHdr* h = hdr_of(p);
+	CBLU_MemType t = (CBLU_MemType)h->type;
+	size_t n = (size_t)h->size, off = h->offset;
+	mem_release(t, n);
+	atomic_fetch_add_explicit(&g_mem[t].frees, 1, memory_order_relaxed);
+	if (g_alloc.free_fn) g_alloc.free_fn(g_alloc.ctx, (char*)p - off, n + h->extra);
+	else                 free((char*)p - off);
+	block_put();
+}
+
+// ---- Public API ----
+bool cblu_set_allocator(const CBLU_Allocator* a) {
+	if (a && (!a->malloc_fn || !a->free_fn)) return false;
+	uint64_t none = 0;  // blocks from the old allocator must not outlive it
+	if (!atomic_compare_exchange_strong_explicit(&g_mem_blocks, &none, MEM_INSTALLING,
+												 memory_order_acquire, memory_order_relaxed)) return false;
+	g_alloc = a ? *a : (CBLU_Allocator){0};
+	atomic_fetch_and_explicit(&g_mem_blocks, ~MEM_INSTALLING, memory_order_release);
+	return true;
+}
+
+void cblu_mem_set_limit(uint64_t max_live_bytes) {
+	atomic_store_explicit(&g_mem_limit, max_live_bytes, memory_order_relaxed);
+}
+
+void cblu_mem_stats(CBLU_MemType t, CBLU_MemStats* out) {
+	if (!out) return;
+	*out = (CBLU_MemStats){0};
+	if ((unsigned)t >= CBLU_MEM_COUNT) {  // CBLU_MEM_COUNT: all types
+		out->live_bytes = atomic_load_explicit(&g_mem_live, memory_order_relaxed);
+		out->peak_bytes = atomic_load_explicit(&g_mem_peak, memory_order_relaxed);
+		for (int i = 0; i < CBLU_MEM_COUNT; i++) {
+			out->allocs += atomic_load_explicit(&g_mem[i].allocs, memory_order_relaxed);
+			out->frees  += atomic_load_explicit(&g_mem[i].frees,  memory_order_relaxed);
+			out->failed += atomic_load_explicit(&g_mem[i].failed, memory_order_relaxed);
+		}
+		return;
+	}
+	const MemCounters* c = &g_mem[t];
+	out->live_bytes = atomic_load_explicit(&c->live,   memory_order_relaxed);
+	out->peak_bytes = atomic_load_explicit(&c->peak,   memory_order_relaxed);
+	out->allocs     = atomic_load_explicit(&c->allocs, memory_order_relaxed);
+	out->frees      = atomic_load_explicit(&c->frees,  memory_order_relaxed);
+	out->failed     = atomic_load_explicit(&c->failed, memory_order_relaxed);
+}
+
+const char* cblu_mem_type_name(CBLU_MemType t) {
+	return (unsigned)t < CBLU_MEM_COUNT ? kMemNames[t] : "total";
+}
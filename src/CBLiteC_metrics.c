@@ -0,0 +1,248 @@
+//
+//  CBLiteC_metrics.c
+//
+//  Prometheus text exposition of the wrapper statistics, into a caller buffer
+//  or rewritten atomically (tmp + fsync + rename) to a file on a timer, for the
+//  node_exporter textfile collector. Rendering runs on the caller's or the
+//  timer's thread only; the hot path keeps recording into its stats shard.
+//
+//  Each histogram "le" bound is 2^k - 1 ns (1.023 µs .. 17.2 s): the inclusive
+//  upper edge of a stats bucket, since every power of two starts one. Each
+//  rendered count is then exactly the calls that took at most that long.
+//
+
+#include "CBLiteC_internal.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CBLU_METRICS_LE_FIRST  10   // le = 2^10 - 1 ns
+#define CBLU_METRICS_LE_LAST   34   // le = 2^34 - 1 ns
+#define CBLU_METRICS_LE_STEP   2
+
+typedef struct { char* buf; size_t cap, len; } Out;
+
+static void out_printf(Out* o, const char* fmt, ...) {
+	va_list ap;
+	va_start(ap, fmt);
+	size_t room = o->len < o->cap ? o->cap - o->len : 0;
+	int n = vsnprintf(room ? o->buf + o->len : NULL, room, fmt, ap);
+	va_end(ap);
+	if (n > 0) o->len += (size_t)n;
+}
+
+// nftw has no context argument; the sum is only used under g_du_mu
+static pthread_mutex_t g_du_mu = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t        g_du;
+static int du_entry(const char* path, const struct stat* st, int flag, struct FTW* ftw) {
+	(void)path; (void)ftw;
+	if (flag == FTW_F) g_du += (uint64_t)st->st_size;
+	return 0;
+}
+
+static uint64_t db_file_bytes(CBLDatabase* db) {
+	FLStringResult p = CBLDatabase_Path(db);
+	if (!p.buf) return 0;
+	char path[4096];
+	size_t n = p.size < sizeof path - 1 ? p.size : sizeof path - 1;
+	memcpy(path, p.buf, n);
+	path[n] = 0;
+	FLSliceResult_Release(p);
+	pthread_mutex_lock(&g_du_mu);
+	g_du = 0;
+	nftw(path, du_entry, 16, FTW_PHYS);
+	uint64_t total = g_du;
+	pthread_mutex_unlock(&g_du_mu);
+	return total;
+}
+
+static void render(CBLU_Db* db, Out* o) {
+	CBLU_Stats* st = (CBLU_Stats*)cblu__malloc(CBLU_MEM_METRICS, sizeof *st);
+	if (!st) return;
+	cblu_stats_snapshot(st);
+
+	out_printf(o, "# HELP cblu_op_calls_total Wrapper operations by type.\n# TYPE cblu_op_calls_total counter\n");
+	for (int op = 0; op < CBLU_OP_COUNT; op++)
+		out_printf(o, "cblu_op_calls_total{op=\"%s\"} %llu\n", cblu_stats_op_name((CBLU_Op)op), (unsigned long long)st->op[op].calls);
+
+	out_printf(o, "# HELP cblu_op_errors_total Failed wrapper operations by type.\n# TYPE cblu_op_errors_total counter\n");
+	for (int op = 0; op < CBLU_OP_COUNT; op++)
+		out_printf(o, "cblu_op_errors_total{op=\"%s\"} %llu\n", cblu_stats_op_name((CBLU_Op)op), (unsigned long long)st->op[op].errors);
+
+	out_printf(o, "# HELP cblu_op_duration_seconds Wrapper operation latency.\n# TYPE cblu_op_duration_seconds histogram\n");
+	for (int op = 0; op < CBLU_OP_COUNT; op++) {
+		const CBLU_OpStats* s = &st->op[op];
+		const char* name = cblu_stats_op_name((CBLU_Op)op);
+		uint64_t cum = 0;
+		unsigned b = 0;
+		for (unsigned k = CBLU_METRICS_LE_FIRST; k <= CBLU_METRICS_LE_LAST; k += CBLU_METRICS_LE_STEP) {
+			uint64_t le = (1ull << k) - 1;  // ns, inclusive
+			while (b < CBLU_STATS_BUCKETS && cblu_stats_bucket_upper_ns(b) <= le) cum += s->buckets[b++];
+			out_printf(o, "cblu_op_duration_seconds_bucket{op=\"%s\",le=\"%llu.%09llu\"} %llu\n", name,
+					   (unsigned long long)(le / 1000000000u), (unsigned long long)(le % 1000000000u), (unsigned long long)cum);
+		}
+		out_printf(o, "cblu_op_duration_seconds_bucket{op=\"%s\",le=\"+Inf\"} %llu\n", name, (unsigned long long)s->calls);
+		out_printf(o, "cblu_op_duration_seconds_sum{op=\"%s\"} %.9f\n", name, (double)s->sum_ns / 1e9);
+		out_printf(o, "cblu_op_duration_seconds_count{op=\"%s\"} %llu\n", name, (unsigned long long)s->calls);
+	}
+
+	out_printf(o, "# HELP cblu_transactions_total Ended transactions by outcome.\n# TYPE cblu_transactions_total counter\n");
+	out_printf(o, "cblu_transactions_total{result=\"commit\"} %llu\n", (unsigned long long)st->op[CBLU_OP_COMMIT].calls);
+	out_printf(o, "cblu_transactions_total{result=\"rollback\"} %llu\n", (unsigned long long)st->op[CBLU_OP_ROLLBACK].calls);
+	cblu__free(st);
+
+	out_printf(o, "# HELP cblu_mem_live_bytes Wrapper heap memory in use by handle type.\n# TYPE cblu_mem_live_bytes gauge\n");
+	for (int t = 0; t < CBLU_MEM_COUNT; t++) {
+		CBLU_MemStats ms;
+		cblu_mem_stats((CBLU_MemType)t, &ms);
+		out_printf(o, "cblu_mem_live_bytes{type=\"%s\"} %llu\n", cblu_mem_type_name((CBLU_MemType)t), (unsigned long long)ms.live_bytes);
+	}
+
+	if (db) {
+		FLString name = CBLDatabase_Name(db->core.db);
+		int nl = (int)(name.size < 200 ? name.size : 200);
+		out_printf(o, "# HELP cblu_db_file_bytes Size of the database directory on disk.\n# TYPE cblu_db_file_bytes gauge\n");
+		out_printf(o, "cblu_db_file_bytes{db=\"%.*s\"} %llu\n", nl, (const char*)name.buf, (unsigned long long)db_file_bytes(db->core.db));
+		out_printf(o, "# HELP cblu_db_documents Documents in the database's collection.\n# TYPE cblu_db_documents gauge\n");
+		out_printf(o, "cblu_db_documents{db=\"%.*s\"} %llu\n", nl, (const char*)name.buf, (unsigned long long)CBLCollection_Count(db->core.coll));
+	}
+}
+
+// ---- Public API ----
+size_t cblu_metrics_render(CBLU_Db* db, char* buf, size_t cap) {
+	Out o = { buf, buf ? cap : 0, 0 };
+	if (buf && cap) buf[0] = 0;
+	render(db, &o);
+	return o.len;
+}
+
+// Renders into a heap buffer sized by a first pass; caller frees
+static char* render_alloc(CBLU_Db* db, size_t* out_len) {
+	size_t cap = 16 * 1024;
+	for (int attempt = 0; attempt < 3; attempt++) {
+		char* buf = (char*)cblu__malloc(CBLU_MEM_METRICS, cap);
+		if (!buf) return NULL;
+		size_t n = cblu_metrics_render(db, buf, cap);
+		if (n < cap) { *out_len = n; return buf; }
+		cblu__free(buf);
+		cap = n + 4096;  // grew between passes at most a little
+	}
+	return NULL;
+}
+
+bool cblu_metrics_write_file(CBLU_Db* db, const char* path) {
+	if (!path) return false;
+	size_t len = 0;
+	char* text = render_alloc(db, &len);
+	if (!text) return false;
+
+	char tmp[4096];
+	snprintf(tmp, sizeof tmp, "%s.tmp.%d", path, (int)getpid());
+	int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		cblu__posix_error("metrics open", errno);
+		cblu__free(text);
+		return false;
+	}
+	bool ok = true;
+	for (size_t off = 0; off < len; ) {
+		ssize_t w = write(fd, text + off, len - off);
+		if (w < 0 && errno == EINTR) continue;
+		if (w < 0) { ok = false; break; }
+		off += (size_t)w;
+	}
+	if (ok && fsync(fd) != 0) ok = false;
+	close(fd);
+	cblu__free(text);
+	if (ok && rename(tmp, path) != 0) ok = false;  // readers see the old or the new file, never a partial one
+	if (!ok) {
+		cblu__posix_error("metrics write", errno);
+		unlink(tmp);
+	}
+	return ok;
+}
+
+// ---- Periodic exporter ----
+struct CBLU_MetricsTimer {
+	CBLU_Db*        db;
+	char*           path;
+	CBLU_MetricsFn  fn;
+	void*           ctx;
+	uint32_t        interval_ms;
+	pthread_t       thread;
+	pthread_mutex_t mu;
+	pthread_cond_t  cv;
+	bool            stop;
+};
+
+static void metrics_emit(CBLU_MetricsTimer* t) {
+	if (t->path) { cblu_metrics_write_file(t->db, t->path); return; }
+	size_t len = 0;
+	char* text = render_alloc(t->db, &len);
+	if (text) t->fn(t->ctx, text, len);
+	cblu__free(text);
+}
+
+static void* metrics_thread(void* arg) {
+	CBLU_MetricsTimer* t = (CBLU_MetricsTimer*)arg;
+	pthread_mutex_lock(&t->mu);
+	while (!t->stop) {
+		struct timespec ts;
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_sec  += t->interval_ms / 1000;
+		ts.tv_nsec += (long)(t->interval_ms % 1000) * 1000000L;
+		if (ts.tv_nsec >= 1000000000L) { ts.tv_sec++; ts.tv_nsec -= 1000000000L; }
+		int rc = 0;
+		while (!t->stop && rc != ETIMEDOUT) rc = pthread_cond_timedwait(&t->cv, &t->mu, &ts);
+		if (t->stop) break;
+		pthread_mutex_unlock(&t->mu);
+		metrics_emit(t);
+		pthread_mutex_lock(&t->mu);
+	}
+	pthread_mutex_unlock(&t->mu);
+	return NULL;
+}
+
+CBLU_MetricsTimer* cblu_metrics_start(CBLU_Db* db, uint32_t interval_ms, const char* path,
+									  CBLU_MetricsFn fn, void* ctx) {
+	if (interval_ms == 0 || (!path == !fn)) return NULL;  // exactly one sink
+	CBLU_MetricsTimer* t = (CBLU_MetricsTimer*)cblu__calloc(CBLU_MEM_METRICS, 1, sizeof *t);
+	if (!t) return NULL;
+	t->db = db;
+	t->path = path ? cblu__strdup(CBLU_MEM_METRICS, path) : NULL;
+	t->fn = fn;
+	t->ctx = ctx;
+	t->interval_ms = interval_ms;
+	pthread_mutex_init(&t->mu, NULL);
+	pthread_cond_init(&t->cv, NULL);
+	if ((path && !t->path) || pthread_create(&t->thread, NULL, metrics_thread, t) != 0) {
+		cblu__wrapper_error("metrics exporter thread", CBLU_ERR_THREAD);
+		pthread_cond_destroy(&t->cv);
+		pthread_mutex_destroy(&t->mu);
+		cblu__free(t->path);
+		cblu__free(t);
+		return NULL;
+	}
+	return t;
+}
+
+void cblu_metrics_stop(CBLU_MetricsTimer* t) {
+	if (!t) return;
+	pthread_mutex_lock(&t->mu);
+	t->stop = true;
+	pthread_cond_signal(&t->cv);
+	pthread_mutex_unlock(&t->mu);
+	pthread_join(t->thread, NULL);
+	metrics_emit(t);  // final values
+	pthread_cond_destroy(&t->cv);
+	pthread_mutex_destroy(&t->mu);
+	cblu__free(t->path);
+	cblu__free(t);
+}
@@ -0,0 +1,150 @@
+//
+//  CBLiteC_query.c
+//
+//  Forward-only SQL++ (N1QL) query cursor with typed column getters
+//
+
+#include "CBLiteC_internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+CBLU_Query* cblu__query_open(const CBLU_Core* core, const char* n1ql) {
+	if (!core || !n1ql) return NULL;
+	CBLError err = {0};
+	int errPos = -1;
+	CBLQuery* query = CBLDatabase_CreateQuery(core->db, kCBLN1QLLanguage, fl_from_c(n1ql), &errPos, &err);
+	if (!query) {
+		cblu__cbl_error("query compile", err);
+		return NULL;
+	}
+	CBLResultSet* rs = CBLQuery_Execute(query, &err);
+	if (!rs) {
+		cblu__cbl_error("query execute", err);
+		CBLQuery_Release(query);
+		return NULL;
+	}
+	CBLU_Query* q = (CBLU_Query*)cblu__calloc(CBLU_MEM_QUERY, 1, sizeof *q);
+	if (!q) { CBLResultSet_Release(rs); CBLQuery_Release(query); return NULL; }
+	q->core  = *core;
+	q->query = query;
+	q->rs    = rs;
+	q->ncols = CBLQuery_ColumnCount(query);
+	return q;
+}
+
+FLValue cblu__query_value(CBLU_Query* q, unsigned col) {
+	if (!q || col >= q->ncols) return NULL;
+	return CBLResultSet_ValueAtIndex(q->rs, col);
+}
+
+// ---- Public API ----
+CBLU_Query* cblu_query_begin(CBLU_Session* s, const char* n1ql) {
+	if (!s) return NULL;
+	CBLU_TRACE1(query_entry, n1ql ? strlen(n1ql) : 0);
+	uint64_t t0 = cblu__now_ns();
+	CBLU_Query* q = cblu__query_open(&s->rcore, n1ql);
+	cblu__stats_record(CBLU_OP_QUERY, t0, q != NULL);
+	CBLU_TRACE3(query_return, (int)(q != NULL), q ? 0 : cblu__last_error().domain, q ? 0 : cblu__last_error().code);
+	if (q && CBLU_REC_ON(q)) cblu__rec(CBLU_REC_QUERY_BEGIN, q, (uintptr_t)s, n1ql, 0);
+	return q;
+}
+
+bool cblu_query_next(CBLU_Query* q) {
+	if (!q || !CBLResultSet_Next(q->rs)) return false;
+	q->rows++;
+	return true;
+}
+
+unsigned cblu_query_columns(CBLU_Query* q) {
+	return q ? q->ncols : 0;
+}
+
+size_t cblu_query_column_name(CBLU_Query* q, unsigned col, char* dst, size_t dst_size) {
+	if (!q || col >= q->ncols || !dst || dst_size == 0) return 0;
+	FLSlice name = CBLQuery_ColumnName(q->query, col);
+	size_t n = (name.buf && name.size < (dst_size - 1)) ? name.size : (dst_size - 1);
+	if (name.buf) { memcpy(dst, name.buf, n); dst[n] = 0; } else { dst[0] = 0; n = 0; }
+	return n;
+}
+
+bool cblu_query_get_i64(CBLU_Query* q, unsigned col, int64_t* out) {
+	if (!out) return false;
+	FLValue v = cblu__query_value(q, col);
+	if (!fl_is_number(v)) return false;
+	*out = (int64_t)FLValue_AsInt(v);
+	return true;
+}
+
+bool cblu_query_get_f64(CBLU_Query* q, unsigned col, double* out) {
+	if (!out) return false;
+	FLValue v = cblu__query_value(q, col);
+	if (!fl_is_number(v)) return false;
+	*out = FLValue_AsDouble(v);
+	return true;
+}
+
+size_t cblu_query_get_str(CBLU_Query* q, unsigned col, char* dst, size_t dst_size) {
+	if (!dst || dst_size == 0) return 0;
+	FLValue v = cblu__query_value(q, col);
+	if (!fl_is_string(v)) { dst[0] = 0; return 0; }
+	FLString s = FLValue_AsString(v);
+	size_t n = (s.buf && s.size < (dst_size - 1)) ? s.size : (dst_size - 1);
+	if (s.buf) { memcpy(dst, s.buf, n); dst[n] = 0; } else { dst[0] = 0; }
+	return n;
+}
+
+void cblu_query_free(CBLU_Query* q) {
+	if (!q) return;
+	CBLU_REC_H(CBLU_REC_QUERY_FREE, q, 0, NULL, q->rows);
+	if (q->rs)    CBLResultSet_Release(q->rs);
+	if (q->query) CBLQuery_Release(q->query);
+	cblu__free(q);
+}
+
+// Writes the quoted `scope`.`collection` name of core's collection for use in FROM clauses
+bool cblu__coll_expr(const CBLU_Core* core, char* buf, size_t n) {
+	if (!core || !core->coll || !buf || n == 0) return false;
+	CBLScope* scope = CBLCollection_Scope(core->coll);
+	FLString sn = CBLScope_Name(scope), cn = CBLCollection_Name(core->coll);
+	int w = snprintf(buf, n, "`%.*s`.`%.*s`", (int)sn.size, (const char*)sn.buf, (int)cn.size, (const char*)cn.buf);
+	CBLScope_Release(scope);
+	return w > 0 && (size_t)w < n;
+}
+
+// Calls fn for every live document with after < sequence <= upto (upto 0: no bound), in
+// sequence order, stopping after limit rows (0: no limit) or when fn returns false.
+bool cblu__seq_scan(const CBLU_Core* core, uint64_t after, uint64_t upto, size_t limit,
+					CBLU_SeqScanFn fn, void* ctx) {
+	char coll[512], n1ql[1024], bound[48] = "", lim[32] = "";
+	if (!fn || !cblu__coll_expr(core, coll, sizeof coll)) return false;
+	if (upto)  snprintf(bound, sizeof bound, " AND META(d).sequence <= %llu", (unsigned long long)upto);
+	if (limit) snprintf(lim, sizeof lim, " LIMIT %llu", (unsigned long long)limit);
+	snprintf(n1ql, sizeof n1ql,
+			 "SELECT META(d).id, META(d).sequence, META(d).revisionID, * FROM %s AS d"
+			 " WHERE META(d).sequence > %llu%s ORDER BY META(d).sequence%s",
+			 coll, (unsigned long long)after, bound, lim);
+	CBLU_Query* q = cblu__query_open(core, n1ql);
+	if (!q) return false;
+	while (CBLResultSet_Next(q->rs)) {
+		FLString id   = FLValue_AsString(CBLResultSet_ValueAtIndex(q->rs, 0));
+		uint64_t seq  = FLValue_AsUnsigned(CBLResultSet_ValueAtIndex(q->rs, 1));
+		FLString rev  = FLValue_AsString(CBLResultSet_ValueAtIndex(q->rs, 2));
+		FLDict   body = FLValue_AsDict(CBLResultSet_ValueAtIndex(q->rs, 3));
+		if (!fn(ctx, id, seq, rev, body)) break;
+	}
+	cblu_query_free(q);
+	return true;
+}
+
+// Highest sequence of a live document (0 if empty)
+uint64_t cblu__max_seq(const CBLU_Core* core) {
+	char coll[512], n1ql[640];
+	if (!cblu__coll_expr(core, coll, sizeof coll)) return 0;
+	snprintf(n1ql, sizeof n1ql, "SELECT MAX(META(d).sequence) FROM %s AS d", coll);
+	CBLU_Query* q = cblu__query_open(core, n1ql);
+	if (!q) return 0;
+	uint64_t max = 0;
+	if (CBLResultSet_Next(q->rs)) max = FLValue_AsUnsigned(CBLResultSet_ValueAtIndex(q->rs, 0));
+	cblu_query_free(q);
+	return max;
+}
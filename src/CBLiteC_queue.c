@@ -0,0 +1,455 @@
+//
+//  CBLiteC_queue.c
+//
+//  Durable work queue over a collection: enqueue, claim with lease, ack, nack.
+//
+//  Each message is a document "cblu.q:<name>:<seq>"; a meta document
+//  "cblu.q:<name>" records the persisted head/tail. Both live in the internal
+//  collection cblu.queue, out of sight of user queries, export and changes. The ready list, leases and the acked
+//  low-water mark live in memory, so claims never touch the database index.
+//  Leases are not persisted: after a restart every unacked message is ready
+//  again (at-least-once delivery).
+//
+
+#include "CBLiteC_internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <time.h>
+
+#define CBLU_QUEUE_LEASE_BUCKETS  64     // initial lease hash buckets (grows x2)
+#define CBLU_QUEUE_HEAD_LAG       64     // acked messages before head is re-persisted
+#define CBLU_QUEUE_COLLECTION     "queue"
+#define CBLU_QUEUE_PREFIX         "cblu.q:"
+
+typedef struct Lease {
+	struct Lease* next;
+	uint64_t seq;
+	uint64_t gen;
+	uint64_t deadline_ns;
+	uint32_t attempts;
+} Lease;
+
+typedef struct { uint64_t deadline_ns; uint64_t seq; uint64_t gen; } LeaseTimer;
+typedef struct { uint64_t seq; uint32_t attempts; } ReadyItem;
+
+struct CBLU_Queue {
+	CBLU_Core       core;
+	char*           name;
+	pthread_mutex_t mu;       // in-memory index
+	pthread_mutex_t txn_mu;   // serializes this queue's transactions
+
+	// ready FIFO (ring)
+	ReadyItem*      ready;
+	size_t          rcap, rhead, rlen;
+
+	// leases: hash by seq + min-heap of deadlines (lazy deletion)
+	Lease**         leases;
+	size_t          nbuckets, nleases;
+	LeaseTimer*     timers;
+	size_t          tcap, tlen;
+	uint64_t        next_gen;
+
+	// acked seqs above 'low', used to advance the low-water mark
+	uint64_t*       done;
+	size_t          dcap, dlen;
+
+	uint64_t        low;          // lowest seq that may still be unacked
+	uint64_t        tail;         // last assigned seq
+	uint64_t        head_saved;   // head value last written to the meta doc
+};
+
+static uint64_t now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void msg_id(const CBLU_Queue* q, uint64_t seq, char* buf, size_t n) {
+	snprintf(buf, n, CBLU_QUEUE_PREFIX "%s:%020" PRIu64, q->name, seq);
+}
+
+static void meta_id(const CBLU_Queue* q, char* buf, size_t n) {
+	snprintf(buf, n, CBLU_QUEUE_PREFIX "%s", q->name);
+}
+
+// ---- ready ring ----
+static bool ready_reserve(CBLU_Queue* q, size_t extra) {
+	if (q->rlen + extra <= q->rcap) return true;
+	size_t cap = q->rcap ? q->rcap : 64;
+	while (cap < q->rlen + extra) cap *= 2;
+	ReadyItem* r = (ReadyItem*)cblu__malloc(CBLU_MEM_QUEUE, cap * sizeof *r);
+	if (!r) return false;
+	for (size_t i = 0; i < q->rlen; i++) r[i] = q->ready[(q->rhead + i) % q->rcap];
+	cblu__free(q->ready);
+	q->ready = r; q->rcap = cap; q->rhead = 0;
+	return true;
+}
+
+static bool ready_push(CBLU_Queue* q, uint64_t seq, uint32_t attempts) {
+	if (!ready_reserve(q, 1)) return false;
+	q->ready[(q->rhead + q->rlen) % q->rcap] = (ReadyItem){ seq, attempts };
+	q->rlen++;
+	return true;
+}
+
+static ReadyItem ready_pop(CBLU_Queue* q) {
+	ReadyItem it = q->ready[q->rhead];
+	q->rhead = (q->rhead + 1) % q->rcap;
+	q->rlen--;
+	return it;
+}
+
+// ---- u64 / timer min-heaps ----
+static bool done_push(CBLU_Queue* q, uint64_t seq) {
+	if (q->dlen == q->dcap) {
+		size_t cap = q->dcap ? q->dcap * 2 : 64;
+		uint64_t* d = (uint64_t*)cblu__realloc(CBLU_MEM_QUEUE, q->done, cap * sizeof *d);
+		if (!d) return false;
+		q->done = d; q->dcap = cap;
+	}
+	size_t i = q->dlen++;
+	while (i > 0 && q->done[(i - 1) / 2] > seq) { q->done[i] = q->done[(i - 1) / 2]; i = (i - 1) / 2; }
+	q->done[i] = seq;
+	return true;
+}
+
+static uint64_t done_pop(CBLU_Queue* q) {
+	uint64_t top = q->done[0], last = q->done[--q->dlen];
+	size_t i = 0;
+	for (;;) {
+		size_t c = 2 * i + 1;
+		if (c >= q->dlen) break;
+		if (c + 1 < q->dlen && q->done[c + 1] < q->done[c]) c++;
+		if (q->done[c] >= last) break;
+		q->done[i] = q->done[c]; i = c;
+	}
+	if (q->dlen) q->done[i] = last;
+	return top;
+}
+
+static bool timer_push(CBLU_Queue* q, LeaseTimer t) {
+	if (q->tlen == q->tcap) {
+		size_t cap = q->tcap ? q->tcap * 2 : 64;
+		LeaseTimer* a = (LeaseTimer*)cblu__realloc(CBLU_MEM_QUEUE, q->timers, cap * sizeof *a);
+		if (!a) return false;
+		q->timers = a; q->tcap = cap;
+	}
+	size_t i = q->tlen++;
+	while (i > 0 && q->timers[(i - 1) / 2].deadline_ns > t.deadline_ns) { q->timers[i] = q->timers[(i - 1) / 2]; i = (i - 1) / 2; }
+	q->timers[i] = t;
+	return true;
+}
+
+static LeaseTimer timer_pop(CBLU_Queue* q) {
+	LeaseTimer top = q->timers[0], last = q->timers[--q->tlen];
+	size_t i = 0;
+	for (;;) {
+		size_t c = 2 * i + 1;
+		if (c >= q->tlen) break;
+		if (c + 1 < q->tlen && q->timers[c + 1].deadline_ns < q->timers[c].deadline_ns) c++;
+		if (q->timers[c].deadline_ns >= last.deadline_ns) break;
+		q->timers[i] = q->timers[c]; i = c;
+	}
+	if (q->tlen) q->timers[i] = last;
+	return top;
+}
+
+// ---- leases ----
+static Lease** lease_slot(CBLU_Queue* q, uint64_t seq) {
+	Lease** p = &q->leases[seq & (q->nbuckets - 1)];
+	while (*p && (*p)->seq != seq) p = &(*p)->next;
+	return p;
+}
+
+static void lease_grow(CBLU_Queue* q) {
+	size_t nb = q->nbuckets * 2;
+	Lease** b = (Lease**)cblu__calloc(CBLU_MEM_QUEUE, nb, sizeof *b);
+	if (!b) return;
+	for (size_t i = 0; i < q->nbuckets; i++) {
+		Lease* l = q->leases[i];
+		while (l) { Lease* next = l->next; l->next = b[l->seq & (nb - 1)]; b[l->seq & (nb - 1)] = l; l = next; }
+	}
+	cblu__free(q->leases);
+	q->leases = b; q->nbuckets = nb;
+}
+
+// Marks seq as finished (acked or lost) and advances the low-water mark
+static void mark_done(CBLU_Queue* q, uint64_t seq) {
+	if (seq < q->low) return;
+	if (seq == q->low) q->low++;
+	else if (!done_push(q, seq)) return; // only delays the head; recovery rescans the gap
+	while (q->dlen && q->done[0] <= q->low) {
+		uint64_t s = done_pop(q);
+		if (s == q->low) q->low++;
+	}
+}
+
+// Returns expired leases to the ready list
+static void expire_leases(CBLU_Queue* q, uint64_t now) {
+	while (q->tlen && q->timers[0].deadline_ns <= now) {
+		LeaseTimer t = timer_pop(q);
+		Lease** slot = lease_slot(q, t.seq);
+		Lease* l = *slot;
+		if (!l || l->gen != t.gen) continue; // acked/nacked/re-leased since
+		if (!ready_push(q, l->seq, l->attempts)) { timer_push(q, t); break; }
+		*slot = l->next;
+		q->nleases--;
+		cblu__free(l);
+	}
+}
+
+// Writes head/tail; caller holds txn_mu (and usually a transaction)
+static bool write_meta(CBLU_Queue* q, uint64_t head, uint64_t tail, CBLError* err) {
+	char id[256];
+	meta_id(q, id, sizeof id);
+	CBLDocument* doc = CBLDocument_CreateWithID(fl_from_c(id));
+	FLMutableDict props = CBLDocument_MutableProperties(doc);
+	FLMutableDict_SetUInt(props, FLSTR("head"), head);
+	FLMutableDict_SetUInt(props, FLSTR("tail"), tail);
+	bool ok = cblu__save_doc(&q->core, doc, err);
+	CBLDocument_Release(doc);
+	return ok;
+}
+
+// ---- Public API ----
+CBLU_Queue* cblu_queue_open(CBLU_Db* db, const char* name) {
+	if (!db || !name || !*name) return NULL;
+	CBLU_Queue* q = (CBLU_Queue*)cblu__calloc(CBLU_MEM_QUEUE, 1, sizeof *q);
+	if (!q) return NULL;
+	q->name     = cblu__strdup(CBLU_MEM_QUEUE, name);
+	q->nbuckets = CBLU_QUEUE_LEASE_BUCKETS;
+	q->leases   = (Lease**)cblu__calloc(CBLU_MEM_QUEUE, q->nbuckets, sizeof *q->leases);
+	if (!q->name || !q->leases || !cblu__sys_core(&db->core, CBLU_QUEUE_COLLECTION, &q->core)) {
+		cblu__free(q->name); cblu__free(q->leases); cblu__free(q); return NULL;
+	}
+	pthread_mutex_init(&q->mu, NULL);
+	pthread_mutex_init(&q->txn_mu, NULL);
+	q->low = 1;
+
+	// Rebuild the ready list from the persisted [head, tail] range
+	char id[256];
+	meta_id(q, id, sizeof id);
+	CBLError err = {0};
+	const CBLDocument* meta = CBLCollection_GetDocument(q->core.coll, fl_from_c(id), &err);
+	if (meta) {
+		FLDict p = CBLDocument_Properties(meta);
+		uint64_t head = FLValue_AsUnsigned(FLDict_Get(p, FLSTR("head")));
+		q->tail = FLValue_AsUnsigned(FLDict_Get(p, FLSTR("tail")));
+		q->low  = head ? head : 1;
+		CBLDocument_Release(meta);
+	}
+	q->head_saved = q->low;
+	for (uint64_t seq = q->low; seq <= q->tail; seq++) {
+		msg_id(q, seq, id, sizeof id);
+		const CBLDocument* doc = CBLCollection_GetDocument(q->core.coll, fl_from_c(id), &err);
+		if (doc) { CBLDocument_Release(doc); ready_push(q, seq, 0); }
+		else     mark_done(q, seq);
+	}
+	return q;
+}
+
+bool cblu_queue_enqueue(CBLU_Queue* q, const void* const* data, const size_t* sizes, size_t n) {
+	if (!q || (n && (!data || !sizes))) return false;
+	if (n == 0) return true;
+
+	pthread_mutex_lock(&q->txn_mu);
+	pthread_mutex_lock(&q->mu);
+	uint64_t first = q->tail + 1;
+	uint64_t head  = q->low;
+	bool room = ready_reserve(q, n);
+	pthread_mutex_unlock(&q->mu);
+	if (!room) { pthread_mutex_unlock(&q->txn_mu); return false; }
+
+	CBLError err = {0};
+	bool ok = cblu__begin_txn(&q->core, &err);
+	if (!ok) {
+		cblu__cbl_error("queue begin txn", err);
+		pthread_mutex_unlock(&q->txn_mu);
+		return false;
+	}
+	char id[256];
+	for (size_t i = 0; i < n && ok; i++) {
+		msg_id(q, first + i, id, sizeof id);
+		CBLDocument* doc = CBLDocument_CreateWithID(fl_from_c(id));
+		FLMutableDict_SetData(CBLDocument_MutableProperties(doc), FLSTR("data"),
+							  (FLSlice){ .buf = data[i], .size = data[i] ? sizes[i] : 0 });
+		ok = cblu__save_doc(&q->core, doc, &err);
+		CBLDocument_Release(doc);
+	}
+	if (ok) ok = write_meta(q, head, first + n - 1, &err);
+	if (!ok) cblu__cbl_error("queue enqueue", err);
+	CBLError err2 = {0};
+	if (!cblu__end_txn(&q->core, ok, &err2)) {
+		cblu__cbl_error("queue end txn", err2);
+		ok = false;
+	}
+
+	if (ok) {
+		pthread_mutex_lock(&q->mu);
+		for (size_t i = 0; i < n; i++) ready_push(q, first + i, 0); // capacity reserved above
+		q->tail = first + n - 1;
+		q->head_saved = head;
+		pthread_mutex_unlock(&q->mu);
+	}
+	pthread_mutex_unlock(&q->txn_mu);
+	return ok;
+}
+
+size_t cblu_queue_claim(CBLU_Queue* q, size_t max, uint32_t lease_ms, CBLU_QueueMsg* out) {
+	if (!q || !out || max == 0) return 0;
+	size_t n = 0;
+
+	pthread_mutex_lock(&q->mu);
+	uint64_t now = now_ns();
+	expire_leases(q, now);
+	while (n < max && q->rlen) {
+		Lease* l = (Lease*)cblu__calloc(CBLU_MEM_QUEUE, 1, sizeof *l);
+		if (!l) break;
+		ReadyItem it = ready_pop(q);
+		l->seq         = it.seq;
+		l->gen         = ++q->next_gen;
+		l->attempts    = it.attempts + 1;
+		l->deadline_ns = now + (uint64_t)lease_ms * 1000000ULL;
+		if (!timer_push(q, (LeaseTimer){ l->deadline_ns, l->seq, l->gen })) {
+			cblu__free(l);
+			q->rhead = (q->rhead + q->rcap - 1) % q->rcap; q->rlen++; // un-pop
+			break;
+		}
+		Lease** slot = &q->leases[l->seq & (q->nbuckets - 1)];
+		l->next = *slot; *slot = l;
+		if (++q->nleases > q->nbuckets * 2) lease_grow(q);
+		out[n++] = (CBLU_QueueMsg){ .seq = l->seq, .attempts = l->attempts, ._gen = l->gen };
+	}
+	pthread_mutex_unlock(&q->mu);
+
+	// Load bodies outside the lock; a missing body means it was acked under an expired lease
+	size_t kept = 0;
+	char id[256];
+	for (size_t i = 0; i < n; i++) {
+		CBLError err = {0};
+		msg_id(q, out[i].seq, id, sizeof id);
+		const CBLDocument* doc = CBLCollection_GetDocument(q->core.coll, fl_from_c(id), &err);
+		if (!doc) {
+			pthread_mutex_lock(&q->mu);
+			Lease** slot = lease_slot(q, out[i].seq);
+			if (*slot && (*slot)->gen == out[i]._gen) { Lease* l = *slot; *slot = l->next; q->nleases--; cblu__free(l); }
+			mark_done(q, out[i].seq);
+			pthread_mutex_unlock(&q->mu);
+			continue;
+		}
+		FLSlice body = FLValue_AsData(FLDict_Get(CBLDocument_Properties(doc), FLSTR("data")));
+		out[kept] = out[i];
+		out[kept].data = body.buf;
+		out[kept].size = body.size;
+		out[kept]._doc = doc;
+		kept++;
+	}
+	return kept;
+}
+
+bool cblu_queue_ack(CBLU_Queue* q, CBLU_QueueMsg* msgs, size_t n) {
+	if (!q || (n && !msgs)) return false;
+	bool all = true;
+
+	pthread_mutex_lock(&q->txn_mu);
+	CBLError err = {0};
+	bool began = cblu__begin_txn(&q->core, &err);
+	bool ok = began;
+	if (!began) cblu__cbl_error("queue begin txn", err);
+
+	char id[256];
+	for (size_t i = 0; i < n && ok; i++) {
+		pthread_mutex_lock(&q->mu);
+		Lease* l = *lease_slot(q, msgs[i].seq);
+		bool mine = l && l->gen == msgs[i]._gen;
+		pthread_mutex_unlock(&q->mu);
+		if (!mine) { all = false; msgs[i]._gen = 0; continue; } // lease lost to another consumer
+		msg_id(q, msgs[i].seq, id, sizeof id);
+		ok = CBLCollection_PurgeDocumentByID(q->core.coll, fl_from_c(id), &err);
+		if (!ok && err.domain == kCBLDomain && err.code == kCBLErrorNotFound) { ok = true; err = (CBLError){0}; }  // acked already
+		if (!ok) cblu__cbl_error("queue ack", err);
+	}
+	if (began) {
+		CBLError err2 = {0};
+		if (!cblu__end_txn(&q->core, ok, &err2)) {
+			cblu__cbl_error("queue end txn", err2);
+			ok = false;
+		}
+	}
+
+	pthread_mutex_lock(&q->mu);
+	for (size_t i = 0; i < n; i++) {
+		if (ok && msgs[i]._gen) {
+			// Done only if our lease is still the current one. If it expired meanwhile, the
+			// message is ready or leased again; that claim finds the body gone and marks it.
+			Lease** slot = lease_slot(q, msgs[i].seq);
+			if (*slot && (*slot)->gen == msgs[i]._gen) {
+				Lease* l = *slot; *slot = l->next; q->nleases--; cblu__free(l);
+				mark_done(q, msgs[i].seq);
+			}
+		}
+		if (msgs[i]._doc) { CBLDocument_Release((const CBLDocument*)msgs[i]._doc); msgs[i]._doc = NULL; }
+		msgs[i].data = NULL; msgs[i].size = 0;
+	}
+	uint64_t head = q->low, tail = q->tail;
+	bool save_head = head - q->head_saved >= CBLU_QUEUE_HEAD_LAG;
+	pthread_mutex_unlock(&q->mu);
+
+	// Keep the recovery scan short without writing the meta doc on every ack
+	if (save_head) {
+		CBLError merr = {0};
+		if (write_meta(q, head, tail, &merr)) q->head_saved = head;
+		else cblu__cbl_error("queue meta save", merr);
+	}
+	pthread_mutex_unlock(&q->txn_mu);
+	return ok && all;
+}
+
+void cblu_queue_nack(CBLU_Queue* q, CBLU_QueueMsg* msgs, size_t n) {
+	if (!q || !msgs) return;
+	pthread_mutex_lock(&q->mu);
+	for (size_t i = 0; i < n; i++) {
+		Lease** slot = lease_slot(q, msgs[i].seq);
+		Lease* l = *slot;
+		if (l && l->gen == msgs[i]._gen && ready_push(q, l->seq, l->attempts)) {
+			*slot = l->next; q->nleases--; cblu__free(l);
+		}
+		if (msgs[i]._doc) { CBLDocument_Release((const CBLDocument*)msgs[i]._doc); msgs[i]._doc = NULL; }
+		msgs[i].data = NULL; msgs[i].size = 0;
+	}
+	pthread_mutex_unlock(&q->mu);
+}
+
+size_t cblu_queue_size(CBLU_Queue* q) {
+	if (!q) return 0;
+	pthread_mutex_lock(&q->mu);
+	size_t n = q->rlen + q->nleases;
+	pthread_mutex_unlock(&q->mu);
+	return n;
+}
+
+void cblu_queue_close(CBLU_Queue* q) {
+	if (!q) return;
+	pthread_mutex_lock(&q->txn_mu);
+	if (q->low != q->head_saved) {
+		CBLError err = {0};
+		if (!write_meta(q, q->low, q->tail, &err))
+			cblu__cbl_error("queue meta save", err);
+	}
+	pthread_mutex_unlock(&q->txn_mu);
+	for (size_t i = 0; i < q->nbuckets; i++) {
+		Lease* l = q->leases[i];
+		while (l) { Lease* next = l->next; cblu__free(l); l = next; }
+	}
+	cblu__free(q->leases);
+	cblu__free(q->timers);
+	cblu__free(q->ready);
+	cblu__free(q->done);
+	cblu__free(q->name);
+	CBLCollection_Release(q->core.coll);
+	pthread_mutex_destroy(&q->txn_mu);
+	pthread_mutex_destroy(&q->mu);
+	cblu__free(q);
+}
@@ -0,0 +1,110 @@
+//
+//  CBLiteC_record.c
+//
+//  Opt-in operation trace. While recording, the document, session and query
+//  entry points append one small record each (layout in CBLiteC.h) to a 64 KiB
+//  buffer that is written out when full. Calls from all threads are ordered by
+//  one mutex; when recording is off the cost is a relaxed atomic load.
+//
+//  Values are not recorded, only their kind and size, so traces carry no
+//  payload data and stay a few dozen bytes per call.
+//
+
+#include "CBLiteC_internal.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define CBLU_REC_BUF      (64 * 1024)
+#define CBLU_REC_MAX_STR  4096   // longer strings (N1QL) are truncated
+#define CBLU_REC_MAGIC    "CBLUREC1"
+
+_Atomic bool cblu__rec_on;
+
+static pthread_mutex_t g_rec_mu = PTHREAD_MUTEX_INITIALIZER;
+static int             g_rec_fd = -1;
+static bool            g_rec_ok;
+static uint64_t        g_rec_last_ns;
+static size_t          g_rec_len;
+static uint8_t         g_rec_buf[CBLU_REC_BUF];
+
+static bool rec_write(const uint8_t* p, size_t n) {
+	while (n > 0) {
+		ssize_t w = write(g_rec_fd, p, n);
+		if (w < 0 && errno == EINTR) continue;
+		if (w < 0) {
+			cblu__posix_error("record write", errno);
+			return false;
+		}
+		p += w;
+		n -= (size_t)w;
+	}
+	return true;
+}
+
+static void rec_flush(void) {
+	if (g_rec_len && g_rec_ok) g_rec_ok = rec_write(g_rec_buf, g_rec_len);
+	g_rec_len = 0;
+}
+
+static inline void put_u8(uint8_t v) { g_rec_buf[g_rec_len++] = v; }
+
+static inline void put_varint(uint64_t v) {
+	while (v >= 0x80) { put_u8((uint8_t)(v | 0x80)); v >>= 7; }
+	put_u8((uint8_t)v);
+}
+
+void cblu__rec(CBLU_RecOp op, const void* h, uint64_t a, const char* s, uint64_t b) {
+	size_t slen = s ? strlen(s) : 0;
+	if (slen > CBLU_REC_MAX_STR) slen = CBLU_REC_MAX_STR;
+	uint64_t now = cblu__now_ns();
+	pthread_mutex_lock(&g_rec_mu);
+	if (g_rec_fd < 0) { pthread_mutex_unlock(&g_rec_mu); return; }  // stopped after the caller checked
+	if (g_rec_len + 1 + 5 * 10 + slen > CBLU_REC_BUF) rec_flush();
+	uint64_t dt = now > g_rec_last_ns ? now - g_rec_last_ns : 0;
+	g_rec_last_ns = now;
+	put_u8((uint8_t)op);
+	put_varint(dt);
+	put_varint((uint64_t)(uintptr_t)h);
+	put_varint(a);
+	put_varint(slen);
+	if (slen) memcpy(g_rec_buf + g_rec_len, s, slen);
+	g_rec_len += slen;
+	put_varint(b);
+	pthread_mutex_unlock(&g_rec_mu);
+}
+
+// ---- Public API ----
+bool cblu_record_start(const char* path) {
+	if (!path) return false;
+	pthread_mutex_lock(&g_rec_mu);
+	if (g_rec_fd >= 0) { pthread_mutex_unlock(&g_rec_mu); return false; }
+	int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		cblu__posix_error("record open", errno);
+		pthread_mutex_unlock(&g_rec_mu);
+		return false;
+	}
+	g_rec_fd = fd;
+	g_rec_ok = rec_write((const uint8_t*)CBLU_REC_MAGIC, sizeof CBLU_REC_MAGIC - 1);
+	g_rec_len = 0;
+	g_rec_last_ns = cblu__now_ns();
+	atomic_store_explicit(&cblu__rec_on, true, memory_order_release);
+	pthread_mutex_unlock(&g_rec_mu);
+	return g_rec_ok;
+}
+
+bool cblu_record_stop(void) {
+	pthread_mutex_lock(&g_rec_mu);
+	if (g_rec_fd < 0) { pthread_mutex_unlock(&g_rec_mu); return false; }
+	atomic_store_explicit(&cblu__rec_on, false, memory_order_relaxed);
+	rec_flush();
+	bool ok = g_rec_ok;
+	if (ok && fsync(g_rec_fd) != 0) ok = false;
+	if (close(g_rec_fd) != 0) ok = false;
+	g_rec_fd = -1;
+	pthread_mutex_unlock(&g_rec_mu);
+	return ok;
+}
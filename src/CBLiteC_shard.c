@@ -0,0 +1,384 @@
+//
+//  CBLiteC_shard.c
+//
+//  Sharded database: N independent database files "<name>.<i>", doc IDs routed
+//  by hash. Each shard has its own writer thread that saves submitted
+//  documents in batched transactions, so writers scale past one file's lock.
+//  Multi-get and queries scatter to every involved shard in parallel, running
+//  as tasks on those same writer threads (ahead of queued writes).
+//
+
+#include "CBLiteC_internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#define CBLU_SHARD_MAX          256
+#define CBLU_SHARD_BATCH        512    // docs per writer transaction
+#define CBLU_SHARD_QUEUE_LIMIT  8192   // pending docs per shard before submit blocks
+#define CBLU_SHARD_META_COLL    "shards"       // in shard 0's CBLU_SYS_SCOPE
+#define CBLU_SHARD_META_ID      "cblu.shards"
+
+// A read job handed to a shard's thread; the caller owns it and waits for done
+typedef struct ShardTask {
+	struct ShardTask* next;
+	void            (*fn)(void* arg);
+	void*             arg;
+	bool              done;
+} ShardTask;
+
+typedef struct {
+	CBLU_Db*        db;
+	pthread_t       thread;
+	bool            has_thread;
+	pthread_mutex_t mu;
+	pthread_cond_t  work_cv;     // writer waits for docs
+	pthread_cond_t  done_cv;     // submitters/flushers wait for progress
+	CBLU_DocW**     pending;
+	size_t          npending, cap;
+	CBLU_DocW**     batch;       // writer's scratch, CBLU_SHARD_BATCH entries
+	ShardTask*      tasks;       // FIFO of read jobs
+	ShardTask*      tasks_tail;
+	uint64_t        submitted, completed;
+	uint64_t        failed;      // saves failed since the last flush
+	bool            stop;
+} Shard;
+
+struct CBLU_ShardedDb {
+	unsigned nshards;
+	Shard*   shards;
+};
+
+static uint64_t fnv1a(const char* s) {
+	uint64_t h = 1469598103934665603ULL;
+	for (; *s; s++) { h ^= (uint8_t)*s; h *= 1099511628211ULL; }
+	return h;
+}
+
+// ---- Writer thread ----
+static void shard_write_batch(Shard* sh, CBLU_DocW** docs, size_t n) {
+	CBLError err = {0};
+	bool txn = cblu__begin_txn(&sh->db->core, &err);
+	if (!txn) cblu__cbl_error("shard begin txn", err);
+	uint64_t failed = 0;
+	for (size_t i = 0; i < n; i++) {
+		// cblu_docw_save frees the handle whether or not it succeeds
+		if (!cblu_docw_save(docs[i])) failed++;
+	}
+	if (txn) {
+		err = (CBLError){0};
+		if (!cblu__end_txn(&sh->db->core, true, &err)) {
+			cblu__cbl_error("shard commit", err);
+			failed = n;
+		}
+	}
+	pthread_mutex_lock(&sh->mu);
+	sh->completed += n;
+	sh->failed    += failed;
+	pthread_cond_broadcast(&sh->done_cv);
+	pthread_mutex_unlock(&sh->mu);
+}
+
+static void* shard_writer(void* arg) {
+	Shard* sh = (Shard*)arg;
+	CBLU_DocW** batch = sh->batch;
+	pthread_mutex_lock(&sh->mu);
+	for (;;) {
+		while (!sh->stop && sh->npending == 0 && !sh->tasks) pthread_cond_wait(&sh->work_cv, &sh->mu);
+		if (sh->tasks) {
+			ShardTask* t = sh->tasks;
+			sh->tasks = t->next;
+			if (!sh->tasks) sh->tasks_tail = NULL;
+			pthread_mutex_unlock(&sh->mu);
+			t->fn(t->arg);
+			pthread_mutex_lock(&sh->mu);
+			t->done = true;
+			pthread_cond_broadcast(&sh->done_cv);
+			continue;
+		}
+		if (sh->npending == 0) break; // stop requested and drained
+		size_t n = sh->npending < CBLU_SHARD_BATCH ? sh->npending : CBLU_SHARD_BATCH;
+		memcpy(batch, sh->pending, n * sizeof *batch);
+		memmove(sh->pending, sh->pending + n, (sh->npending - n) * sizeof *batch);
+		sh->npending -= n;
+		pthread_cond_broadcast(&sh->done_cv); // room for blocked submitters
+		pthread_mutex_unlock(&sh->mu);
+		shard_write_batch(sh, batch, n);
+		pthread_mutex_lock(&sh->mu);
+	}
+	pthread_mutex_unlock(&sh->mu);
+	return NULL;
+}
+
+static void shard_task_post(Shard* sh, ShardTask* t) {
+	t->next = NULL;
+	t->done = false;
+	pthread_mutex_lock(&sh->mu);
+	if (sh->tasks_tail) sh->tasks_tail->next = t;
+	else                sh->tasks = t;
+	sh->tasks_tail = t;
+	pthread_cond_signal(&sh->work_cv);
+	pthread_mutex_unlock(&sh->mu);
+}
+
+static void shard_task_wait(Shard* sh, ShardTask* t) {
+	pthread_mutex_lock(&sh->mu);
+	while (!t->done) pthread_cond_wait(&sh->done_cv, &sh->mu);
+	pthread_mutex_unlock(&sh->mu);
+}
+
+// Records (or checks) the shard count, since routing depends on it. Kept in an
+// internal collection so shard 0's queries, export and changes never see it.
+static bool shard_check_meta(CBLU_Db* db0, unsigned nshards) {
+	CBLU_Core mc;
+	if (!cblu__sys_core(&db0->core, CBLU_SHARD_META_COLL, &mc)) return false;
+	CBLError err = {0};
+	bool ok;
+	const CBLDocument* doc = CBLCollection_GetDocument(mc.coll, FLSTR(CBLU_SHARD_META_ID), &err);
+	if (doc) {
+		uint64_t n = FLValue_AsUnsigned(FLDict_Get(CBLDocument_Properties(doc), FLSTR("nshards")));
+		CBLDocument_Release(doc);
+		ok = (n == nshards);
+		if (!ok) cblu__wrapper_error("shards open", CBLU_ERR_MISMATCH);  // nshards differs from creation
+	} else {
+		CBLDocument* meta = CBLDocument_CreateWithID(FLSTR(CBLU_SHARD_META_ID));
+		FLMutableDict_SetUInt(CBLDocument_MutableProperties(meta), FLSTR("nshards"), nshards);
+		ok = cblu__save_doc(&mc, meta, &err);
+		CBLDocument_Release(meta);
+		if (!ok) cblu__cbl_error("shards meta save", err);
+	}
+	CBLCollection_Release(mc.coll);
+	return ok;
+}
+
+// ---- Lifecycle ----
+bool cblu_shards_open(const char* db_name, const char* dir, unsigned nshards, CBLU_ShardedDb** out) {
+	if (!db_name || !out || nshards == 0 || nshards > CBLU_SHARD_MAX) return false;
+	*out = NULL;
+	CBLU_ShardedDb* s = (CBLU_ShardedDb*)cblu__calloc(CBLU_MEM_SHARDS, 1, sizeof *s);
+	if (!s) return false;
+	s->shards = (Shard*)cblu__calloc(CBLU_MEM_SHARDS, nshards, sizeof *s->shards);
+	if (!s->shards) { cblu__free(s); return false; }
+
+	char name[512];
+	bool ok = true;
+	for (unsigned i = 0; i < nshards && ok; i++) {
+		Shard* sh = &s->shards[i];
+		snprintf(name, sizeof name, "%s.%u", db_name, i);
+		ok = cblu_open(name, dir, &sh->db);
+		if (!ok) break;
+		s->nshards = i + 1;
+		pthread_mutex_init(&sh->mu, NULL);
+		pthread_cond_init(&sh->work_cv, NULL);
+		pthread_cond_init(&sh->done_cv, NULL);
+		sh->batch = (CBLU_DocW**)cblu__malloc(CBLU_MEM_SHARDS, CBLU_SHARD_BATCH * sizeof *sh->batch);
+		if (!sh->batch) ok = false;
+		else if (pthread_create(&sh->thread, NULL, shard_writer, sh) != 0) {
+			cblu__wrapper_error("shard writer thread", CBLU_ERR_THREAD);
+			ok = false;
+		}
+		else sh->has_thread = true;
+	}
+	if (ok) ok = shard_check_meta(s->shards[0].db, nshards);
+	if (!ok) { cblu_shards_close(s); return false; }
+	*out = s;
+	return true;
+}
+
+void cblu_shards_close(CBLU_ShardedDb* s) {
+	if (!s) return;
+	for (unsigned i = 0; i < s->nshards; i++) {
+		Shard* sh = &s->shards[i];
+		if (sh->has_thread) {
+			pthread_mutex_lock(&sh->mu);
+			sh->stop = true;
+			pthread_cond_signal(&sh->work_cv);
+			pthread_mutex_unlock(&sh->mu);
+			pthread_join(sh->thread, NULL); // drains pending docs first
+		}
+		for (size_t j = 0; j < sh->npending; j++) cblu_docw_free(sh->pending[j]);
+		cblu__free(sh->pending);
+		cblu__free(sh->batch);
+		pthread_cond_destroy(&sh->done_cv);
+		pthread_cond_destroy(&sh->work_cv);
+		pthread_mutex_destroy(&sh->mu);
+		cblu_close(sh->db);
+	}
+	cblu__free(s->shards);
+	cblu__free(s);
+}
+
+unsigned cblu_shards_count(CBLU_ShardedDb* s) {
+	return s ? s->nshards : 0;
+}
+
+unsigned cblu_shards_route(CBLU_ShardedDb* s, const char* key) {
+	if (!s || !key) return 0;
+	return (unsigned)(fnv1a(key) % s->nshards);
+}
+
+CBLU_Db* cblu_shards_db(CBLU_ShardedDb* s, unsigned shard) {
+	if (!s || shard >= s->nshards) return NULL;
+	return s->shards[shard].db;
+}
+
+// ---- Writes ----
+CBLU_DocW* cblu_shards_docw_begin(CBLU_ShardedDb* s, const char* doc_id, const char* route_key) {
+	if (!s || !doc_id) return NULL;
+	unsigned k = cblu_shards_route(s, route_key ? route_key : doc_id);
+	Shard* sh = &s->shards[k];
+	CBLU_DocW* d = (CBLU_DocW*)cblu__calloc(CBLU_MEM_DOC, 1, sizeof *d);
+	if (!d) return NULL;
+	d->core  = sh->db->core;
+	d->shard = k + 1;
+	d->doc   = CBLDocument_CreateWithID(fl_from_c(doc_id));
+	d->props = CBLDocument_MutableProperties(d->doc);
+	return d;
+}
+
+bool cblu_shards_submit(CBLU_ShardedDb* s, CBLU_DocW* d) {
+	if (!s || !d) return false;
+	// Only cblu_shards_docw_begin handles on this set: others aren't routed by
+	// doc ID, and a session's handle would outlive its session on the writer
+	if (d->shard == 0 || d->shard > s->nshards || d->core.db != s->shards[d->shard - 1].db->core.db) {
+		cblu__wrapper_error("shards submit", CBLU_ERR_INVALID);
+		return false;
+	}
+	Shard* sh = &s->shards[d->shard - 1];
+
+	pthread_mutex_lock(&sh->mu);
+	while (sh->npending >= CBLU_SHARD_QUEUE_LIMIT) pthread_cond_wait(&sh->done_cv, &sh->mu);
+	if (sh->npending == sh->cap) {
+		size_t cap = sh->cap ? sh->cap * 2 : 256;
+		CBLU_DocW** p = (CBLU_DocW**)cblu__realloc(CBLU_MEM_SHARDS, sh->pending, cap * sizeof *p);
+		if (!p) { pthread_mutex_unlock(&sh->mu); return false; }
+		sh->pending = p; sh->cap = cap;
+	}
+	sh->pending[sh->npending++] = d;
+	sh->submitted++;
+	pthread_cond_signal(&sh->work_cv);
+	pthread_mutex_unlock(&sh->mu);
+	return true;
+}
+
+bool cblu_shards_flush(CBLU_ShardedDb* s) {
+	if (!s) return false;
+	bool ok = true;
+	for (unsigned i = 0; i < s->nshards; i++) {
+		Shard* sh = &s->shards[i];
+		pthread_mutex_lock(&sh->mu);
+		uint64_t target = sh->submitted;
+		while (sh->completed < target) pthread_cond_wait(&sh->done_cv, &sh->mu);
+		if (sh->failed) { ok = false; sh->failed = 0; }
+		pthread_mutex_unlock(&sh->mu);
+	}
+	return ok;
+}
+
+// ---- Scatter-gather ----
+typedef struct {
+	Shard*             sh;
+	const char* const* ids;
+	size_t             n;
+	CBLU_DocR**        out;
+	const unsigned*    route;
+	unsigned           index;
+	size_t             found;
+} GetJob;
+
+static void shard_get_job(void* arg) {
+	GetJob* j = (GetJob*)arg;
+	for (size_t i = 0; i < j->n; i++) {
+		if (j->route[i] != j->index) continue;
+		CBLError err = {0};
+		const CBLDocument* doc = CBLCollection_GetDocument(j->sh->db->core.coll, fl_from_c(j->ids[i]), &err);
+		if (!doc) continue;
+		CBLU_DocR* d = (CBLU_DocR*)cblu__calloc(CBLU_MEM_DOC, 1, sizeof *d);
+		if (!d) { CBLDocument_Release(doc); continue; }
+		d->core  = j->sh->db->core;
+		d->doc   = doc;
+		d->props = CBLDocument_Properties(doc);
+		j->out[i] = d;
+		j->found++;
+	}
+}
+
+size_t cblu_shards_get_many(CBLU_ShardedDb* s, const char* const* ids, size_t n, CBLU_DocR** out) {
+	if (!s || !ids || !out) return 0;
+	unsigned* route = (unsigned*)cblu__malloc(CBLU_MEM_SHARDS, (n ? n : 1) * sizeof *route);
+	GetJob* jobs = (GetJob*)cblu__calloc(CBLU_MEM_SHARDS, s->nshards, sizeof *jobs);
+	ShardTask* tasks = (ShardTask*)cblu__calloc(CBLU_MEM_SHARDS, s->nshards, sizeof *tasks);
+	bool* posted = (bool*)cblu__calloc(CBLU_MEM_SHARDS, s->nshards, sizeof *posted);
+	if (!route || !jobs || !tasks || !posted) { cblu__free(route); cblu__free(jobs); cblu__free(tasks); cblu__free(posted); return 0; }
+
+	for (size_t i = 0; i < n; i++) { out[i] = NULL; route[i] = ids[i] ? cblu_shards_route(s, ids[i]) : UINT32_MAX; }
+
+	for (unsigned k = 0; k < s->nshards; k++) {
+		jobs[k] = (GetJob){ .sh = &s->shards[k], .ids = ids, .n = n, .out = out, .route = route, .index = k };
+		bool any = false;
+		for (size_t i = 0; i < n && !any; i++) any = (route[i] == k);
+		if (!any) continue;
+		// Every shard reads on its own writer thread, between batches, so no shard
+		// shows documents of a batch transaction that hasn't committed yet
+		tasks[k] = (ShardTask){ .fn = shard_get_job, .arg = &jobs[k] };
+		shard_task_post(&s->shards[k], &tasks[k]);
+		posted[k] = true;
+	}
+	size_t found = 0;
+	for (unsigned k = 0; k < s->nshards; k++) {
+		if (posted[k]) shard_task_wait(&s->shards[k], &tasks[k]);
+		found += jobs[k].found;
+	}
+	cblu__free(route); cblu__free(jobs); cblu__free(tasks); cblu__free(posted);
+	return found;
+}
+
+typedef struct {
+	Shard*          sh;
+	unsigned        index;
+	const char*     n1ql;
+	CBLU_ShardRowFn fn;
+	void*           ctx;
+	pthread_mutex_t* gather_mu;
+	bool*           stop;
+	bool            ok;
+} QueryJob;
+
+static void shard_query_job(void* arg) {
+	QueryJob* j = (QueryJob*)arg;
+	CBLU_Query* q = cblu__query_open(&j->sh->db->core, j->n1ql);
+	if (!q) { j->ok = false; return; }
+	while (cblu_query_next(q)) {
+		pthread_mutex_lock(j->gather_mu);
+		bool go = !*j->stop && j->fn(j->ctx, j->index, q);
+		if (!go) *j->stop = true;
+		pthread_mutex_unlock(j->gather_mu);
+		if (!go) break;
+	}
+	cblu_query_free(q);
+	j->ok = true;
+}
+
+bool cblu_shards_query(CBLU_ShardedDb* s, const char* n1ql, CBLU_ShardRowFn fn, void* ctx) {
+	if (!s || !n1ql || !fn) return false;
+	QueryJob* jobs = (QueryJob*)cblu__calloc(CBLU_MEM_SHARDS, s->nshards, sizeof *jobs);
+	ShardTask* tasks = (ShardTask*)cblu__calloc(CBLU_MEM_SHARDS, s->nshards, sizeof *tasks);
+	if (!jobs || !tasks) { cblu__free(jobs); cblu__free(tasks); return false; }
+
+	pthread_mutex_t gather_mu = PTHREAD_MUTEX_INITIALIZER;
+	bool stop = false;
+	for (unsigned k = 0; k < s->nshards; k++) {
+		jobs[k] = (QueryJob){ .sh = &s->shards[k], .index = k, .n1ql = n1ql, .fn = fn, .ctx = ctx,
+							  .gather_mu = &gather_mu, .stop = &stop };
+		tasks[k] = (ShardTask){ .fn = shard_query_job, .arg = &jobs[k] };
+		shard_task_post(&s->shards[k], &tasks[k]);
+	}
+	bool ok = true;
+	for (unsigned k = 0; k < s->nshards; k++) {
+		shard_task_wait(&s->shards[k], &tasks[k]);
+		ok = ok && jobs[k].ok;
+	}
+	pthread_mutex_destroy(&gather_mu);
+	cblu__free(jobs); cblu__free(tasks);
+	return ok;
+}
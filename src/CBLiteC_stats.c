@@ -0,0 +1,204 @@
+//
+//  CBLiteC_stats.c
+//
+//  Per-operation call/error counts and latency histograms. Each thread records
+//  into its own shard (single writer, relaxed atomics, no locks or shared cache
+//  lines); cblu_stats_snapshot merges the shards on demand. Shards of exited
+//  threads are folded into a retired total so no samples are lost.
+//
+//  Histogram buckets are log-linear: exact below 8 ns, then 8 buckets per power
+//  of two (≤12.5% relative error) up to 2^40 ns; larger values land in the last.
+//
+
+#include "CBLiteC_internal.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define STATS_SUB_BITS 3
+#define STATS_SUB      (1u << STATS_SUB_BITS)
+#define STATS_MAX_EXP  40
+
+_Static_assert(CBLU_STATS_BUCKETS == (STATS_MAX_EXP - STATS_SUB_BITS + 2) * STATS_SUB,
+			   "CBLU_STATS_BUCKETS doesn't match the bucket layout");
+
+typedef struct {
+	_Atomic uint64_t calls, errors, sum_ns, max_ns;
+	_Atomic uint64_t buckets[CBLU_STATS_BUCKETS];
+} ShardOp;
+
+typedef struct StatsShard {
+	ShardOp            op[CBLU_OP_COUNT];
+	struct StatsShard* next;
+	struct StatsShard* prev;
+} StatsShard;
+
+static pthread_mutex_t   g_stats_mu = PTHREAD_MUTEX_INITIALIZER;
+static StatsShard*       g_shards;        // live threads
+static CBLU_Stats        g_retired;       // sum of exited threads' shards
+static pthread_key_t     g_stats_key;
+static pthread_once_t    g_stats_once = PTHREAD_ONCE_INIT;
+static _Thread_local StatsShard* t_shard;
+static _Thread_local bool        t_retired;  // shard already folded at thread exit
+
+static const char* const kOpNames[CBLU_OP_COUNT] = {
+	"open", "save", "get", "blob_read", "blob_write", "commit", "rollback", "query",
+};
+
+static inline unsigned bucket_of(uint64_t ns) {
+	if (ns < STATS_SUB) return (unsigned)ns;
+	unsigned exp = 63u - (unsigned)__builtin_clzll(ns);
+	if (exp > STATS_MAX_EXP) return CBLU_STATS_BUCKETS - 1;
+	return (exp - STATS_SUB_BITS + 1) * STATS_SUB + (unsigned)((ns >> (exp - STATS_SUB_BITS)) & (STATS_SUB - 1));
+}
+
+uint64_t cblu_stats_bucket_upper_ns(unsigned i) {
+	if (i >= CBLU_STATS_BUCKETS) return UINT64_MAX;
+	if (i < STATS_SUB) return i;
+	unsigned exp = i / STATS_SUB + STATS_SUB_BITS - 1, sub = i % STATS_SUB;
+	if (i == CBLU_STATS_BUCKETS - 1) return UINT64_MAX;
+	return ((uint64_t)(STATS_SUB + sub + 1) << (exp - STATS_SUB_BITS)) - 1;
+}
+
+// Adds a shard into an accumulated snapshot
+static void shard_fold(CBLU_Stats* dst, const StatsShard* s) {
+	for (int o = 0; o < CBLU_OP_COUNT; o++) {
+		const ShardOp* so = &s->op[o];
+		CBLU_OpStats*  d  = &dst->op[o];
+		d->calls  += atomic_load_explicit(&so->calls,  memory_order_relaxed);
+		d->errors += atomic_load_explicit(&so->errors, memory_order_relaxed);
+		d->sum_ns += atomic_load_explicit(&so->sum_ns, memory_order_relaxed);
+		uint64_t mx = atomic_load_explicit(&so->max_ns, memory_order_relaxed);
+		if (mx > d->max_ns) d->max_ns = mx;
+		for (unsigned b = 0; b < CBLU_STATS_BUCKETS; b++)
+			d->buckets[b] += atomic_load_explicit(&so->buckets[b], memory_order_relaxed);
+	}
+}
+
+static void shard_retire(void* arg) {
+	StatsShard* s = (StatsShard*)arg;
+	pthread_mutex_lock(&g_stats_mu);
+	shard_fold(&g_retired, s);
+	if (s->prev) s->prev->next = s->next; else g_shards = s->next;
+	if (s->next) s->next->prev = s->prev;
+	pthread_mutex_unlock(&g_stats_mu);
+	// Other TLS destructors may still record on this thread; they go straight to g_retired
+	t_shard   = NULL;
+	t_retired = true;
+	cblu__free(s);
+}
+
+static void stats_init(void) {
+	pthread_key_create(&g_stats_key, shard_retire);
+}
+
+static StatsShard* shard_get(void) {
+	if (t_shard) return t_shard;
+	if (t_retired) return NULL;
+	pthread_once(&g_stats_once, stats_init);
+	StatsShard* s = (StatsShard*)cblu__calloc(CBLU_MEM_STATS, 1, sizeof *s);
+	if (!s) return NULL;
+	pthread_mutex_lock(&g_stats_mu);
+	s->next = g_shards;
+	if (g_shards) g_shards->prev = s;
+	g_shards = s;
+	pthread_mutex_unlock(&g_stats_mu);
+	pthread_setspecific(g_stats_key, s);
+	t_shard = s;
+	return s;
+}
+
+// Only the owning thread writes its shard, so plain load+store is enough
+static inline void bump(_Atomic uint64_t* a, uint64_t v) {
+	atomic_store_explicit(a, atomic_load_explicit(a, memory_order_relaxed) + v, memory_order_relaxed);
+}
+
+uint64_t cblu__now_ns(void) {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint64_t)t.tv_sec * 1000000000ull + (uint64_t)t.tv_nsec;
+}
+
+void cblu__stats_record(CBLU_Op op, uint64_t t0, bool ok) {
+	uint64_t ns = cblu__now_ns() - t0;
+	if ((unsigned)op >= CBLU_OP_COUNT) return;
+	StatsShard* s = shard_get();
+	if (!s) {
+		if (t_retired) {  // exiting thread: rare, so the lock is fine
+			CBLU_OpStats* d = &g_retired.op[op];
+			pthread_mutex_lock(&g_stats_mu);
+			d->calls++;
+			if (!ok) d->errors++;
+			d->sum_ns += ns;
+			if (ns > d->max_ns) d->max_ns = ns;
+			d->buckets[bucket_of(ns)]++;
+			pthread_mutex_unlock(&g_stats_mu);
+		}
+		return;
+	}
+	ShardOp* so = &s->op[op];
+	bump(&so->calls, 1);
+	if (!ok) bump(&so->errors, 1);
+	bump(&so->sum_ns, ns);
+	if (ns > atomic_load_explicit(&so->max_ns, memory_order_relaxed))
+		atomic_store_explicit(&so->max_ns, ns, memory_order_relaxed);
+	bump(&so->buckets[bucket_of(ns)], 1);
+}
+
+bool cblu__begin_txn(const CBLU_Core* core, CBLError* err) {
+	cblu__write_lock(core);
+	CBLU_TRACE0(txn_begin_entry);
+	bool ok = CBLDatabase_BeginTransaction(core->db, err);
+	CBLU_TRACE3(txn_begin_return, (int)ok, (int)err->domain, (int)err->code);
+	if (!ok) cblu__write_unlock(core);
+	return ok;
+}
+
+// Unlocks whether or not EndTransaction succeeded: the transaction is over either way
+bool cblu__end_txn(const CBLU_Core* core, bool commit, CBLError* err) {
+	CBLU_TRACE1(txn_end_entry, (int)commit);
+	uint64_t t0 = cblu__now_ns();
+	bool ok = CBLDatabase_EndTransaction(core->db, commit, err);
+	cblu__stats_record(commit ? CBLU_OP_COMMIT : CBLU_OP_ROLLBACK, t0, ok);
+	CBLU_TRACE4(txn_end_return, (int)commit, (int)ok, (int)err->domain, (int)err->code);
+	cblu__write_unlock(core);
+	return ok;
+}
+
+bool cblu__save_doc(const CBLU_Core* core, CBLDocument* doc, CBLError* err) {
+	cblu__write_lock(core);
+	bool ok = CBLCollection_SaveDocument(core->coll, doc, err);
+	cblu__write_unlock(core);
+	return ok;
+}
+
+// ---- Public API ----
+void cblu_stats_snapshot(CBLU_Stats* out) {
+	if (!out) return;
+	pthread_mutex_lock(&g_stats_mu);
+	*out = g_retired;
+	for (const StatsShard* s = g_shards; s; s = s->next) shard_fold(out, s);
+	pthread_mutex_unlock(&g_stats_mu);
+}
+
+const char* cblu_stats_op_name(CBLU_Op op) {
+	return (unsigned)op < CBLU_OP_COUNT ? kOpNames[op] : "unknown";
+}
+
+uint64_t cblu_stats_percentile_ns(const CBLU_OpStats* s, double p) {
+	if (!s || !s->calls) return 0;
+	if (p < 0) p = 0;
+	if (p > 100) p = 100;
+	uint64_t want = (uint64_t)(p / 100.0 * (double)s->calls + 0.999999);
+	if (want == 0) want = 1;
+	uint64_t seen = 0;
+	for (unsigned b = 0; b < CBLU_STATS_BUCKETS; b++) {
+		seen += s->buckets[b];
+		if (seen >= want) {
+			uint64_t v = cblu_stats_bucket_upper_ns(b);
+			return v < s->max_ns ? v : s->max_ns;
+		}
+	}
+	return s->max_ns;
+}
@@ -0,0 +1,57 @@
+//
+//  CBLiteC_trace.h
+//
+//  Static tracepoints (USDT, provider "cblu") at entry and exit of the wrapper's
+//  I/O paths. Compiled in whenever <sys/sdt.h> is available (Linux:
+//  systemtap-sdt-dev): each probe is a single nop plus an ELF note, so it costs
+//  nothing until perf or bpftrace attaches. -DCBLU_NO_USDT (make USDT=0) leaves
+//  them out; then the macros expand to nothing and their arguments are not
+//  evaluated. -DCBLU_USDT forces them in, failing the build without the header.
+//
+//  The library is static, so the probes live in the binary that links it:
+//
+//    bpftrace -e 'usdt:./myapp:cblu:save_return /arg1 == 0/ { @codes[arg3] = count(); }'
+//    perf buildid-cache --add ./myapp && perf record -e sdt_cblu:get_entry -e sdt_cblu:get_return -ag
+//
+//  Probes (arguments in order; err_* are 0 on success):
+//    save_entry       id_len
+//    save_return      id_len, ok, err_domain, err_code
+//    get_entry        id_len
+//    get_return       id_len, found, err_domain, err_code
+//    txn_begin_entry
+//    txn_begin_return ok, err_domain, err_code
+//    txn_end_entry    commit
+//    txn_end_return   commit, ok, err_domain, err_code
+//    blob_read_entry  bytes_requested
+//    blob_read_return bytes_read, ok, err_code
+//    blob_write_entry bytes
+//    blob_write_return bytes, ok, err_code
+//    query_entry      n1ql_len
+//    query_return     ok, err_domain, err_code
+//
+
+#ifndef CBLITEC_TRACE_H
+#define CBLITEC_TRACE_H
+
+#if !defined(CBLU_USDT) && !defined(CBLU_NO_USDT) && defined(__has_include)
+	#if __has_include(<sys/sdt.h>)
+		#define CBLU_USDT 1
+	#endif
+#endif
+
+#ifdef CBLU_USDT
+	#include <sys/sdt.h>
+	#define CBLU_TRACE0(name)                  DTRACE_PROBE(cblu, name)
+	#define CBLU_TRACE1(name, a)               DTRACE_PROBE1(cblu, name, a)
+	#define CBLU_TRACE2(name, a, b)            DTRACE_PROBE2(cblu, name, a, b)
+	#define CBLU_TRACE3(name, a, b, c)         DTRACE_PROBE3(cblu, name, a, b, c)
+	#define CBLU_TRACE4(name, a, b, c, d)      DTRACE_PROBE4(cblu, name, a, b, c, d)
+#else
+	#define CBLU_TRACE0(name)                  ((void)0)
+	#define CBLU_TRACE1(name, a)               ((void)0)
+	#define CBLU_TRACE2(name, a, b)            ((void)0)
+	#define CBLU_TRACE3(name, a, b, c)         ((void)0)
+	#define CBLU_TRACE4(name, a, b, c, d)      ((void)0)
+#endif
+
+#endif // CBLITEC_TRACE_H
@@ -0,0 +1,77 @@
+//
+//  test_import.c
+//
+//  NDJSON import with the default "_id" field: string and integer ids become
+//  the doc ID, an object id moves to "id", a line without one gets a generated
+//  ID, and none of them fails to save. Run by `make check`.
+//
+
+#include "CBLiteC.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int g_failed;
+
+#define CHECK(cond) \
+	do { if (!(cond)) { fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); g_failed++; } } while (0)
+
+static int64_t count_where(CBLU_Session* s, const char* n1ql) {
+	CBLU_Query* q = cblu_query_begin(s, n1ql);
+	int64_t n = -1;
+	if (!(q && cblu_query_next(q) && cblu_query_get_i64(q, 0, &n))) n = -1;
+	cblu_query_free(q);
+	return n;
+}
+
+int main(void) {
+	char dir[] = "/tmp/cblu_test_import.XXXXXX";
+	if (!mkdtemp(dir)) { perror("mkdtemp"); return 1; }
+	char path[sizeof dir + 16];
+	snprintf(path, sizeof path, "%s/in.ndjson", dir);
+	FILE* f = fopen(path, "w");
+	if (!f) { perror("fopen"); return 1; }
+	fputs("{\"_id\":\"a\",\"v\":1}\n"
+		  "{\"_id\":42,\"v\":2}\n"
+		  "{\"_id\":{\"$oid\":\"abc\"},\"v\":3}\n"
+		  "{\"v\":4}", f);   // last line without '\n'
+	fclose(f);
+
+	CBLU_Db* db = NULL;
+	CHECK(cblu_open("import", dir, &db));
+	if (!db) return 1;
+
+	CBLU_ImportStats st;
+	CHECK(cblu_import_ndjson_file(db, path, NULL, &st));
+	CHECK(st.records == 4);
+	CHECK(st.failed == 0);
+
+	CBLU_Session* s = cblu_session_begin(db);
+	int64_t v = 0;
+	CBLU_DocR* d = cblu_docr_get(s, "a");
+	CHECK(d != NULL);
+	if (d) {
+		CHECK(cblu_docr_get_i64(d, "v", &v) && v == 1);
+		CHECK(!cblu_docr_has(d, "_id") && !cblu_docr_has(d, "id"));
+		cblu_docr_free(d);
+	}
+	d = cblu_docr_get(s, "42");
+	CHECK(d != NULL);
+	if (d) {
+		CHECK(cblu_docr_get_i64(d, "v", &v) && v == 2);
+		cblu_docr_free(d);
+	}
+	CHECK(count_where(s, "SELECT COUNT(*) FROM _") == 4);
+	CHECK(count_where(s, "SELECT COUNT(*) FROM _ WHERE v = 3 AND id.`$oid` = 'abc'") == 1);
+	CHECK(count_where(s, "SELECT COUNT(*) FROM _ WHERE v = 4 AND id IS MISSING") == 1);
+	cblu_session_end(s);
+
+	// Keeping a reserved field in the body can never be saved
+	CBLU_ImportOptions opt = { .keep_id_field = true };
+	CHECK(!cblu_import_ndjson_file(db, path, &opt, &st));
+
+	cblu_close(db);
+	if (g_failed) fprintf(stderr, "test_import: %d check(s) failed (database left in %s)\n", g_failed, dir);
+	else          printf("test_import: ok\n");
+	return g_failed ? 1 : 0;
+}